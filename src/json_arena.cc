@@ -0,0 +1,84 @@
+#include <cstring>
+#include <new>
+#include "json_arena.hh"
+
+namespace json {
+
+arena::arena(size_t block_size_, json::memory_resource *upstream_)
+	: first(0), current(0), p(0), end(0), block_size(block_size_ < ALIGNMENT ? ALIGNMENT : block_size_),
+	  capacity_(0), used_before(0), upstream(0 == upstream_ ? json::new_delete_resource() : upstream_) {
+}
+
+arena::~arena() {
+	while (0 != first) {
+		block_t *next = first->next;
+		upstream->deallocate(first, sizeof(block_t) + first->size);
+		first = next;
+	}
+}
+
+void *
+arena::grow(size_t n) {
+	// the bytes of the current block are accounted for as a whole, including the unused end
+	if (0 != current)
+		used_before += current->size;
+	block_t *prev = current;
+	block_t *next = 0 == current ? first : current->next;
+	// reuse the blocks kept by reset that are large enough
+	while (0 != next && next->size < n) {
+		used_before += next->size;
+		prev = next;
+		next = next->next;
+	}
+	if (0 == next) {
+		while (block_size < n)
+			block_size *= 2;
+		next = static_cast<block_t *>(upstream->allocate(sizeof(block_t) + block_size));
+		next->next = 0;
+		next->size = block_size;
+		capacity_ += block_size;
+		block_size *= 2;
+		if (0 == prev)
+			first = next;
+		else
+			prev->next = next;
+	}
+	current = next;
+	p = reinterpret_cast<char *>(current + 1);
+	end = p + current->size;
+	void *r = p;
+	p += n;
+	return r;
+}
+
+char *
+arena::copy(const char *s, size_t n) {
+	char *r = static_cast<char *>(allocate(0 == n ? 1 : n));
+	memcpy(r, s, n);
+	return r;
+}
+
+void
+arena::reset() {
+	current = first;
+	used_before = 0;
+	if (0 == first)
+		return;
+	p = reinterpret_cast<char *>(first + 1);
+	end = p + first->size;
+}
+
+size_t
+arena::used() const {
+	return 0 == current ? 0 : used_before + (p - reinterpret_cast<const char *>(current + 1));
+}
+
+void *
+arena_resource::do_allocate(size_t n, size_t alignment) {
+	if (alignment <= arena::ALIGNMENT)
+		return a.allocate(n);
+	char *r = static_cast<char *>(a.allocate(n + alignment - arena::ALIGNMENT));
+	return r + (alignment - reinterpret_cast<size_t>(r) % alignment) % alignment;
+}
+
+}
@@ -0,0 +1,132 @@
+#ifndef __JSON_ARENA_HH__
+#define __JSON_ARENA_HH__
+
+#include <cstddef>
+#include "json_resource.hh"
+
+namespace json {
+
+/**
+ * \brief A monotonic memory arena. Memory is handed out from large blocks by moving a pointer and it is never
+ * given back piecemeal: \link json::arena::reset reset\endlink releases everything that was allocated at once, in
+ * constant time, and keeps the blocks for the next use. Hence one arena may serve many documents in turn without
+ * touching the heap once it has grown to the size of the largest one.
+ *
+ * No destructor is run for the objects placed in the arena, so they must not own other resources. The blocks
+ * themselves are allocated through a json::memory_resource.
+ */
+class arena {
+public:
+	//! \brief The alignment of every allocation.
+	static const size_t ALIGNMENT = 8;
+	/**
+	 * \brief The constructor. No block is allocated until the first allocation.
+	 *
+	 * \param block_size The size of the first block. Every further block is twice the size of the previous one.
+	 * \param upstream The resource the blocks are allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit arena(size_t = 4096, json::memory_resource * = 0);
+	//! \brief Frees all blocks.
+	~arena();
+	/**
+	 * \brief Allocates n bytes, aligned to \link json::arena::ALIGNMENT ALIGNMENT\endlink.
+	 *
+	 * \param n The number of bytes.
+	 * \return The allocated memory. Never 0.
+	 * \exception std::bad_alloc if a new block is needed and cannot be allocated.
+	 */
+	inline void *allocate(size_t);
+	/**
+	 * \brief Copies n characters to the arena.
+	 *
+	 * \param p The first character.
+	 * \param n The number of characters.
+	 * \return The copy. Never 0, even if n is 0.
+	 */
+	char *copy(const char *, size_t);
+	//! \brief Releases everything that was allocated. The blocks are kept.
+	void reset();
+	//! \brief The number of bytes allocated since the construction or the last \link json::arena::reset reset\endlink.
+	size_t used() const;
+	//! \brief The total size of the blocks.
+	size_t capacity() const { return capacity_; }
+private:
+	//! \brief The header of a block. The memory handed out follows it.
+	struct block_t {
+		//! \brief The next block in the chain.
+		block_t *next;
+		//! \brief The number of bytes following the header.
+		size_t size;
+	};
+	//! \brief Moves to the next block of the chain that holds n bytes, allocating it if there is none.
+	void *grow(size_t);
+
+	//! \brief The first block of the chain.
+	block_t *first;
+	//! \brief The block allocations are currently served from.
+	block_t *current;
+	//! \brief The next free byte of the current block.
+	char *p;
+	//! \brief One past the last byte of the current block.
+	char *end;
+	//! \brief The size of the next block to allocate.
+	size_t block_size;
+	//! \brief The total size of the blocks.
+	size_t capacity_;
+	//! \brief The bytes allocated from the blocks before the current one.
+	size_t used_before;
+	//! \brief The resource the blocks are allocated from.
+	json::memory_resource *upstream;
+
+	arena(const arena&);
+	arena& operator=(const arena&);
+};
+
+inline void *
+arena::allocate(size_t n) {
+	n = (n + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	if (static_cast<size_t>(end - p) < n)
+		return grow(n);
+	void *r = p;
+	p += n;
+	return r;
+}
+
+/**
+ * \brief The json::memory_resource of a json::arena: memory is given back only when the arena is
+ * \link json::arena_resource::reset reset\endlink. Given to the parser and to the containers of a request, it
+ * serves all their buffers from a few blocks that are released at once.
+ *
+ * \code
+ * json::arena_resource pool;
+ * json::parser<char, json::tape_builder> p(json::tape_builder(t), &pool);
+ * \endcode
+ *
+ * The buffers must be destroyed before the resource is reset, the memory they hold is then reused.
+ */
+class arena_resource : public memory_resource {
+public:
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param block_size The size of the first block of the arena.
+	 * \param upstream The resource the blocks are allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit arena_resource(size_t block_size = 4096, json::memory_resource *upstream = 0) : a(block_size, upstream) {}
+	//! \brief Releases everything that was allocated. \sa arena::reset
+	void reset() { a.reset(); }
+	//! \brief The arena.
+	json::arena& get() { return a; }
+protected:
+	//! \brief Allocates from the arena. Alignments beyond \link json::arena::ALIGNMENT ALIGNMENT\endlink are padded.
+	void *do_allocate(size_t, size_t);
+	//! \brief Does nothing, the memory is given back by \link json::arena_resource::reset reset\endlink.
+	void do_deallocate(void *, size_t, size_t) {}
+private:
+	//! \brief The arena.
+	json::arena a;
+};
+
+}
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef __JSON_BATCH_HH__
+#define __JSON_BATCH_HH__
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include "json_handler.hh"
+#include "json_resource.hh"
+
+namespace json {
+
+/**
+ * \brief A compact record of one parser event, 16 bytes, so that four fit in a cache line. The kinds are named
+ * like the tags of json::tape. A key or a string refers to its raw text in the character buffer of its
+ * json::event_batch, a number holds its value, the other events hold nothing.
+ */
+struct event {
+	//! \brief The kinds of the events.
+	typedef enum {
+		OBJECT_START = '{', OBJECT_END = '}', ARRAY_START = '[', ARRAY_END = ']', KEY = ':', STRING = '"',
+		INT64 = 'l', DOUBLE = 'd', TRUE_VALUE = 't', FALSE_VALUE = 'f', NULL_VALUE = 'n', DOCUMENT_END = '\n'
+	} kind_t;
+
+	//! \brief The kind, a kind_t.
+	uint8_t kind;
+	//! \brief 1 if the text of a KEY or STRING contains escape sequences. \sa json::string_ref::escaped
+	uint8_t escaped;
+	//! \brief The number of containers around the event. A container is at the depth of its start and end events.
+	uint16_t depth;
+	//! \brief The number of characters of the text of a KEY or STRING.
+	uint32_t length;
+	union {
+		//! \brief The index of the first character of the text of a KEY or STRING in the character buffer.
+		uint64_t offset;
+		//! \brief The value of an INT64.
+		int64_t integer;
+		//! \brief The value of a DOUBLE.
+		double number;
+	};
+};
+
+/**
+ * \brief A batch of events: an array of json::event records, whose capacity is fixed at construction, and the
+ * characters of their keys and strings. Both buffers are allocated once and keep their capacity when the batch
+ * is cleared, so a batch that is reused allocates nothing unless its strings outgrow the character buffer.
+ *
+ * The records do not point into the input, so a batch stays valid after the parser moved on, and two batches
+ * are exchanged in constant time with \link json::event_batch::swap swap\endlink. \sa json::event_batcher
+ */
+template<typename Char>
+class event_batch {
+public:
+	//! \brief The default number of records, 4 kB of them.
+	static const size_t DEFAULT_CAPACITY = 256;
+	//! \brief The type of the character buffer.
+	typedef std::basic_string<Char, std::char_traits<Char>, json::allocator<Char> > chars_t;
+
+	/**
+	 * \brief The constructor of an empty batch.
+	 *
+	 * \param capacity The number of records, at least 1.
+	 * \param r The resource the buffers are allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit event_batch(size_t capacity = DEFAULT_CAPACITY, json::memory_resource *r = 0) :
+		records(json::allocator<json::event>(r)), chars(json::allocator<Char>(r)), cap(std::max(capacity, static_cast<size_t>(1))) {
+		records.reserve(cap);
+	}
+	//! \brief The number of records.
+	size_t size() const { return records.size(); }
+	//! \brief The largest number of records.
+	size_t capacity() const { return cap; }
+	//! \brief true if there is no record.
+	bool empty() const { return records.empty(); }
+	//! \brief true if there are as many records as the capacity.
+	bool full() const { return records.size() >= cap; }
+	//! \brief The records.
+	const json::event *data() const { return records.empty() ? 0 : &records[0]; }
+	//! \brief The i-th record.
+	const json::event& operator[](size_t i) const { return records[i]; }
+	//! \brief The raw text of a KEY or STRING record of the batch. Use json::string_ref::decode if it is escaped.
+	json::string_ref<Char> text(const json::event& e) const {
+		return json::string_ref<Char>(chars.data() + e.offset, e.length, 0 != e.escaped);
+	}
+	//! \brief The character buffer.
+	const chars_t& characters() const { return chars; }
+	//! \brief Removes the records and the characters. The capacity is kept.
+	void clear() { records.clear(); chars.clear(); }
+	//! \brief Exchanges the records, the characters and the capacity with another batch, in constant time.
+	void swap(event_batch& b) { records.swap(b.records); chars.swap(b.chars); std::swap(cap, b.cap); }
+
+	/**
+	 * \brief Appends a record. The batch must not be full.
+	 *
+	 * \param kind The kind.
+	 * \param depth The depth.
+	 * \return The record, whose value is 0.
+	 */
+	json::event& push(json::event::kind_t kind, size_t depth) {
+		json::event e;
+		e.kind = static_cast<uint8_t>(kind);
+		e.escaped = 0;
+		e.depth = static_cast<uint16_t>(depth);
+		e.length = 0;
+		e.offset = 0;
+		records.push_back(e);
+		return records.back();
+	}
+	//! \brief Appends a KEY or STRING record and its raw text. The batch must not be full.
+	void push(json::event::kind_t kind, size_t depth, const json::string_ref<Char>& t) {
+		json::event& e = push(kind, depth);
+		e.escaped = t.escaped();
+		e.length = static_cast<uint32_t>(t.size());
+		e.offset = chars.size();
+		chars.append(t.data(), t.size());
+	}
+private:
+	//! \brief The records.
+	std::vector<json::event, json::allocator<json::event> > records;
+	//! \brief The characters of the keys and the strings.
+	chars_t chars;
+	//! \brief The largest number of records.
+	size_t cap;
+};
+
+/**
+ * \brief The parser handler that records the events in a json::event_batch and hands the batch to a callback
+ * when it is full, rather than calling back per event. Numbers are converted as they are recorded, integers that
+ * do not fit in 64 bits become doubles. The cost of the callback is then shared by a batch, and the consumer
+ * gets arrays that it may process in bulk, e.g. append to the columns of a store.
+ *
+ * The callback gets the batch by reference and may swap it with a batch of its own, e.g. for another thread
+ * to process while the parser fills the one it got back. The batch the handler holds is cleared after the
+ * callback. The events that are pending at the end of the input are handed over by \link json::event_batcher::flush flush\endlink.
+ *
+ * \code
+ * json::parser<char, json::event_batcher<char> > p;
+ * p.handler().hook_batch(&on_batch);
+ * if (p.OK == p.parse(buf, len))
+ * 	p.handler().flush();
+ * \endcode
+ */
+template<typename Char>
+class event_batcher : public json::handler<Char> {
+public:
+	//! \brief Specifies the type of the callback that is invoked with a batch of events and the context.
+	typedef void (*hook_batch_t)(json::event_batch<Char>&, void *);
+
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param capacity The number of records of a batch.
+	 * \param r The resource the batch is allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit event_batcher(size_t capacity = json::event_batch<Char>::DEFAULT_CAPACITY, json::memory_resource *r = 0) :
+		current(capacity, r), batch_cb(0), ctx(0), depth(0) {}
+	//! \brief Sets the callback that is invoked with the batches.
+	void hook_batch(hook_batch_t cb) { batch_cb = cb; }
+	//! \brief Sets the context that is passed to the callback.
+	void set_context(void *c) { ctx = c; }
+	//! \brief The batch that is being filled.
+	const json::event_batch<Char>& pending() const { return current; }
+	//! \brief Hands the pending events, if any, to the callback, e.g. when the parser returned.
+	void flush() {
+		if (current.empty())
+			return;
+		if (0 != batch_cb)
+			(*batch_cb)(current, ctx);
+		current.clear();
+	}
+	//! \brief Discards the pending events and the depth, e.g. after the parser returned ERROR.
+	void clear() { current.clear(); depth = 0; }
+	//! \brief Discards the pending events and the depth when the parser is reset. \sa handler::reset
+	void reset() { clear(); }
+
+	//! \brief The event of '{'. \sa handler::obj_start
+	void obj_start() { record(json::event::OBJECT_START, depth++); }
+	//! \brief The event of a key. \sa handler::key
+	void key(const json::string_ref<Char>& k) { current.push(json::event::KEY, depth, k); filled(); }
+	//! \brief The event of a value in a key:value pair. \sa handler::obj_data
+	void obj_data(const json::string_ref<Char>& d, int term) { leaf(d, term); }
+	//! \brief The event of '}'. \sa handler::obj_end
+	void obj_end() { record(json::event::OBJECT_END, --depth); }
+	//! \brief The event of '['. \sa handler::array_start
+	void array_start() { record(json::event::ARRAY_START, depth++); }
+	//! \brief The event of an array element. \sa handler::array_data
+	void array_data(const json::string_ref<Char>& d, int term) { leaf(d, term); }
+	//! \brief The event of ']'. \sa handler::array_end
+	void array_end() { record(json::event::ARRAY_END, --depth); }
+	//! \brief The event of the end of a document. \sa handler::document_end
+	void document_end() { record(json::event::DOCUMENT_END, 0); }
+private:
+	//! \brief Hands the batch over if it is full.
+	void filled() {
+		if (current.full())
+			flush();
+	}
+	//! \brief Records an event without value.
+	void record(json::event::kind_t kind, size_t d) {
+		current.push(kind, d);
+		filled();
+	}
+	//! \brief Records a string, a number, a boolean or null.
+	inline void leaf(const json::string_ref<Char>&, int);
+
+	//! \brief The batch that is being filled.
+	json::event_batch<Char> current;
+	//! \brief The callback.
+	hook_batch_t batch_cb;
+	//! \brief The context that is passed to the callback.
+	void *ctx;
+	//! \brief The number of open containers.
+	size_t depth;
+};
+
+template<typename Char>
+inline void
+event_batcher<Char>::leaf(const json::string_ref<Char>& d, int term) {
+	switch (term) {
+	case json::scanner<Char>::STRING:
+		current.push(json::event::STRING, depth, d);
+		break;
+	case json::scanner<Char>::INTEGER:
+	case json::scanner<Char>::DOUBLE: {
+		int64_t i;
+		double v;
+		if (json::parse_number(d.data(), d.size(), json::scanner<Char>::INTEGER == term, i, v))
+			current.push(json::event::INT64, depth).integer = i;
+		else
+			current.push(json::event::DOUBLE, depth).number = v;
+		break;
+	}
+	case json::scanner<Char>::TRUE_CONST:
+		current.push(json::event::TRUE_VALUE, depth);
+		break;
+	case json::scanner<Char>::FALSE_CONST:
+		current.push(json::event::FALSE_VALUE, depth);
+		break;
+	default:
+		current.push(json::event::NULL_VALUE, depth);
+		break;
+	}
+	filled();
+}
+
+}
+
+#endif
@@ -0,0 +1,322 @@
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <time.h>
+#include <sys/resource.h>
+#include "json_parser.hh"
+#include "json_tree.hh"
+#include "json_writer.hh"
+#include "json_mmap.hh"
+#include "json_batch.hh"
+
+// The number of calls to operator new, for the allocations per document.
+static unsigned long allocations = 0;
+
+#if __cplusplus >= 201103L
+#define BENCH_THROW_BAD_ALLOC
+#define BENCH_THROW_NOTHING noexcept
+#else
+#define BENCH_THROW_BAD_ALLOC throw(std::bad_alloc)
+#define BENCH_THROW_NOTHING throw()
+#endif
+
+void *
+operator new(size_t n) BENCH_THROW_BAD_ALLOC {
+	++allocations;
+	void *p = malloc(0 == n ? 1 : n);
+	if (0 == p)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *
+operator new[](size_t n) BENCH_THROW_BAD_ALLOC {
+	return operator new(n);
+}
+
+void
+operator delete(void *p) BENCH_THROW_NOTHING {
+	free(p);
+}
+
+void
+operator delete[](void *p) BENCH_THROW_NOTHING {
+	free(p);
+}
+
+#if __cplusplus >= 201402L
+// the sized deallocations of C++14 free like the unsized ones
+void
+operator delete(void *p, size_t) BENCH_THROW_NOTHING {
+	free(p);
+}
+
+void
+operator delete[](void *p, size_t) BENCH_THROW_NOTHING {
+	free(p);
+}
+#endif
+
+namespace {
+
+//! \brief An input of the benchmark.
+struct input_t {
+	//! \brief The name the results are reported under.
+	std::string name;
+	//! \brief The text.
+	std::string text;
+	//! \brief The number of documents, more than one for newline-delimited JSON.
+	size_t documents;
+};
+
+//! \brief The monotonic clock, in seconds.
+double
+now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//! \brief The peak resident set size of the process, in kB.
+long
+peak_rss() {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_maxrss;
+}
+
+//! \brief Parses the input with p, in one buffer if chunk is 0, in chunks of the given size otherwise.
+template<typename Handler>
+bool
+parse(json::parser<char, Handler>& p, const input_t& in, size_t chunk) {
+	p.reset();
+	p.set_multi_document(in.documents > 1);
+	const char *s = in.text.data();
+	size_t n = in.text.size();
+	if (0 == chunk)
+		return json::parser<char, Handler>::OK == p.parse(s, n);
+	typename json::parser<char, Handler>::result_t r = json::parser<char, Handler>::PENDING;
+	for (size_t i = 0; i < n && json::parser<char, Handler>::PENDING == r; i += chunk)
+		r = p.feed(s + i, std::min(chunk, n - i));
+	if (json::parser<char, Handler>::PENDING == r)
+		r = p.finish();
+	return json::parser<char, Handler>::OK == r;
+}
+
+//! \brief Only the events: the handler does nothing.
+struct events_path {
+	json::parser<char, json::handler<char> > p;
+	bool operator()(const input_t& in, size_t chunk) { return parse(p, in, chunk); }
+};
+
+//! \brief The events in batches, whose records the callback only counts.
+struct batch_path {
+	json::parser<char, json::event_batcher<char> > p;
+	size_t events;
+	batch_path() : events(0) {
+		p.handler().hook_batch(&count);
+		p.handler().set_context(this);
+	}
+	static void count(json::event_batch<char>& b, void *ctx) { static_cast<batch_path *>(ctx)->events += b.size(); }
+	bool operator()(const input_t& in, size_t chunk) {
+		p.handler().clear();
+		bool ok = parse(p, in, chunk);
+		p.handler().flush();
+		return ok;
+	}
+};
+
+//! \brief The arena DOM, released after every pass.
+struct dom_path {
+	json::arena a;
+	json::parser<char, json::arena_builder> p;
+	dom_path() : p(json::arena_builder(a)) {}
+	bool operator()(const input_t& in, size_t chunk) {
+		bool ok = parse(p, in, chunk);
+		a.reset();
+		return ok;
+	}
+};
+
+//! \brief Serialization straight from the events, without DOM.
+struct serialize_path {
+	json::writer w;
+	json::parser<char, json::write_handler> p;
+	serialize_path() : p(json::write_handler(w)) {}
+	bool operator()(const input_t& in, size_t chunk) {
+		bool ok = parse(p, in, chunk);
+		w.clear();
+		return ok;
+	}
+};
+
+//! \brief Runs passes over the input for at least the given time and prints one line of results.
+template<typename Path>
+void
+measure(const char *path, const input_t& in, size_t chunk, double seconds) {
+	Path run;
+	// the first pass warms the caches and grows the buffers
+	if (!run(in, chunk)) {
+		std::cout << in.name << '\t' << path << "\tparse error" << std::endl;
+		return;
+	}
+	unsigned long passes = 0;
+	unsigned long before = allocations;
+	double start = now(), elapsed;
+	do {
+		run(in, chunk);
+		++passes;
+		elapsed = now() - start;
+	} while (elapsed < seconds);
+	double documents = static_cast<double>(passes) * in.documents;
+
+	std::ostringstream mode;
+	if (0 == chunk)
+		mode << "whole";
+	else
+		mode << "chunk " << chunk;
+	char line[256];
+	snprintf(line, sizeof(line), "%-16s %-10s %-14s %10.1f %12.0f %10.2f %10ld", in.name.c_str(), path,
+		mode.str().c_str(), passes * in.text.size() / elapsed / 1e6, documents / elapsed,
+		(allocations - before) / documents, peak_rss());
+	std::cout << line << std::endl;
+}
+
+//! \brief An array of integers and doubles.
+input_t
+numbers() {
+	input_t in;
+	in.name = "numbers";
+	in.documents = 1;
+	std::ostringstream os;
+	os.precision(17);
+	os << '[';
+	for (int i = 0; i < 100000; ++i)
+		os << (0 == i ? "" : ", ") << (i % 2 ? i * 7919 - 300000 : (i - 50000) / 7.0) << ", " << i * 1e-9;
+	os << ']';
+	in.text = os.str();
+	return in;
+}
+
+//! \brief An object of long strings, some with escapes.
+input_t
+strings() {
+	input_t in;
+	in.name = "strings";
+	in.documents = 1;
+	std::string body("Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore");
+	in.text = "{";
+	for (int i = 0; i < 10000; ++i) {
+		std::ostringstream key;
+		key << (0 == i ? "" : ", ") << "\"key" << i << "\" : \"";
+		in.text.append(key.str()).append(body);
+		if (0 == i % 4)
+			in.text.append(" \\\"quoted\\\" \\u00e9\\n");
+		in.text.append("\"");
+	}
+	in.text.append("}");
+	return in;
+}
+
+//! \brief Arrays and objects nested 300 levels deep, repeated.
+input_t
+nested() {
+	input_t in;
+	in.name = "nested";
+	in.documents = 1;
+	std::string one;
+	for (int i = 0; i < 150; ++i)
+		one.append("{\"a\" : [");
+	one.append("1");
+	for (int i = 0; i < 150; ++i)
+		one.append("]}");
+	in.text = "[";
+	for (int i = 0; i < 1000; ++i)
+		in.text.append(0 == i ? "" : ", ").append(one);
+	in.text.append("]");
+	return in;
+}
+
+//! \brief Many small documents, one per line.
+input_t
+small_documents() {
+	input_t in;
+	in.name = "ndjson";
+	in.documents = 50000;
+	std::ostringstream os;
+	for (size_t i = 0; i < in.documents; ++i)
+		os << "{\"id\" : " << i << ", \"name\" : \"user" << i << "\", \"active\" : " << (i % 2 ? "true" : "false")
+			<< ", \"tags\" : [\"a\", \"b\"], \"score\" : " << i / 3.0 << "}\n";
+	in.text = os.str();
+	return in;
+}
+
+//! \brief A file, e.g. a standard corpus. Files named *.ndjson or *.jsonl hold one document per line.
+input_t
+file(const char *path) {
+	json::mapped_file f;
+	f.open(path);
+	input_t in;
+	const char *base = strrchr(path, '/');
+	in.name = 0 == base ? path : base + 1;
+	in.text.assign(0 == f.data() ? "" : f.data(), f.size());
+	in.documents = 1;
+	std::string::size_type dot = in.name.rfind('.');
+	if (std::string::npos != dot && (".ndjson" == in.name.substr(dot) || ".jsonl" == in.name.substr(dot))) {
+		in.documents = 0;
+		for (std::string::size_type i = 0; i < in.text.size(); ++i)
+			if ('\n' == in.text[i])
+				++in.documents;
+	}
+	return in;
+}
+
+}
+
+int
+main(int argc, char *argv[]) {
+	double seconds = 0.2;
+	std::vector<input_t> inputs;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			if (0 == strcmp("-t", argv[i]) && i + 1 < argc)
+				seconds = atof(argv[++i]);
+			else if ('-' == argv[i][0]) {
+				std::cerr << "usage: " << argv[0] << " [-t seconds] [file...]" << std::endl
+					<< "Measures every file, e.g. twitter.json, citm_catalog.json and canada.json, and synthetic inputs."
+					<< std::endl;
+				return 1;
+			} else
+				inputs.push_back(file(argv[i]));
+		}
+	} catch (const std::runtime_error& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	inputs.push_back(numbers());
+	inputs.push_back(strings());
+	inputs.push_back(nested());
+	inputs.push_back(small_documents());
+
+	const size_t chunks[] = {0, 1, 64, 4096, 65536, 1 << 20};
+	char header[256];
+	snprintf(header, sizeof(header), "%-16s %-10s %-14s %10s %12s %10s %10s", "input", "path", "mode", "MB/s", "docs/s",
+		"allocs/doc", "peak kB");
+	std::cout << header << std::endl;
+	for (size_t i = 0; i < inputs.size(); ++i) {
+		for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); ++c)
+			measure<events_path>("events", inputs[i], chunks[c], seconds);
+		measure<batch_path>("batches", inputs[i], 0, seconds);
+		measure<batch_path>("batches", inputs[i], 65536, seconds);
+		measure<dom_path>("dom", inputs[i], 0, seconds);
+		measure<dom_path>("dom", inputs[i], 65536, seconds);
+		measure<serialize_path>("serialize", inputs[i], 0, seconds);
+	}
+	return 0;
+}
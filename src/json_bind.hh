@@ -0,0 +1,253 @@
+#ifndef __JSON_BIND_HH__
+#define __JSON_BIND_HH__
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <stdint.h>
+#include "json_handler.hh"
+
+namespace json {
+
+/**
+ * \brief The description of a member of the struct T that is bound to a key of a JSON object. It is made by
+ * json::make_field. The supported member types are int64_t, int, double, bool, and std::string.
+ */
+template<typename T>
+struct field {
+	//! \brief The types of the members.
+	typedef enum {
+		INT64_FIELD, INT_FIELD, DOUBLE_FIELD, BOOL_FIELD, STRING_FIELD
+	} type_t;
+	//! \brief The key, null terminated.
+	const char *name;
+	//! \brief The type of the member.
+	type_t type;
+	//! \brief The member. Which pointer is valid depends on the type.
+	union {
+		int64_t T::*i64;
+		int T::*i;
+		double T::*d;
+		bool T::*b;
+		std::string T::*s;
+	} member;
+};
+
+//! \brief Describes an int64_t member. \sa json::field
+template<typename T>
+field<T>
+make_field(const char *name, int64_t T::*m) {
+	field<T> f;
+	f.name = name;
+	f.type = field<T>::INT64_FIELD;
+	f.member.i64 = m;
+	return f;
+}
+
+//! \brief Describes an int member. Integers that do not fit are not assigned. \sa json::field
+template<typename T>
+field<T>
+make_field(const char *name, int T::*m) {
+	field<T> f;
+	f.name = name;
+	f.type = field<T>::INT_FIELD;
+	f.member.i = m;
+	return f;
+}
+
+//! \brief Describes a double member. It takes integers as well. \sa json::field
+template<typename T>
+field<T>
+make_field(const char *name, double T::*m) {
+	field<T> f;
+	f.name = name;
+	f.type = field<T>::DOUBLE_FIELD;
+	f.member.d = m;
+	return f;
+}
+
+//! \brief Describes a bool member. \sa json::field
+template<typename T>
+field<T>
+make_field(const char *name, bool T::*m) {
+	field<T> f;
+	f.name = name;
+	f.type = field<T>::BOOL_FIELD;
+	f.member.b = m;
+	return f;
+}
+
+//! \brief Describes a std::string member. \sa json::field
+template<typename T>
+field<T>
+make_field(const char *name, std::string T::*m) {
+	field<T> f;
+	f.name = name;
+	f.type = field<T>::STRING_FIELD;
+	f.member.s = m;
+	return f;
+}
+
+/**
+ * \brief The parser handler that stores the members of the root object of a document straight into a struct,
+ * without building a DOM. The struct declares its fields once, in a static table:
+ *
+ * \code
+ * struct point { int64_t x; double y; std::string label; };
+ * static const json::field<point> point_fields[] = {
+ * 	json::make_field("x", &point::x), json::make_field("y", &point::y), json::make_field("label", &point::label)
+ * };
+ * point pt;
+ * json::parser<char, json::binder<point> > p((json::binder<point>(pt, point_fields)));
+ * p.parse(buf, len);
+ * \endcode
+ *
+ * Keys are dispatched to the fields through a hash of their length and of their first and last characters,
+ * computed on the raw token bytes, followed by one comparison. The table is built when the binder is constructed.
+ * Keys that are not in the table and values whose type does not match the member are skipped without being
+ * copied. Nested objects and arrays are skipped without being tokenized. Members that do not appear in the
+ * document keep their value.
+ */
+template<typename T>
+class binder : public json::handler<char> {
+public:
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param target The struct the members are stored in.
+	 * \param fields The table of the fields of T.
+	 * \exception std::logic_error if two fields have the same key.
+	 */
+	template<size_t N>
+	binder(T& target, const json::field<T> (&fields)[N]) : t(&target), map(fields), n(N), depth(0), current(-1) {
+		build();
+	}
+	//! \brief Makes the next documents be stored in another struct.
+	void bind(T& target) { t = &target; }
+
+	//! \brief Called when '{' is encountered. \sa handler::obj_start
+	void obj_start() { ++depth; current = -1; }
+	//! \brief Looks the key up. \sa handler::key
+	inline void key(const json::string_ref<char>&);
+	//! \brief Stores the value in the member of the current key. \sa handler::obj_data
+	inline void obj_data(const json::string_ref<char>&, int);
+	//! \brief Called when '}' is encountered. \sa handler::obj_end
+	void obj_end() { --depth; current = -1; }
+	//! \brief Called when '[' is encountered. \sa handler::array_start
+	void array_start() { ++depth; current = -1; }
+	//! \brief Called when ']' is encountered. \sa handler::array_end
+	void array_end() { --depth; current = -1; }
+	//! \brief Nested containers are skipped. \sa handler::skip
+	bool skip() const { return depth > 1; }
+	//! \brief Forgets the containers of an unfinished document. \sa handler::reset
+	void reset() { depth = 0; current = -1; }
+private:
+	//! \brief The slot of a key in the dispatch table.
+	size_t slot(const char *k, size_t len) const {
+		size_t h = len * 31;
+		if (0 != len)
+			h += static_cast<unsigned char>(k[0]) * 7 + static_cast<unsigned char>(k[len - 1]);
+		return h & (slots.size() - 1);
+	}
+	//! \brief Builds the dispatch table.
+	void build();
+	//! \brief The index of the field of a key, -1 if there is none.
+	inline int lookup(const char *, size_t) const;
+
+	//! \brief The struct.
+	T *t;
+	//! \brief The table of the fields.
+	const json::field<T> *map;
+	//! \brief The number of fields.
+	size_t n;
+	//! \brief The dispatch table: the indices of the fields, -1 for empty slots. Its size is a power of 2.
+	std::vector<short> slots;
+	//! \brief The nesting depth. The members of the root object are at depth 1.
+	int depth;
+	//! \brief The field of the last key at depth 1, -1 if the value is to be skipped.
+	int current;
+	//! \brief The buffer escaped keys are decoded in.
+	std::string scratch;
+};
+
+template<typename T>
+void
+binder<T>::build() {
+	if (n > 0x3fff)
+		throw std::logic_error("too many fields");
+	size_t size = 4;
+	while (size < 2 * n)
+		size *= 2;
+	slots.assign(size, -1);
+	for (size_t i = 0; i < n; ++i) {
+		size_t len = strlen(map[i].name);
+		if (lookup(map[i].name, len) >= 0)
+			throw std::logic_error(std::string("duplicate field ") + map[i].name);
+		size_t s = slot(map[i].name, len);
+		while (slots[s] >= 0)
+			s = (s + 1) & (size - 1);
+		slots[s] = static_cast<short>(i);
+	}
+}
+
+template<typename T>
+inline int
+binder<T>::lookup(const char *k, size_t len) const {
+	for (size_t s = slot(k, len); slots[s] >= 0; s = (s + 1) & (slots.size() - 1)) {
+		const char *name = map[slots[s]].name;
+		if (0 == strncmp(name, k, len) && '\0' == name[len])
+			return slots[s];
+	}
+	return -1;
+}
+
+template<typename T>
+inline void
+binder<T>::key(const json::string_ref<char>& k) {
+	if (1 != depth)
+		return;
+	if (k.escaped()) {
+		k.decode(scratch);
+		current = lookup(scratch.data(), scratch.size());
+	} else
+		current = lookup(k.data(), k.size());
+}
+
+template<typename T>
+inline void
+binder<T>::obj_data(const json::string_ref<char>& d, int term) {
+	if (current < 0)
+		return;
+	const json::field<T>& f = map[current];
+	current = -1;
+	switch (f.type) {
+	case json::field<T>::INT64_FIELD:
+		if (json::scanner<char>::INTEGER == term)
+			json::parse_integer(d.data(), d.size(), t->*f.member.i64);
+		break;
+	case json::field<T>::INT_FIELD: {
+		int64_t i;
+		if (json::scanner<char>::INTEGER == term && json::parse_integer(d.data(), d.size(), i)
+				&& static_cast<int>(i) == i)
+			t->*f.member.i = static_cast<int>(i);
+		break;
+	}
+	case json::field<T>::DOUBLE_FIELD:
+		if (json::scanner<char>::INTEGER == term || json::scanner<char>::DOUBLE == term)
+			json::parse_double(d.data(), d.size(), t->*f.member.d);
+		break;
+	case json::field<T>::BOOL_FIELD:
+		if (json::scanner<char>::TRUE_CONST == term || json::scanner<char>::FALSE_CONST == term)
+			t->*f.member.b = json::scanner<char>::TRUE_CONST == term;
+		break;
+	case json::field<T>::STRING_FIELD:
+		if (json::scanner<char>::STRING == term)
+			d.decode(t->*f.member.s);
+		break;
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,85 @@
+#ifndef __JSON_CHECKPOINT_HH__
+#define __JSON_CHECKPOINT_HH__
+
+#include <cstddef>
+#include <string>
+#include <stdint.h>
+
+namespace json {
+
+/**
+ * \brief Appends the fields of a checkpoint to a string of bytes, see json::parser::checkpoint. Every field is an
+ * unsigned integer written in groups of 7 bits, the least significant first, and the high bit of a byte is set if
+ * more groups follow. Hence the small values that make up most of a checkpoint take one byte each, and a checkpoint
+ * does not depend on the word size or the byte order of the host that wrote it.
+ */
+class checkpoint_writer {
+public:
+	//! \brief The constructor. The bytes are appended to s.
+	explicit checkpoint_writer(std::string& s) : out(s) {}
+	//! \brief Appends an integer.
+	void put(uint64_t v) {
+		for (; v >= 0x80; v >>= 7)
+			out.push_back(static_cast<char>(0x80 | (v & 0x7f)));
+		out.push_back(static_cast<char>(v));
+	}
+	//! \brief Appends a character, as the value of its code unit.
+	template<typename Char>
+	void put_char(Char c) {
+		put(static_cast<uint64_t>(c) & (~static_cast<uint64_t>(0) >> (64 - 8 * sizeof(Char))));
+	}
+private:
+	//! \brief The string the bytes are appended to.
+	std::string& out;
+};
+
+/**
+ * \brief Reads the fields that json::checkpoint_writer wrote. Every read checks its field: a checkpoint that is
+ * truncated, or that holds a value out of the range of its field, is rejected instead of being trusted.
+ */
+class checkpoint_reader {
+public:
+	//! \brief The constructor. The n bytes starting at p are read.
+	checkpoint_reader(const char *p, size_t n) : cur(reinterpret_cast<const unsigned char *>(p)), end(cur + n) {}
+	/**
+	 * \brief Reads an integer.
+	 *
+	 * \param v Set to the integer.
+	 * \param max The largest valid value.
+	 * \return false if the bytes are exhausted, or if the integer is larger than max or than 64 bits.
+	 */
+	bool get(uint64_t& v, uint64_t max = ~static_cast<uint64_t>(0)) {
+		v = 0;
+		for (unsigned int shift = 0; shift < 64; shift += 7) {
+			if (cur == end)
+				return false;
+			uint64_t group = *cur & 0x7f;
+			if ((group << shift) >> shift != group)
+				return false;
+			v |= group << shift;
+			if (0 == (*cur++ & 0x80))
+				return v <= max;
+		}
+		return false;
+	}
+	//! \brief Reads a character that put_char wrote. \return false if the bytes are exhausted or if it does not fit in Char.
+	template<typename Char>
+	bool get_char(Char& c) {
+		uint64_t v;
+		if (!get(v, ~static_cast<uint64_t>(0) >> (64 - 8 * sizeof(Char))))
+			return false;
+		c = static_cast<Char>(v);
+		return true;
+	}
+	//! \brief true if all the bytes were read.
+	bool at_end() const { return cur == end; }
+private:
+	//! \brief The next byte.
+	const unsigned char *cur;
+	//! \brief One past the last byte.
+	const unsigned char *end;
+};
+
+}
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef __JSON_FILTER_HH__
+#define __JSON_FILTER_HH__
+
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <stdint.h>
+#include "json_handler.hh"
+
+namespace json {
+
+/**
+ * \brief The parser handler that reports the values found at a set of paths, and only those. A path is either a
+ * JSON Pointer, e.g. "/store/book/0/title", or a simple JSONPath, e.g. "$.store.book[0].title". JSONPath
+ * expressions may use the wildcards ".*" and "[*]", and "['key']" for keys that are not identifiers.
+ * A JSON Pointer segment that is a number matches both an array index and a key.
+ *
+ * The filter tracks, for every open container, the paths that may still match inside it. The parser skips the
+ * containers in which no path may match (see json::handler::skip), so the parts of a document that are
+ * of no interest are never tokenized. This works in both chunked and whole-buffer mode.
+ *
+ * A match on a primitive value is reported with the view of the value and its token, like the data events of
+ * json::handler. A match on an object or an array is reported when it starts, with an empty view and the token
+ * L_BRACE or L_BRACKET, and its content is traversed for the other paths.
+ *
+ * \code
+ * json::parser<char, json::path_filter<char> > p;
+ * size_t title = p.handler().add("$.store.book[*].title");
+ * p.handler().hook_match(&on_match);
+ * p.parse(buf, len);
+ * \endcode
+ */
+template<typename Char>
+class path_filter : public json::handler<Char> {
+public:
+	//! \brief The largest number of paths.
+	static const size_t MAX_PATHS = 64;
+	/**
+	 * \brief Specifies the type of the callback that is invoked for a value found at a path. It gets the ID of the
+	 * path, the view of the value, its token, and the context.
+	 */
+	typedef void (*hook_match_t)(size_t, const json::string_ref<Char>&, int, void *);
+
+	//! \brief No path is set.
+	path_filter() : match_cb(0), ctx(0), pending(0) {}
+	/**
+	 * \brief Adds a path. Paths are added before parsing.
+	 *
+	 * \param path A JSON Pointer or a JSONPath expression starting with '$'.
+	 * \return The ID of the path, that is passed to the callback. The IDs are 0, 1, 2 etc. in the order of addition.
+	 * \exception std::invalid_argument if the path is malformed.
+	 * \exception std::length_error if there are already MAX_PATHS paths.
+	 */
+	size_t add(const std::basic_string<Char>&);
+	//! \brief Sets the callback that is invoked for the values found at the paths.
+	void hook_match(hook_match_t cb) { match_cb = cb; }
+	//! \brief Sets the context that is passed to the callback.
+	void set_context(void *c) { ctx = c; }
+
+	//! \brief The event of '{'. \sa handler::obj_start
+	void obj_start() { start(false); }
+	//! \brief The event of a key. It selects the paths that match the value of the key. \sa handler::key
+	inline void key(const json::string_ref<Char>&);
+	//! \brief The event of a value in a key:value pair. \sa handler::obj_data
+	void obj_data(const json::string_ref<Char>& d, int term) { leaf(d, term); }
+	//! \brief The event of '}'. \sa handler::obj_end
+	void obj_end() { frames.pop_back(); }
+	//! \brief The event of '['. \sa handler::array_start
+	void array_start() { start(true); }
+	//! \brief The event of an array element. \sa handler::array_data
+	void array_data(const json::string_ref<Char>& d, int term) { element(); leaf(d, term); }
+	//! \brief The event of ']'. \sa handler::array_end
+	void array_end() { frames.pop_back(); }
+	//! \brief true if no path may match inside the container that was just started. \sa handler::skip
+	bool skip() const { return 0 == frames.back().alive; }
+	//! \brief Drops the containers of an unfinished document, the paths are kept. \sa handler::reset
+	void reset() { frames.clear(); pending = 0; }
+private:
+	//! \brief A step of a path.
+	struct segment_t {
+		//! \brief true if the segment matches any key or index.
+		bool wildcard;
+		//! \brief true if the segment matches a key.
+		bool has_key;
+		//! \brief The key.
+		std::basic_string<Char> key;
+		//! \brief The index it matches, -1 if none.
+		long index;
+	};
+	//! \brief An open container.
+	struct frame_t {
+		//! \brief true for an array.
+		bool array;
+		//! \brief The number of elements of an array seen so far.
+		long count;
+		//! \brief The paths that may match inside the container, one bit per path.
+		uint64_t alive;
+	};
+	//! \brief Parses a JSON Pointer.
+	static void parse_pointer(const std::basic_string<Char>&, std::vector<segment_t>&);
+	//! \brief Parses a JSONPath expression.
+	static void parse_jsonpath(const std::basic_string<Char>&, std::vector<segment_t>&);
+	//! \brief The index denoted by a segment, -1 if it is not a number.
+	static long number(const std::basic_string<Char>&);
+	//! \brief Reports the paths of the mask that end at the current depth.
+	inline void report(uint64_t, size_t, const json::string_ref<Char>&, int);
+	//! \brief Starts a container.
+	void start(bool);
+	//! \brief Selects the paths that match the next element of the current array.
+	void element();
+	//! \brief Handles a primitive value.
+	void leaf(const json::string_ref<Char>& d, int term) { report(pending, frames.size(), d, term); pending = 0; }
+
+	//! \brief The paths.
+	std::vector<std::vector<segment_t> > paths;
+	//! \brief The callback.
+	hook_match_t match_cb;
+	//! \brief The context.
+	void *ctx;
+	//! \brief The containers on the path from the root to the current value.
+	std::vector<frame_t> frames;
+	//! \brief The paths that match the position of the next value, one bit per path.
+	uint64_t pending;
+	//! \brief The buffer escaped keys are decoded in.
+	std::basic_string<Char> scratch;
+};
+
+template<typename Char>
+long
+path_filter<Char>::number(const std::basic_string<Char>& s) {
+	if (s.empty() || s.size() > 9 || (s.size() > 1 && static_cast<Char>('0') == s[0]))
+		return -1;
+	long r = 0;
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] < static_cast<Char>('0') || s[i] > static_cast<Char>('9'))
+			return -1;
+		r = r * 10 + (s[i] - static_cast<Char>('0'));
+	}
+	return r;
+}
+
+template<typename Char>
+void
+path_filter<Char>::parse_pointer(const std::basic_string<Char>& path, std::vector<segment_t>& r) {
+	// "" is the whole document, every segment starts with '/'
+	size_t i = 0;
+	while (i < path.size()) {
+		if (static_cast<Char>('/') != path[i])
+			throw std::invalid_argument("JSON Pointer segments start with '/'");
+		segment_t seg;
+		seg.wildcard = false;
+		seg.has_key = true;
+		for (++i; i < path.size() && static_cast<Char>('/') != path[i]; ++i) {
+			if (static_cast<Char>('~') != path[i]) {
+				seg.key.push_back(path[i]);
+				continue;
+			}
+			if (++i == path.size() || (static_cast<Char>('0') != path[i] && static_cast<Char>('1') != path[i]))
+				throw std::invalid_argument("Invalid escape in JSON Pointer");
+			seg.key.push_back(static_cast<Char>(static_cast<Char>('0') == path[i] ? '~' : '/'));
+		}
+		seg.index = number(seg.key);
+		r.push_back(seg);
+	}
+}
+
+template<typename Char>
+void
+path_filter<Char>::parse_jsonpath(const std::basic_string<Char>& path, std::vector<segment_t>& r) {
+	size_t i = 1;
+	while (i < path.size()) {
+		segment_t seg;
+		seg.wildcard = false;
+		seg.has_key = false;
+		seg.index = -1;
+		if (static_cast<Char>('.') == path[i]) {
+			size_t j = ++i;
+			while (j < path.size() && static_cast<Char>('.') != path[j] && static_cast<Char>('[') != path[j])
+				++j;
+			if (j == i)
+				throw std::invalid_argument("Empty JSONPath member");
+			seg.key.assign(path, i, j - i);
+			seg.wildcard = 1 == seg.key.size() && static_cast<Char>('*') == seg.key[0];
+			seg.has_key = !seg.wildcard;
+			i = j;
+		} else if (static_cast<Char>('[') == path[i]) {
+			size_t j = path.find(static_cast<Char>(']'), i);
+			if (std::basic_string<Char>::npos == j)
+				throw std::invalid_argument("Unterminated JSONPath subscript");
+			std::basic_string<Char> sub(path, i + 1, j - i - 1);
+			if (sub.size() >= 2 && static_cast<Char>('\'') == sub[0] && static_cast<Char>('\'') == sub[sub.size() - 1]) {
+				seg.key.assign(sub, 1, sub.size() - 2);
+				seg.has_key = true;
+			} else if (1 == sub.size() && static_cast<Char>('*') == sub[0])
+				seg.wildcard = true;
+			else if ((seg.index = number(sub)) < 0)
+				throw std::invalid_argument("Invalid JSONPath subscript");
+			i = j + 1;
+		} else
+			throw std::invalid_argument("Invalid JSONPath step");
+		r.push_back(seg);
+	}
+}
+
+template<typename Char>
+size_t
+path_filter<Char>::add(const std::basic_string<Char>& path) {
+	if (paths.size() == MAX_PATHS)
+		throw std::length_error("Too many paths");
+	std::vector<segment_t> segs;
+	if (!path.empty() && static_cast<Char>('$') == path[0])
+		parse_jsonpath(path, segs);
+	else
+		parse_pointer(path, segs);
+	paths.push_back(segs);
+	return paths.size() - 1;
+}
+
+template<typename Char>
+inline void
+path_filter<Char>::report(uint64_t mask, size_t depth, const json::string_ref<Char>& d, int term) {
+	for (; 0 != mask; mask &= mask - 1) {
+		size_t p = __builtin_ctzll(mask);
+		if (paths[p].size() == depth && 0 != match_cb)
+			(*match_cb)(p, d, term, ctx);
+	}
+}
+
+template<typename Char>
+void
+path_filter<Char>::start(bool array) {
+	uint64_t mask;
+	if (frames.empty()) {
+		// the root
+		mask = 0 == paths.size() ? 0 : ~static_cast<uint64_t>(0) >> (64 - paths.size());
+	} else {
+		if (frames.back().array)
+			element();
+		mask = pending;
+	}
+	pending = 0;
+	size_t depth = frames.size();
+	report(mask, depth, json::string_ref<Char>(),
+		array ? json::scanner<Char>::L_BRACKET : json::scanner<Char>::L_BRACE);
+	frame_t f;
+	f.array = array;
+	f.count = 0;
+	f.alive = 0;
+	for (uint64_t m = mask; 0 != m; m &= m - 1) {
+		size_t p = __builtin_ctzll(m);
+		if (paths[p].size() > depth)
+			f.alive |= static_cast<uint64_t>(1) << p;
+	}
+	frames.push_back(f);
+}
+
+template<typename Char>
+void
+path_filter<Char>::element() {
+	frame_t& f = frames.back();
+	long i = f.count++;
+	size_t depth = frames.size() - 1;
+	pending = 0;
+	for (uint64_t m = f.alive; 0 != m; m &= m - 1) {
+		size_t p = __builtin_ctzll(m);
+		const segment_t& seg = paths[p][depth];
+		if (seg.wildcard || seg.index == i)
+			pending |= static_cast<uint64_t>(1) << p;
+	}
+}
+
+template<typename Char>
+inline void
+path_filter<Char>::key(const json::string_ref<Char>& k) {
+	const Char *p = k.data();
+	size_t n = k.size();
+	if (k.escaped()) {
+		k.decode(scratch);
+		p = scratch.data();
+		n = scratch.size();
+	}
+	const frame_t& f = frames.back();
+	size_t depth = frames.size() - 1;
+	pending = 0;
+	for (uint64_t m = f.alive; 0 != m; m &= m - 1) {
+		size_t i = __builtin_ctzll(m);
+		const segment_t& seg = paths[i][depth];
+		if (seg.wildcard || (seg.has_key && seg.key.size() == n && 0 == seg.key.compare(0, n, p, n)))
+			pending |= static_cast<uint64_t>(1) << i;
+	}
+}
+
+}
+
+#endif
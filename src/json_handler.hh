@@ -0,0 +1,480 @@
+#ifndef __JSON_HANDLER_HH__
+#define __JSON_HANDLER_HH__
+
+#include <string>
+#include <stdint.h>
+#include "json_scanner.hh"
+#include "json_number.hh"
+#include "json_intern.hh"
+
+namespace json {
+
+/**
+ * \brief The base of the handlers of json::parser. The parser invokes the events of its handler as it encounters
+ * the parts of the document. The events of this class do nothing. A handler derives from it and defines
+ * the events it is interested in, the other ones compile to nothing. The events are not virtual.
+ * 
+ * The views passed to the events are valid only during the event. \sa json::string_ref
+ */
+template<typename Char>
+class handler {
+public:
+	//! \brief Called when '{' is encountered.
+	void obj_start() {}
+	//! \brief Called when the key of a key:value pair is encountered.
+	void key(const json::string_ref<Char>&) {}
+	/**
+	 * \brief Called when a value of primitive type is encountered in a key:value pair.
+	 * 
+	 * \param data The text of the value.
+	 * \param term The token of the value, e.g. json::scanner::STRING or json::scanner::INTEGER.
+	 */
+	void obj_data(const json::string_ref<Char>&, int) {}
+	//! \brief Called when '}' is encountered.
+	void obj_end() {}
+	//! \brief Called when '[' is encountered.
+	void array_start() {}
+	//! \brief Called when an array element of primitive type is encountered. \sa obj_data
+	void array_data(const json::string_ref<Char>&, int) {}
+	//! \brief Called when ']' is encountered.
+	void array_end() {}
+	//! \brief Called when a document is complete, in multi-document mode only. \sa parser::set_multi_document
+	void document_end() {}
+	/**
+	 * \brief Called when the parser is \link json::parser::reset reset\endlink, e.g. after it returned ERROR. A handler
+	 * that keeps the state of the current document drops it here, so that the next document starts afresh.
+	 */
+	void reset() {}
+	/**
+	 * \brief Queried right after obj_start and array_start. If it returns true, the content of the container is
+	 * skipped: it is not broken into tokens, no event is called for it and it is not validated besides the nesting
+	 * of the brackets. The end event of the container follows. \sa json::parser
+	 */
+	bool skip() const { return false; }
+};
+
+/**
+ * \brief The handler that forwards the events to callbacks that are set at run time, together with a
+ * context that is passed to every callback. It is the default handler of json::parser.
+ * A callback that is not set costs one test per event.
+ */
+template<typename Char>
+class hooks {
+public:
+	//! \brief No callback is set.
+	hooks();
+
+	/**
+	 * \brief Specifies the type of the callback that is invoked when a key in a
+	 * key:value pair is encountered.
+	 */
+	typedef void (*hook_key_t)(const std::basic_string<Char>&, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when primitive
+	 * data (strings, booleans, numbers, the null constant) are encountered as
+	 * values in key:value pairs or in array elements.
+	 */
+	typedef void (*hook_primitive_t)(const std::basic_string<Char>&, int, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when objects or arrays start
+	 * or end.
+	 */
+	typedef void (*hook_start_end_t)(void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when a key in a key:value pair is encountered
+	 * and that gets a view of the key instead of a copy. The view is valid only during the callback.
+	 * \sa json::string_ref
+	 */
+	typedef void (*hook_key_ref_t)(const json::string_ref<Char>&, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when primitive data are encountered and that
+	 * gets a view of the data instead of a copy. The view is valid only during the callback.
+	 * \sa json::string_ref
+	 */
+	typedef void (*hook_primitive_ref_t)(const json::string_ref<Char>&, int, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when an integer that fits in 64 bits is
+	 * encountered as a value in a key:value pair or as an array element.
+	 */
+	typedef void (*hook_integer_t)(int64_t, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when a number is encountered as a value in a
+	 * key:value pair or as an array element and it is not passed to a \link json::hooks::hook_integer_t hook_integer_t\endlink
+	 * callback.
+	 */
+	typedef void (*hook_double_t)(double, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when one of the constants true, false, or null is
+	 * encountered as a value in a key:value pair or as an array element. It gets the token, i.e. one of
+	 * json::scanner::TRUE_CONST, json::scanner::FALSE_CONST, and json::scanner::NULL_CONST.
+	 */
+	typedef void (*hook_literal_t)(int, void *);
+	/**
+	 * \brief Specifies the type of the callback that is invoked when a key in a key:value pair is encountered and
+	 * that gets the ID of the key in the \link json::hooks::set_key_table key table\endlink, or
+	 * json::key_table::NO_KEY if the table is full.
+	 */
+	typedef void (*hook_key_id_t)(int, void *);
+	
+	//! \brief Sets the callback that is called when '{' is encountered.
+	inline void hook_obj_start(hook_start_end_t);
+	//! \brief Sets the callback that is called when the key of a key:value pair is encountered.
+	inline void hook_key(hook_key_t);
+	//! \brief Sets the callback that is called when a value of primitive type is encountered in a key:value pair
+	inline void hook_obj_data(hook_primitive_t);
+	//! \brief Sets the callback that is called when '}' is encountered.
+	inline void hook_obj_end(hook_start_end_t);
+	//! \brief Sets the callback that is called when '[' is encountered.
+	inline void hook_array_start(hook_start_end_t);
+	//! \brief Sets the callback that is called when an array element of primitive type is encountered.
+	inline void hook_array_data(hook_primitive_t);
+	//! \brief Sets the callback that is called when ']' is encountered.
+	inline void hook_array_end(hook_start_end_t);
+	//! \brief Sets the callback that is called when a document is complete, in multi-document mode.
+	inline void hook_document_end(hook_start_end_t);
+	//! \brief Sets the callback that gets a view of the key of a key:value pair. \sa hook_key
+	inline void hook_key_ref(hook_key_ref_t);
+	//! \brief Sets the callback that gets a view of a value of primitive type in a key:value pair. \sa hook_obj_data
+	inline void hook_obj_data_ref(hook_primitive_ref_t);
+	//! \brief Sets the callback that gets a view of an array element of primitive type. \sa hook_array_data
+	inline void hook_array_data_ref(hook_primitive_ref_t);
+	/**
+	 * \brief Sets the callback that gets the value of an integer in a key:value pair. The number is converted in place,
+	 * no string is built for it. Integers that do not fit in 64 bits go to the
+	 * \link json::hooks::hook_obj_double hook_obj_double\endlink callback.
+	 */
+	inline void hook_obj_integer(hook_integer_t);
+	/**
+	 * \brief Sets the callback that gets the value of a number with a fraction or an exponent in a key:value pair.
+	 * It gets the integers as well if no \link json::hooks::hook_obj_integer hook_obj_integer\endlink callback is set.
+	 */
+	inline void hook_obj_double(hook_double_t);
+	//! \brief Sets the callback that gets the value of an integer array element. \sa hook_obj_integer
+	inline void hook_array_integer(hook_integer_t);
+	//! \brief Sets the callback that gets the value of a number array element. \sa hook_obj_double
+	inline void hook_array_double(hook_double_t);
+	//! \brief Sets the callback that is called when true, false, or null is encountered in a key:value pair.
+	inline void hook_obj_literal(hook_literal_t);
+	//! \brief Sets the callback that is called when true, false, or null is encountered as an array element.
+	inline void hook_array_literal(hook_literal_t);
+	//! \brief Sets the callback that gets the ID of the key of a key:value pair. \sa set_key_table
+	inline void hook_key_id(hook_key_id_t);
+	/**
+	 * \brief Sets the table the keys are interned in for the \link json::hooks::hook_key_id hook_key_id\endlink
+	 * callback. The table is not owned and may be shared by several parsers that run one after the other.
+	 */
+	inline void set_key_table(json::key_table<Char> *);
+	//! \brief Sets a context that is passed to every callback.
+	inline void set_context(void *);
+
+	//! \brief The event of '{'. \sa handler::obj_start
+	inline void obj_start();
+	//! \brief The event of a key. \sa handler::key
+	inline void key(const json::string_ref<Char>&);
+	//! \brief The event of a value in a key:value pair. \sa handler::obj_data
+	inline void obj_data(const json::string_ref<Char>&, int);
+	//! \brief The event of '}'. \sa handler::obj_end
+	inline void obj_end();
+	//! \brief The event of '['. \sa handler::array_start
+	inline void array_start();
+	//! \brief The event of an array element. \sa handler::array_data
+	inline void array_data(const json::string_ref<Char>&, int);
+	//! \brief The event of ']'. \sa handler::array_end
+	inline void array_end();
+	//! \brief The event of the end of a document. \sa handler::document_end
+	inline void document_end();
+	//! \brief The callbacks keep no state of the document, nothing is dropped. \sa handler::reset
+	void reset() {}
+	//! \brief Nothing is skipped. \sa handler::skip
+	bool skip() const { return false; }
+private:
+	/**
+	 * \brief The buffer in which the text of the current token is decoded for the callbacks that take strings. It
+	 * is reused from token to token. Tokens are decoded only if such callbacks are set.
+	 */
+	std::basic_string<Char> token;
+
+	//! \brief The callback that is called when '{' is encountered.
+	hook_start_end_t obj_start_cb;
+	//! \brief The callback that is called when the key of a key:value pair is encountered.
+	hook_key_t  key_cb;
+	//! \brief The callback that is called when a value of primitive type is encountered in a key:value pair
+	hook_primitive_t obj_data_cb;
+	//! \brief The callback that is called when '}' is encountered.
+	hook_start_end_t obj_end_cb;
+	//! \brief The callback that is called when '[' is encountered.
+	hook_start_end_t array_start_cb;
+	//! \brief The callback that is called when an array element of primitive type is encountered.
+	hook_primitive_t array_data_cb;
+	//! \brief The callback that is called when ']' is encountered.
+	hook_start_end_t array_end_cb;
+	//! \brief The callback that is called when a document is complete.
+	hook_start_end_t document_end_cb;
+	//! \brief The callback that gets a view of the key of a key:value pair.
+	hook_key_ref_t key_ref_cb;
+	//! \brief The callback that gets a view of a value of primitive type in a key:value pair.
+	hook_primitive_ref_t obj_data_ref_cb;
+	//! \brief The callback that gets a view of an array element of primitive type.
+	hook_primitive_ref_t array_data_ref_cb;
+	//! \brief The callback that gets the value of an integer in a key:value pair.
+	hook_integer_t obj_integer_cb;
+	//! \brief The callback that gets the value of a number in a key:value pair.
+	hook_double_t obj_double_cb;
+	//! \brief The callback that gets the value of an integer array element.
+	hook_integer_t array_integer_cb;
+	//! \brief The callback that gets the value of a number array element.
+	hook_double_t array_double_cb;
+	//! \brief The callback that is called when true, false, or null is encountered in a key:value pair.
+	hook_literal_t obj_literal_cb;
+	//! \brief The callback that is called when true, false, or null is encountered as an array element.
+	hook_literal_t array_literal_cb;
+	//! \brief The callback that gets the ID of the key of a key:value pair.
+	hook_key_id_t key_id_cb;
+	//! \brief The table the keys are interned in.
+	json::key_table<Char> *keys;
+	//! \brief The context that is passed to every callback.
+	void *ctx;
+
+	//! \brief Decodes the text of the current token into \link json::hooks::token token\endlink.
+	inline const std::basic_string<Char>& text(const json::string_ref<Char>&);
+	/**
+	 * \brief Converts the current token, if it is a number, and passes it to the number callbacks.
+	 * 
+	 * \param t The text of the current token.
+	 * \param term The currently scanned terminal.
+	 * \param integer_cb The callback for integers, possibly 0.
+	 * \param double_cb The callback for the other numbers, possibly 0.
+	 */
+	inline void number(const json::string_ref<Char>&, int, hook_integer_t, hook_double_t);
+};
+
+template<typename Char>
+hooks<Char>::hooks() :
+	obj_start_cb(0), key_cb(0), obj_data_cb(0), obj_end_cb(0),
+	array_start_cb(0), array_data_cb(0), array_end_cb(0), document_end_cb(0),
+	key_ref_cb(0), obj_data_ref_cb(0), array_data_ref_cb(0),
+	obj_integer_cb(0), obj_double_cb(0), array_integer_cb(0), array_double_cb(0),
+	obj_literal_cb(0), array_literal_cb(0),
+	key_id_cb(0), keys(0),
+	ctx(0)
+{
+}
+
+template<typename Char>
+inline const std::basic_string<Char>&
+hooks<Char>::text(const json::string_ref<Char>& t) {
+	t.decode(token);
+	return token;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::number(const json::string_ref<Char>& t, int term, hook_integer_t integer_cb, hook_double_t double_cb) {
+	if (json::scanner<Char>::INTEGER == term && 0 != integer_cb) {
+		int64_t i;
+		if (json::parse_integer(t.data(), t.size(), i)) {
+			(*integer_cb)(i, ctx);
+			return;
+		}
+	} else if (json::scanner<Char>::INTEGER != term && json::scanner<Char>::DOUBLE != term)
+		return;
+	double d;
+	if (0 != double_cb && json::parse_double(t.data(), t.size(), d))
+		(*double_cb)(d, ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::obj_start() {
+	if (0 != obj_start_cb)
+		(*obj_start_cb)(ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::key(const json::string_ref<Char>& t) {
+	if (0 != key_ref_cb)
+		(*key_ref_cb)(t, ctx);
+	if (0 != key_cb)
+		(*key_cb)(text(t), ctx);
+	if (0 != key_id_cb && 0 != keys)
+		(*key_id_cb)(keys->intern(t), ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::obj_data(const json::string_ref<Char>& t, int term) {
+	if (0 != obj_data_ref_cb)
+		(*obj_data_ref_cb)(t, term, ctx);
+	if (0 != obj_data_cb)
+		(*obj_data_cb)(text(t), term, ctx);
+	if (0 != obj_integer_cb || 0 != obj_double_cb)
+		number(t, term, obj_integer_cb, obj_double_cb);
+	if (0 != obj_literal_cb && term >= json::scanner<Char>::TRUE_CONST)
+		(*obj_literal_cb)(term, ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::obj_end() {
+	if (0 != obj_end_cb)
+		(*obj_end_cb)(ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::array_start() {
+	if (0 != array_start_cb)
+		(*array_start_cb)(ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::array_data(const json::string_ref<Char>& t, int term) {
+	if (0 != array_data_ref_cb)
+		(*array_data_ref_cb)(t, term, ctx);
+	if (0 != array_data_cb)
+		(*array_data_cb)(text(t), term, ctx);
+	if (0 != array_integer_cb || 0 != array_double_cb)
+		number(t, term, array_integer_cb, array_double_cb);
+	if (0 != array_literal_cb && term >= json::scanner<Char>::TRUE_CONST)
+		(*array_literal_cb)(term, ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::array_end() {
+	if (0 != array_end_cb)
+		(*array_end_cb)(ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::document_end() {
+	if (0 != document_end_cb)
+		(*document_end_cb)(ctx);
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_start(hook_start_end_t cb) {
+	obj_start_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_key(hook_key_t cb) {
+	key_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_data(hook_primitive_t cb) {
+	obj_data_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_end(hook_start_end_t cb) {
+	obj_end_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_start(hook_start_end_t cb) {
+	array_start_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_data(hook_primitive_t cb) {
+	array_data_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_end(hook_start_end_t cb) {
+	array_end_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_document_end(hook_start_end_t cb) {
+	document_end_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_key_ref(hook_key_ref_t cb) {
+	key_ref_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_data_ref(hook_primitive_ref_t cb) {
+	obj_data_ref_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_data_ref(hook_primitive_ref_t cb) {
+	array_data_ref_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_integer(hook_integer_t cb) {
+	obj_integer_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_double(hook_double_t cb) {
+	obj_double_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_integer(hook_integer_t cb) {
+	array_integer_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_double(hook_double_t cb) {
+	array_double_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_obj_literal(hook_literal_t cb) {
+	obj_literal_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_array_literal(hook_literal_t cb) {
+	array_literal_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::hook_key_id(hook_key_id_t cb) {
+	key_id_cb = cb;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::set_key_table(json::key_table<Char> *t) {
+	keys = t;
+}
+
+template<typename Char>
+inline void
+hooks<Char>::set_context(void *ctx_) {
+	ctx = ctx_;
+}
+
+}
+
+#endif
@@ -0,0 +1,90 @@
+#include <cstring>
+#include "json_index.hh"
+#include "json_simd.hh"
+
+namespace json {
+
+namespace {
+
+const uint64_t EVEN_BITS = 0x5555555555555555ULL;
+
+/**
+ * \brief Finds the characters that are escaped by a backslash, i.e. the ones preceded by an odd-length
+ * sequence of backslashes.
+ *
+ * \param backslash The backslashes of the block.
+ * \param prev_escaped In: 1 if the first character of the block is escaped by the last backslash of the
+ * previous block. Out: the same for the next block.
+ * \return The escaped characters of the block.
+ */
+inline uint64_t
+find_escaped(uint64_t backslash, uint64_t& prev_escaped) {
+	// a backslash that is escaped itself does not start a sequence
+	backslash &= ~prev_escaped;
+	uint64_t follows_escape = (backslash << 1) | prev_escaped;
+	// the sequences starting on odd bits. Adding them to the backslashes carries through the sequences.
+	uint64_t odd_starts = backslash & ~EVEN_BITS & ~follows_escape;
+	uint64_t even_starts;
+	prev_escaped = __builtin_add_overflow(odd_starts, backslash, &even_starts) ? 1 : 0;
+	uint64_t invert = even_starts << 1;
+	return (EVEN_BITS ^ invert) & follows_escape;
+}
+
+/**
+ * \brief Computes the prefix xor of x, i.e. bit i of the result is the xor of the bits 0 to i of x.
+ * Applied to the unescaped quotes, it gives the characters inside strings, including the opening
+ * quotes and excluding the closing ones.
+ */
+inline uint64_t
+prefix_xor(uint64_t x) {
+	x ^= x << 1;
+	x ^= x << 2;
+	x ^= x << 4;
+	x ^= x << 8;
+	x ^= x << 16;
+	x ^= x << 32;
+	return x;
+}
+
+}
+
+template<>
+bool
+structural_index<char>::build(const char *p, size_t n) {
+	uint64_t prev_escaped = 0;
+	// all ones if the previous block ends inside a string
+	uint64_t prev_in_string = 0;
+	// 1 if the last character of the previous block is part of a primitive token
+	uint64_t prev_primitive = 0;
+	char tail[64];
+
+	pos.clear();
+	for (size_t b = 0; b < n; b += 64) {
+		const char *block = p + b;
+		if (n - b < 64) {
+			// pad the last block with blanks
+			memset(tail, ' ', sizeof(tail));
+			memcpy(tail, block, n - b);
+			block = tail;
+		}
+		json::simd::block_masks_t m;
+		json::simd::classify(block, m);
+
+		uint64_t quote = m.quote & ~find_escaped(m.backslash, prev_escaped);
+		uint64_t in_string = prefix_xor(quote) ^ prev_in_string;
+		prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+		uint64_t op = m.op & ~in_string;
+		uint64_t primitive = ~(m.op | m.blank | quote | in_string);
+		uint64_t primitive_start = primitive & ~((primitive << 1) | prev_primitive);
+		prev_primitive = primitive >> 63;
+
+		uint64_t bits = op | quote | primitive_start;
+		while (0 != bits) {
+			pos.push_back(b + __builtin_ctzll(bits));
+			bits &= bits - 1;
+		}
+	}
+	return 0 == prev_in_string;
+}
+
+}
@@ -0,0 +1,119 @@
+#ifndef __JSON_INDEX_HH__
+#define __JSON_INDEX_HH__
+
+#include <cstddef>
+#include <vector>
+#include "json_resource.hh"
+
+namespace json {
+
+/**
+ * \brief The structural index of a JSON document held in one buffer. It is the first stage of a two-stage
+ * parse: the index lists, in increasing order, the positions of
+ * - the punctuation characters {}[]:, that are not inside strings,
+ * - the opening and the closing quote of every string,
+ * - the first character of every other token outside strings (numbers, true, false, null).
+ *
+ * Hence the quotes come in pairs. The characters between two consecutive positions of the index are either
+ * blanks, the body of a string, or the rest of a primitive token.
+ *
+ * The index is built for char with vectorised kernels (see json::simd) that process 64 characters at a time.
+ * Other character types are indexed by a scalar loop. The second stage, performed by
+ * \link json::parser::parse(const Char *, size_t) parser::parse\endlink, consumes the index. The index may
+ * as well be used on its own, e.g. to locate the elements of an array.
+ */
+template<typename Char>
+class structural_index {
+public:
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param r The resource the positions are allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit structural_index(json::memory_resource *r = 0) : pos(json::allocator<size_t>(r)) {}
+	/**
+	 * \brief Builds the index of the n characters starting at p. Any previous content is discarded but the
+	 * capacity is kept.
+	 *
+	 * \param p The first character of the buffer.
+	 * \param n The number of characters in the buffer.
+	 * \return false if the buffer ends inside a string.
+	 */
+	bool build(const Char *, size_t);
+	//! \brief Reserves room for n positions, e.g. for buffers of up to n characters, whose index never holds more.
+	void reserve(size_t n) { pos.reserve(n); }
+	//! \brief The number of indexed positions.
+	size_t size() const { return pos.size(); }
+	//! \brief The indexed positions.
+	const size_t *data() const { return pos.empty() ? 0 : &pos[0]; }
+	//! \brief The i-th indexed position.
+	size_t operator[](size_t i) const { return pos[i]; }
+private:
+	//! \brief The positions, relative to the start of the buffer.
+	std::vector<size_t, json::allocator<size_t> > pos;
+};
+
+template<typename Char>
+bool
+structural_index<Char>::build(const Char *p, size_t n) {
+	bool in_string = false;
+	// true if the current character is preceded by an odd number of backslashes. Like in the vectorised
+	// version, this is tracked inside and outside strings, and an escaped quote never starts or ends a string.
+	bool escaped = false;
+	// true if the previous character is part of a primitive token
+	bool primitive = false;
+
+	pos.clear();
+	for (size_t i = 0; i < n; ++i) {
+		Char c = p[i];
+		bool quote = c == static_cast<Char>('"') && !escaped;
+		escaped = c == static_cast<Char>('\\') && !escaped;
+		if (in_string) {
+			if (quote) {
+				in_string = false;
+				pos.push_back(i);
+			}
+			continue;
+		}
+		if (quote) {
+			in_string = true;
+			pos.push_back(i);
+			primitive = false;
+			continue;
+		}
+		switch (c) {
+		case static_cast<Char>('{'):
+		case static_cast<Char>('}'):
+		case static_cast<Char>('['):
+		case static_cast<Char>(']'):
+		case static_cast<Char>(':'):
+		case static_cast<Char>(','):
+			pos.push_back(i);
+			// fall through
+		case static_cast<Char>(' '):
+		case static_cast<Char>('\t'):
+		case static_cast<Char>('\n'):
+		case static_cast<Char>('\r'):
+		case static_cast<Char>('\f'):
+			primitive = false;
+			break;
+		default:
+			if (!primitive)
+				pos.push_back(i);
+			primitive = true;
+			break;
+		}
+	}
+	return !in_string;
+}
+
+/**
+ * \brief Builds the index of the n characters starting at p with the vectorised kernels.
+ * \sa structural_index::build
+ */
+template<>
+bool structural_index<char>::build(const char *, size_t);
+
+}
+
+#endif
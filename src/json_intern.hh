@@ -0,0 +1,165 @@
+#ifndef __JSON_INTERN_HH__
+#define __JSON_INTERN_HH__
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "json_scanner.hh"
+
+namespace json {
+
+/**
+ * \brief A bounded table of interned keys. Each distinct key gets a small integer ID, starting from 0, and one
+ * copy of its text that is shared by all its occurrences. Since documents of the same schema repeat the same
+ * keys, the table is meant to be kept across documents; keys may then be compared by ID.
+ *
+ * The table holds at most the number of keys given to the constructor. Once it is full, new keys are not
+ * interned and \link json::key_table::intern intern\endlink returns NO_KEY, so documents with arbitrary keys
+ * cannot make it grow without bound. The hash is open addressing over 8-byte slots that keep the hash of
+ * the key, so a lookup usually reads one cache line and compares one string.
+ *
+ * \code
+ * json::key_table<char> keys;
+ * json::parser<char> p;
+ * p.set_key_table(&keys);
+ * p.hook_key_id(&on_key);
+ * \endcode
+ */
+template<typename Char>
+class key_table {
+public:
+	//! \brief The ID returned for keys that are not interned.
+	static const int NO_KEY = -1;
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param max_keys The largest number of keys the table holds.
+	 */
+	explicit key_table(size_t = 256);
+	/**
+	 * \brief Interns a key.
+	 *
+	 * \param p The first character of the decoded key.
+	 * \param n The number of characters.
+	 * \return The ID of the key, NO_KEY if it is new and the table is full.
+	 */
+	int intern(const Char *, size_t);
+	/**
+	 * \brief Interns the key of a token, decoding its escape sequences first.
+	 * \sa intern(const Char *, size_t)
+	 */
+	inline int intern(const json::string_ref<Char>&);
+	/**
+	 * \brief Looks a key up without interning it.
+	 *
+	 * \return The ID of the key, NO_KEY if it is not interned.
+	 */
+	int find(const Char *, size_t) const;
+	//! \brief The text of the key of an ID. The reference is valid until the table is cleared or destroyed.
+	const std::basic_string<Char>& name(int id) const { return keys[id]; }
+	//! \brief The number of interned keys.
+	size_t size() const { return keys.size(); }
+	//! \brief The largest number of keys the table holds.
+	size_t capacity() const { return max; }
+	//! \brief Forgets all keys.
+	void clear();
+private:
+	//! \brief A slot of the hash.
+	struct slot_t {
+		//! \brief The hash of the key.
+		uint32_t hash;
+		//! \brief The ID of the key, NO_KEY for an empty slot.
+		int id;
+	};
+	//! \brief The FNV-1a hash of a key.
+	static uint32_t hash(const Char *, size_t);
+	//! \brief The slot of a key: either its slot or the empty one where it would go.
+	size_t lookup(const Char *, size_t, uint32_t) const;
+
+	//! \brief The hash. Its size is a power of 2, at least twice the largest number of keys.
+	std::vector<slot_t> slots;
+	//! \brief The keys, indexed by ID. Their storage is reserved at construction, so they never move.
+	std::vector<std::basic_string<Char> > keys;
+	//! \brief The largest number of keys.
+	size_t max;
+	//! \brief The buffer escaped keys are decoded in.
+	std::basic_string<Char> scratch;
+};
+
+template<typename Char>
+key_table<Char>::key_table(size_t max_keys) : max(max_keys) {
+	size_t n = 8;
+	while (n < 2 * max)
+		n *= 2;
+	slot_t empty = {0, NO_KEY};
+	slots.assign(n, empty);
+	keys.reserve(max);
+}
+
+template<typename Char>
+uint32_t
+key_table<Char>::hash(const Char *p, size_t n) {
+	uint32_t h = 2166136261U;
+	for (size_t i = 0; i < n; ++i) {
+		h ^= static_cast<uint32_t>(p[i]);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+template<typename Char>
+size_t
+key_table<Char>::lookup(const Char *p, size_t n, uint32_t h) const {
+	size_t mask = slots.size() - 1;
+	size_t s = h & mask;
+	for (; NO_KEY != slots[s].id; s = (s + 1) & mask) {
+		if (slots[s].hash != h)
+			continue;
+		const std::basic_string<Char>& k = keys[slots[s].id];
+		if (k.size() == n && 0 == k.compare(0, n, p, n))
+			break;
+	}
+	return s;
+}
+
+template<typename Char>
+int
+key_table<Char>::intern(const Char *p, size_t n) {
+	uint32_t h = hash(p, n);
+	slot_t& s = slots[lookup(p, n, h)];
+	if (NO_KEY != s.id)
+		return s.id;
+	if (keys.size() >= max)
+		return NO_KEY;
+	s.hash = h;
+	s.id = static_cast<int>(keys.size());
+	keys.push_back(std::basic_string<Char>(p, n));
+	return s.id;
+}
+
+template<typename Char>
+inline int
+key_table<Char>::intern(const json::string_ref<Char>& k) {
+	if (!k.escaped())
+		return intern(k.data(), k.size());
+	k.decode(scratch);
+	return intern(scratch.data(), scratch.size());
+}
+
+template<typename Char>
+int
+key_table<Char>::find(const Char *p, size_t n) const {
+	return slots[lookup(p, n, hash(p, n))].id;
+}
+
+template<typename Char>
+void
+key_table<Char>::clear() {
+	slot_t empty = {0, NO_KEY};
+	slots.assign(slots.size(), empty);
+	keys.clear();
+}
+
+}
+
+#endif
@@ -0,0 +1,53 @@
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "json_mmap.hh"
+
+namespace json {
+
+void
+mapped_file::open(const char *path) {
+	close();
+	int fd = ::open(path, O_RDONLY);
+	if (fd < 0)
+		throw std::runtime_error(std::string(path) + ": " + strerror(errno));
+	struct stat st;
+	if (0 != fstat(fd, &st)) {
+		int e = errno;
+		::close(fd);
+		throw std::runtime_error(std::string(path) + ": " + strerror(e));
+	}
+	if (0 == st.st_size) {
+		// empty files cannot be mapped
+		::close(fd);
+		return;
+	}
+	void *m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int e = errno;
+	// the mapping keeps the file
+	::close(fd);
+	if (MAP_FAILED == m)
+		throw std::runtime_error(std::string(path) + ": " + strerror(e));
+	p = static_cast<char *>(m);
+	n = st.st_size;
+	// advice only, failures do not matter
+	madvise(p, n, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(p, n, MADV_HUGEPAGE);
+#endif
+}
+
+void
+mapped_file::close() {
+	if (0 != p)
+		munmap(p, n);
+	p = 0;
+	n = 0;
+}
+
+}
@@ -0,0 +1,44 @@
+#ifndef __JSON_MMAP_HH__
+#define __JSON_MMAP_HH__
+
+#include <cstddef>
+
+namespace json {
+
+/**
+ * \brief A read-only memory mapping of a whole file. The pages are read by the kernel as they are touched, and
+ * they are advised to be read sequentially, and to be backed by huge pages where the system supports it. Nothing
+ * is copied, so the views of the tokens of a document parsed from the mapping point into the file.
+ */
+class mapped_file {
+public:
+	//! \brief Nothing is mapped.
+	mapped_file() : p(0), n(0) {}
+	//! \brief Unmaps the file.
+	~mapped_file() { close(); }
+	/**
+	 * \brief Maps a file. The previous mapping, if any, is released first.
+	 *
+	 * \param path The path of the file.
+	 * \exception std::runtime_error if the file cannot be opened or mapped.
+	 */
+	void open(const char *);
+	//! \brief Unmaps the file, if any.
+	void close();
+	//! \brief The first byte of the file, 0 if the file is empty or not mapped.
+	const char *data() const { return p; }
+	//! \brief The size of the file.
+	size_t size() const { return n; }
+private:
+	//! \brief The mapping.
+	char *p;
+	//! \brief The size of the mapping.
+	size_t n;
+
+	mapped_file(const mapped_file&);
+	mapped_file& operator=(const mapped_file&);
+};
+
+}
+
+#endif
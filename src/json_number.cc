@@ -0,0 +1,46 @@
+#include <clocale>
+#include <cstdlib>
+#include <string>
+#include "json_number.hh"
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#endif
+#endif
+
+namespace json {
+
+bool
+parse_double(const char *p, size_t n, double& r) {
+	const char *end = p + n;
+	// the grammar allows a leading plus, neither from_chars nor strtod need it
+	if (p != end && '+' == *p)
+		++p;
+	if (p == end)
+		return false;
+#if defined(__cpp_lib_to_chars)
+	// from_chars is exact and does not depend on the locale. libstdc++ and libc++ implement it with the
+	// Eisel-Lemire algorithm.
+	std::from_chars_result res = std::from_chars(p, end, r);
+	if (std::errc() == res.ec)
+		return res.ptr == end;
+	if (std::errc::result_out_of_range != res.ec)
+		return false;
+	// out of range: let strtod produce the infinity or the zero
+#endif
+	// strtod reads the decimal point of the locale, which is not the one of JSON
+	std::string s;
+	s.reserve(end - p + 4);
+	const char *point = localeconv()->decimal_point;
+	for (; p != end; ++p)
+		if ('.' == *p)
+			s.append(point);
+		else
+			s.push_back(*p);
+	char *stop;
+	r = strtod(s.c_str(), &stop);
+	return stop == s.c_str() + s.size();
+}
+
+}
@@ -0,0 +1,141 @@
+#ifndef __JSON_NUMBER_HH__
+#define __JSON_NUMBER_HH__
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+
+namespace json {
+
+/**
+ * \brief Converts the text of an INTEGER token to an integer. The conversion is done in place, by one
+ * pass over the digits.
+ *
+ * \param p The first character of the token. It is a digit or a sign.
+ * \param n The number of characters of the token.
+ * \param r The result.
+ * \return false if the value does not fit in 64 bits. r is then unchanged.
+ */
+template<typename Char>
+bool
+parse_integer(const Char *p, size_t n, int64_t& r) {
+	const Char *end = p + n;
+	bool negative = false;
+	if (p != end && (static_cast<Char>('-') == *p || static_cast<Char>('+') == *p))
+		negative = static_cast<Char>('-') == *p++;
+	if (p == end)
+		return false;
+	uint64_t v = 0;
+	for (; p != end; ++p) {
+		unsigned int d = static_cast<unsigned int>(*p - static_cast<Char>('0'));
+		if (d > 9)
+			return false;
+		if (v > (~static_cast<uint64_t>(0) - d) / 10)
+			return false;
+		v = v * 10 + d;
+	}
+	// the magnitude of the smallest int64_t
+	const uint64_t min = static_cast<uint64_t>(1) << 63;
+	if (negative) {
+		if (v > min)
+			return false;
+		// -v, computed without overflowing for v == min
+		r = 0 == v ? 0 : -static_cast<int64_t>(v - 1) - 1;
+	} else {
+		if (v >= min)
+			return false;
+		r = static_cast<int64_t>(v);
+	}
+	return true;
+}
+
+/**
+ * \brief Checks that the text of an INTEGER or DOUBLE token is a number of the JSON grammar. The scanner is more
+ * lenient: it accepts a leading plus, and a point without digits on one side, e.g. +1, .5 or 1.
+ *
+ * \param p The first character of the token.
+ * \param n The number of characters of the token.
+ * \return true if the text is a JSON number.
+ */
+template<typename Char>
+bool
+is_json_number(const Char *p, size_t n) {
+	const Char *end = p + n;
+	if (p != end && static_cast<Char>('-') == *p)
+		++p;
+	const Char *digits = p;
+	while (p != end && static_cast<Char>('0') <= *p && *p <= static_cast<Char>('9'))
+		++p;
+	// no leading zero
+	if (p == digits || (p - digits > 1 && static_cast<Char>('0') == *digits))
+		return false;
+	if (p != end && static_cast<Char>('.') == *p) {
+		digits = ++p;
+		while (p != end && static_cast<Char>('0') <= *p && *p <= static_cast<Char>('9'))
+			++p;
+		if (p == digits)
+			return false;
+	}
+	if (p != end && (static_cast<Char>('e') == *p || static_cast<Char>('E') == *p)) {
+		++p;
+		if (p != end && (static_cast<Char>('+') == *p || static_cast<Char>('-') == *p))
+			++p;
+		digits = p;
+		while (p != end && static_cast<Char>('0') <= *p && *p <= static_cast<Char>('9'))
+			++p;
+		if (p == digits)
+			return false;
+	}
+	return p == end;
+}
+
+/**
+ * \brief Converts the text of an INTEGER or DOUBLE token to a double, rounding correctly. The conversion
+ * does not depend on the locale: it is std::from_chars where the library has it, strtod otherwise, given
+ * the text with the decimal point of the locale.
+ *
+ * \param p The first character of the token.
+ * \param n The number of characters of the token.
+ * \param r The result.
+ * \return false if the text is not a number.
+ */
+bool parse_double(const char *, size_t, double&);
+
+//! \brief The conversion for characters other than char. \sa parse_double(const char *, size_t, double&)
+template<typename Char>
+bool
+parse_double(const Char *p, size_t n, double& r) {
+	std::string s;
+	s.reserve(n);
+	for (size_t i = 0; i < n; ++i) {
+		if (static_cast<unsigned long>(p[i]) >= 0x80)
+			return false;
+		s.push_back(static_cast<char>(p[i]));
+	}
+	return parse_double(s.data(), s.size(), r);
+}
+
+/**
+ * \brief Converts the text of an INTEGER or DOUBLE token to one value: the integer of an INTEGER that fits in
+ * 64 bits, a double otherwise, e.g. for the handlers that record numbers by value.
+ *
+ * \param p The first character of the token.
+ * \param n The number of characters of the token.
+ * \param integral true for an INTEGER token.
+ * \param i Set to the integer, if the result is true.
+ * \param d Set to the double, if the result is false.
+ * \return true if the value is the integer i, false if it is the double d.
+ */
+template<typename Char>
+bool
+parse_number(const Char *p, size_t n, bool integral, int64_t& i, double& d) {
+	if (integral && parse_integer(p, n, i))
+		return true;
+	d = 0;
+	parse_double(p, n, d);
+	return false;
+}
+
+}
+
+#endif
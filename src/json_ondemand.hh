@@ -0,0 +1,373 @@
+#ifndef __JSON_ONDEMAND_HH__
+#define __JSON_ONDEMAND_HH__
+
+#include <string>
+#include <stdexcept>
+#include <stdint.h>
+#include "json_scanner.hh"
+#include "json_index.hh"
+#include "json_number.hh"
+#include "json_resource.hh"
+
+namespace json {
+
+template<typename Char> class element;
+
+/**
+ * \brief A document held in one buffer and read on demand: only the \link json::structural_index structural
+ * index\endlink of the buffer is built up front. The values are reached through json::element cursors, which
+ * jump over the siblings they pass by counting brackets in the index, and a value is scanned and converted only
+ * when it is read. Hence reading a few fields of a large document costs little more than building the index,
+ * and no value that is not read is ever decoded or copied.
+ *
+ * The values that are read are scanned by the DFA of json::scanner and converted like the parser does, so they
+ * read the same as through json::parser. The structure of the document, however, is not checked beyond what
+ * the cursors walk through: an error in a part that is not visited goes unnoticed.
+ *
+ * \code
+ * json::document<char> doc;
+ * if (doc.load(buf, len))
+ * 	id = doc["user"]["id"].get_int64();
+ * \endcode
+ *
+ * A document and its elements must not be used by several threads at once: they share the scanner of the
+ * document. The buffer must outlive the document.
+ */
+template<typename Char>
+class document {
+public:
+	/**
+	 * \brief The constructor of an empty document.
+	 *
+	 * \param r The resource the index is allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit document(json::memory_resource *r = 0) : p(0), n(0), index(r) {}
+	/**
+	 * \brief Makes the document the n characters starting at p, and builds their index. The capacity of the index
+	 * is kept from one document to the next.
+	 *
+	 * \param buf The first character.
+	 * \param len The number of characters.
+	 * \return false if the buffer ends inside a string or holds no token.
+	 */
+	bool load(const Char *buf, size_t len) {
+		p = buf;
+		n = len;
+		return index.build(buf, len) && index.size() > 0;
+	}
+	//! \brief The cursor of the root value.
+	inline json::element<Char> root() const;
+	//! \brief The value of a member of the root object. \sa element::operator[]
+	inline json::element<Char> operator[](const Char *) const;
+	//! \brief The value of a member of the root object. \sa element::operator[]
+	inline json::element<Char> operator[](const std::basic_string<Char>&) const;
+	//! \brief The structural index of the buffer.
+	const json::structural_index<Char>& structure() const { return index; }
+private:
+	friend class json::element<Char>;
+
+	//! \brief The first character of the buffer.
+	const Char *p;
+	//! \brief The number of characters of the buffer.
+	size_t n;
+	//! \brief The index of the buffer.
+	json::structural_index<Char> index;
+	//! \brief Scans the values that are read.
+	mutable json::scanner<Char> scanner;
+	//! \brief The buffer escaped keys are decoded in when they are compared.
+	mutable std::basic_string<Char> scratch;
+};
+
+/**
+ * \brief A cursor on a value of a json::document, i.e. on the entry of the structural index where the value
+ * starts. A cursor is two words and is passed by value. A cursor on a value that does not exist, e.g. the value
+ * of a missing key, is not \link json::element::exists exists\endlink; the lookups on it yield more such cursors,
+ * so that a chain of lookups is checked once, at its end. The getters throw std::runtime_error if the value does
+ * not exist or if it is not of the right kind.
+ *
+ * \code
+ * // the members of an object: the keys and the values alternate
+ * for (json::element<char> k = obj.first(); k.exists(); k = k.next().next())
+ * 	use(k.get_string_ref(), k.next());
+ * \endcode
+ */
+template<typename Char>
+class element {
+public:
+	//! \brief The index entry of a value that does not exist.
+	static const size_t NONE = static_cast<size_t>(-1);
+
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param doc The document.
+	 * \param entry The index entry where the value starts, NONE for a value that does not exist.
+	 */
+	element(const json::document<Char>& doc, size_t entry) : d(&doc), i(entry) {}
+	//! \brief true if the value exists.
+	bool exists() const { return NONE != i; }
+	/**
+	 * \brief The kind of the value: L_BRACE for an object, L_BRACKET for an array, or the token of a primitive
+	 * (STRING, INTEGER, DOUBLE, TRUE_CONST, FALSE_CONST, NULL_CONST). ERROR if the value does not exist or is not
+	 * a valid token.
+	 */
+	inline typename json::scanner<Char>::token_t type() const;
+	//! \brief true if the value is an object.
+	bool is_object() const { return exists() && static_cast<Char>('{') == first_char(); }
+	//! \brief true if the value is an array.
+	bool is_array() const { return exists() && static_cast<Char>('[') == first_char(); }
+	//! \brief true if the value is null.
+	bool is_null() const { return json::scanner<Char>::NULL_CONST == type(); }
+	/**
+	 * \brief Looks a key up in an object. The members are visited in turn, their values are jumped over through
+	 * the index, and only the keys of the right length are compared.
+	 *
+	 * \param k The first character of the key.
+	 * \param len The number of characters of the key, decoded.
+	 * \return The value of the first member with the key, a value that does not exist if there is none or if
+	 * this value is not an object.
+	 */
+	inline element find(const Char *, size_t) const;
+	//! \brief Looks a null-terminated key up in an object. \sa find
+	element operator[](const Char *k) const { return find(k, std::char_traits<Char>::length(k)); }
+	//! \brief Looks a key up in an object. \sa find
+	element operator[](const std::basic_string<Char>& k) const { return find(k.data(), k.size()); }
+	//! \brief The k-th element of an array, a value that does not exist if there is none.
+	inline element at(size_t) const;
+	//! \brief The number of elements of an array or of members of an object, 0 for the other values.
+	inline size_t size() const;
+	//! \brief The first element of an array, or the first key of an object. It does not exist if the container is empty.
+	inline element first() const;
+	/**
+	 * \brief The value that follows this one in its container: the next element of an array, the value of a key,
+	 * or the key of the next member of an object. It does not exist after the last one.
+	 */
+	inline element next() const;
+	//! \brief The value of an INTEGER. \exception std::runtime_error if it is not one or does not fit in 64 bits.
+	inline int64_t get_int64() const;
+	//! \brief The value of an INTEGER or a DOUBLE. \exception std::runtime_error if it is not one.
+	inline double get_double() const;
+	//! \brief The value of true or false. \exception std::runtime_error if it is not one of them.
+	inline bool get_bool() const;
+	/**
+	 * \brief The raw body of a STRING, a view into the buffer of the document. Nothing is copied.
+	 * \exception std::runtime_error if it is not a string.
+	 */
+	inline json::string_ref<Char> get_string_ref() const;
+	//! \brief The decoded text of a STRING. \exception std::runtime_error if it is not a string.
+	std::basic_string<Char> get_string() const { return get_string_ref().str(); }
+	//! \brief The index entry where the value starts.
+	size_t entry() const { return i; }
+private:
+	//! \brief The first character of the value.
+	Char first_char() const { return d->p[d->index[i]]; }
+	//! \brief The character at an index entry.
+	Char at_entry(size_t e) const { return d->p[d->index[e]]; }
+	//! \brief Scans the primitive value with the DFA. Its text is then the text of the scanner of the document.
+	inline typename json::scanner<Char>::token_t scan() const;
+	//! \brief The entry that follows the value that starts at entry e, NONE if the index ends before.
+	inline size_t skip(size_t) const;
+	//! \brief Throws std::runtime_error unless ok. what names the kind of value that was expected.
+	inline void expect(bool, const char *) const;
+
+	//! \brief The document.
+	const json::document<Char> *d;
+	//! \brief The index entry where the value starts.
+	size_t i;
+};
+
+template<typename Char>
+const size_t element<Char>::NONE;
+
+template<typename Char>
+inline json::element<Char>
+document<Char>::root() const {
+	return json::element<Char>(*this, index.size() > 0 ? 0 : json::element<Char>::NONE);
+}
+
+template<typename Char>
+inline json::element<Char>
+document<Char>::operator[](const Char *k) const {
+	return root()[k];
+}
+
+template<typename Char>
+inline json::element<Char>
+document<Char>::operator[](const std::basic_string<Char>& k) const {
+	return root()[k];
+}
+
+template<typename Char>
+inline typename json::scanner<Char>::token_t
+element<Char>::scan() const {
+	const json::structural_index<Char>& idx = d->index;
+	const Char *end = d->p + d->n;
+	size_t e = i;
+	// a string ends at its closing quote, the next entry
+	if (static_cast<Char>('"') == first_char())
+		++e;
+	if (e >= idx.size())
+		return json::scanner<Char>::ERROR;
+	const Char *limit = e + 1 < idx.size() ? d->p + idx[e + 1] : end;
+	return d->scanner.scan(d->p + idx[i], limit, limit == end ? end : limit + 1);
+}
+
+template<typename Char>
+inline typename json::scanner<Char>::token_t
+element<Char>::type() const {
+	if (!exists())
+		return json::scanner<Char>::ERROR;
+	switch (first_char()) {
+	case static_cast<Char>('{'):
+		return json::scanner<Char>::L_BRACE;
+	case static_cast<Char>('['):
+		return json::scanner<Char>::L_BRACKET;
+	case static_cast<Char>('}'):
+	case static_cast<Char>(']'):
+	case static_cast<Char>(','):
+	case static_cast<Char>(':'):
+		return json::scanner<Char>::ERROR;
+	default:
+		return scan();
+	}
+}
+
+template<typename Char>
+inline size_t
+element<Char>::skip(size_t e) const {
+	const json::structural_index<Char>& idx = d->index;
+	Char c = at_entry(e);
+	if (static_cast<Char>('"') == c)
+		return e + 2 <= idx.size() ? e + 2 : NONE;
+	if (static_cast<Char>('{') != c && static_cast<Char>('[') != c)
+		return e + 1;
+	// find the closing bracket. Strings are pairs of entries.
+	unsigned long depth = 1;
+	for (++e; e < idx.size(); ++e) {
+		c = at_entry(e);
+		if (static_cast<Char>('"') == c)
+			++e;
+		else if (static_cast<Char>('{') == c || static_cast<Char>('[') == c)
+			++depth;
+		else if ((static_cast<Char>('}') == c || static_cast<Char>(']') == c) && 0 == --depth)
+			return e + 1;
+	}
+	return NONE;
+}
+
+template<typename Char>
+inline json::element<Char>
+element<Char>::first() const {
+	if (!is_object() && !is_array())
+		return element(*d, NONE);
+	if (i + 1 >= d->index.size())
+		return element(*d, NONE);
+	Char c = at_entry(i + 1);
+	if (static_cast<Char>('}') == c || static_cast<Char>(']') == c)
+		return element(*d, NONE);
+	return element(*d, i + 1);
+}
+
+template<typename Char>
+inline json::element<Char>
+element<Char>::next() const {
+	if (!exists())
+		return *this;
+	size_t e = skip(i);
+	if (NONE == e || e + 1 >= d->index.size())
+		return element(*d, NONE);
+	Char c = at_entry(e);
+	if (static_cast<Char>(',') != c && static_cast<Char>(':') != c)
+		return element(*d, NONE);
+	return element(*d, e + 1);
+}
+
+template<typename Char>
+inline json::element<Char>
+element<Char>::find(const Char *k, size_t len) const {
+	if (!is_object())
+		return element(*d, NONE);
+	for (element key = first(); key.exists(); key = key.next().next()) {
+		if (json::scanner<Char>::STRING != key.scan())
+			return element(*d, NONE);
+		const json::string_ref<Char>& raw = d->scanner.text();
+		if (!raw.escaped()) {
+			if (raw.size() == len && 0 == std::char_traits<Char>::compare(raw.data(), k, len))
+				return key.next();
+		} else if (raw.size() >= len) {
+			// an escape sequence is at least as long as what it stands for
+			raw.decode(d->scratch);
+			if (d->scratch.size() == len && 0 == std::char_traits<Char>::compare(d->scratch.data(), k, len))
+				return key.next();
+		}
+	}
+	return element(*d, NONE);
+}
+
+template<typename Char>
+inline json::element<Char>
+element<Char>::at(size_t k) const {
+	if (!is_array())
+		return element(*d, NONE);
+	element e = first();
+	for (; e.exists() && k > 0; --k)
+		e = e.next();
+	return e;
+}
+
+template<typename Char>
+inline size_t
+element<Char>::size() const {
+	size_t r = 0;
+	for (element e = first(); e.exists(); e = e.next())
+		++r;
+	return is_object() ? r / 2 : r;
+}
+
+template<typename Char>
+inline void
+element<Char>::expect(bool ok, const char *what) const {
+	if (!ok)
+		throw std::runtime_error(exists() ? std::string("The value is not ") + what : std::string("The value does not exist."));
+}
+
+template<typename Char>
+inline int64_t
+element<Char>::get_int64() const {
+	typename json::scanner<Char>::token_t t = type();
+	expect(json::scanner<Char>::INTEGER == t, "an integer.");
+	int64_t r = 0;
+	const json::string_ref<Char>& text = d->scanner.text();
+	expect(json::parse_integer(text.data(), text.size(), r), "a 64-bit integer.");
+	return r;
+}
+
+template<typename Char>
+inline double
+element<Char>::get_double() const {
+	typename json::scanner<Char>::token_t t = type();
+	expect(json::scanner<Char>::INTEGER == t || json::scanner<Char>::DOUBLE == t, "a number.");
+	double r = 0;
+	const json::string_ref<Char>& text = d->scanner.text();
+	expect(json::parse_double(text.data(), text.size(), r), "a number.");
+	return r;
+}
+
+template<typename Char>
+inline bool
+element<Char>::get_bool() const {
+	typename json::scanner<Char>::token_t t = type();
+	expect(json::scanner<Char>::TRUE_CONST == t || json::scanner<Char>::FALSE_CONST == t, "a boolean.");
+	return json::scanner<Char>::TRUE_CONST == t;
+}
+
+template<typename Char>
+inline json::string_ref<Char>
+element<Char>::get_string_ref() const {
+	expect(json::scanner<Char>::STRING == type(), "a string.");
+	return d->scanner.text();
+}
+
+}
+
+#endif
@@ -0,0 +1,370 @@
+#ifndef __JSON_PARALLEL_HH__
+#define __JSON_PARALLEL_HH__
+
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+#include <pthread.h>
+#include <unistd.h>
+#include "json_parser.hh"
+
+namespace json {
+
+/**
+ * \brief A driver that parses newline-delimited JSON in parallel. The input is split at newlines into blocks of
+ * about \link json::parallel_parser::parallel_parser block_size\endlink characters. A pool of threads takes the blocks
+ * in turn and parses each one in \link json::parser::set_multi_document multi-document mode\endlink. The results
+ * are delivered to a callback, in the thread that called \link json::parallel_parser::parse parse\endlink, in input
+ * order.
+ *
+ * Every block in flight has a slot that holds its parser, and hence its handler, which is a copy of the prototype
+ * given to the constructor. There are a bounded number of slots, so the blocks that are parsed but not yet
+ * delivered are bounded too: a thread waits before it takes a block whose slot is still in use. The callback gets
+ * the handler of the slot after the parse of the block. It has to consume what the handler collected and leave
+ * the handler ready for another block, since the slot is then reused. The parsers are reset between blocks
+ * but keep their buffers.
+ *
+ * If the callback throws, no more blocks are taken, the threads are joined, the handlers of the slots are
+ * replaced by copies of the prototype, and the exception is passed on to the caller. If some threads cannot be
+ * created, the blocks that the others took are delivered and the result is ERROR.
+ *
+ * The documents must not contain raw newlines, which holds for NDJSON since JSON strings may not contain
+ * control characters.
+ *
+ * A single document that is a large array may be parsed in parallel as well, by
+ * \link json::parallel_parser::parse_array parse_array\endlink. It is split between elements into ranges of
+ * about block_size characters, and every handler sees its range as an array of its own. The driver does not
+ * splice the results of the ranges: what a handler collects depends on the handler, so the ranges are delivered
+ * to the callback in input order like the blocks, and the callback appends what the handler of each range
+ * collected to the result of the whole array, e.g. the records of an array of records.
+ *
+ * \code
+ * json::parallel_parser<my_handler> pp;
+ * pp.parse(buf, len, &consume, &ctx);
+ * \endcode
+ */
+template<typename Handler>
+class parallel_parser {
+public:
+	//! \brief The parser of one block.
+	typedef json::parser<char, Handler> parser_t;
+	/**
+	 * \brief Specifies the type of the callback that gets the blocks in input order. It gets the handler that parsed
+	 * the block, the result of the parse, the first character and the size of the block, and the context.
+	 */
+	typedef void (*hook_block_t)(Handler&, typename parser_t::result_t, const char *, size_t, void *);
+
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param threads The number of parsing threads, 0 for the number of online processors.
+	 * \param block_size The size of the blocks, before they are extended to the next newline.
+	 * \param slots The largest number of blocks in flight, 0 for twice the number of threads.
+	 * \param prototype The handler that every slot gets a copy of.
+	 */
+	explicit parallel_parser(unsigned int = 0, size_t = 1 << 20, size_t = 0, const Handler& = Handler());
+	//! \brief Releases the slots.
+	~parallel_parser();
+	/**
+	 * \brief Parses the n characters starting at p and passes the blocks to the callback.
+	 *
+	 * \param p The first character.
+	 * \param n The number of characters.
+	 * \param cb The callback.
+	 * \param ctx The context passed to the callback.
+	 * \return OK if every block was parsed successfully, ERROR otherwise.
+	 * \exception std::runtime_error if no thread can be created. Any exception of the callback.
+	 */
+	typename parser_t::result_t parse(const char *, size_t, hook_block_t, void *);
+	/**
+	 * \brief Parses the n characters starting at p, that hold one array, and passes ranges of its elements to
+	 * the callback. The structural index of the buffer is built first, in the calling thread, and the ranges
+	 * are split at the commas between the elements of the array. The handler of a range gets the events of an
+	 * array of the elements of the range, see json::parser::parse_elements. An empty array has no ranges.
+	 * The handlers are the copies of the prototype in the slots, as for \link json::parallel_parser::parse parse\endlink,
+	 * and the callback gets the ranges in input order, so it splices their results by appending each in turn.
+	 *
+	 * \param p The first character.
+	 * \param n The number of characters.
+	 * \param cb The callback. It gets the text of the range, from the first element up to the comma or the
+	 * bracket after the last one.
+	 * \param ctx The context passed to the callback.
+	 * \return OK if the buffer holds an array and every range was parsed successfully, ERROR otherwise.
+	 * \exception std::runtime_error if no thread can be created. Any exception of the callback.
+	 */
+	typename parser_t::result_t parse_array(const char *, size_t, hook_block_t, void *);
+	//! \brief The number of parsing threads.
+	unsigned int threads() const { return nthreads; }
+private:
+	//! \brief A block in flight.
+	struct slot_t {
+		//! \brief The parser of the block.
+		parser_t parser;
+		//! \brief The result of the parse.
+		typename parser_t::result_t result;
+		//! \brief true once the block is parsed.
+		bool done;
+		//! \brief The constructor.
+		explicit slot_t(const Handler& h) : parser(h), result(parser_t::ERROR), done(false) {
+			parser.set_multi_document(true);
+		}
+	};
+	//! \brief A block.
+	struct block_t {
+		//! \brief The first character.
+		const char *begin;
+		//! \brief The character after the last one.
+		const char *end;
+		//! \brief The index entries of the block in array mode. \sa json::parser::parse_elements
+		size_t first, last;
+	};
+	//! \brief Parses the blocks and delivers them.
+	typename parser_t::result_t run(hook_block_t, void *);
+	//! \brief The thread function.
+	static void *work(void *);
+	//! \brief Takes blocks and parses them until there is none left.
+	void work();
+
+	//! \brief The number of parsing threads.
+	unsigned int nthreads;
+	//! \brief The size of the blocks.
+	size_t block_size;
+	//! \brief The handler that the slots are copies of.
+	Handler prototype;
+	//! \brief The slots. Block i is parsed in slot i modulo their number.
+	std::vector<slot_t *> slots;
+	//! \brief The blocks.
+	std::vector<block_t> blocks;
+	//! \brief true if the blocks are ranges of the elements of an array.
+	bool array;
+	//! \brief The input in array mode.
+	const char *input;
+	//! \brief The size of the input in array mode.
+	size_t input_size;
+	//! \brief The structural index of the input in array mode.
+	json::structural_index<char> index;
+	//! \brief The next block to take.
+	size_t next;
+	//! \brief The number of blocks that are taken at most, less than their number if the run was cut short.
+	size_t limit;
+	//! \brief true if the delivery stopped, e.g. because the callback threw. The threads then take no more blocks.
+	bool stopped;
+	//! \brief The number of blocks delivered so far.
+	size_t delivered;
+	//! \brief Protects next, delivered and the state of the slots.
+	pthread_mutex_t lock;
+	//! \brief Signalled when a block is parsed.
+	pthread_cond_t parsed;
+	//! \brief Signalled when a slot is released.
+	pthread_cond_t released;
+
+	parallel_parser(const parallel_parser&);
+	parallel_parser& operator=(const parallel_parser&);
+};
+
+template<typename Handler>
+parallel_parser<Handler>::parallel_parser(unsigned int t, size_t bs, size_t s, const Handler& h) :
+	nthreads(t), block_size(0 == bs ? 1 : bs), prototype(h), array(false), input(0), input_size(0), next(0), limit(0), stopped(false),
+	delivered(0)
+{
+	if (0 == nthreads) {
+		long online = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = online > 0 ? static_cast<unsigned int>(online) : 1;
+	}
+	if (0 == s)
+		s = 2 * nthreads;
+	for (size_t i = 0; i < s; ++i)
+		slots.push_back(new slot_t(prototype));
+	pthread_mutex_init(&lock, 0);
+	pthread_cond_init(&parsed, 0);
+	pthread_cond_init(&released, 0);
+}
+
+template<typename Handler>
+parallel_parser<Handler>::~parallel_parser() {
+	for (size_t i = 0; i < slots.size(); ++i)
+		delete slots[i];
+	pthread_cond_destroy(&released);
+	pthread_cond_destroy(&parsed);
+	pthread_mutex_destroy(&lock);
+}
+
+template<typename Handler>
+void *
+parallel_parser<Handler>::work(void *self) {
+	reinterpret_cast<parallel_parser *>(self)->work();
+	return 0;
+}
+
+template<typename Handler>
+void
+parallel_parser<Handler>::work() {
+	pthread_mutex_lock(&lock);
+	while (next < limit) {
+		size_t b = next++;
+		// the slot is free once the block that used it before is delivered
+		while (b >= delivered + slots.size() && !stopped)
+			pthread_cond_wait(&released, &lock);
+		if (stopped)
+			break;
+		pthread_mutex_unlock(&lock);
+
+		slot_t& s = *slots[b % slots.size()];
+		typename parser_t::result_t r;
+		try {
+			s.parser.reset();
+			const block_t& blk = blocks[b];
+			if (array)
+				r = s.parser.parse_elements(input, input_size, index, blk.first, blk.last);
+			else
+				r = s.parser.parse(blk.begin, blk.end - blk.begin);
+		} catch (const std::exception&) {
+			r = parser_t::ERROR;
+		}
+
+		pthread_mutex_lock(&lock);
+		s.result = r;
+		s.done = true;
+		pthread_cond_broadcast(&parsed);
+	}
+	pthread_mutex_unlock(&lock);
+}
+
+template<typename Handler>
+typename parallel_parser<Handler>::parser_t::result_t
+parallel_parser<Handler>::parse(const char *p, size_t n, hook_block_t cb, void *ctx) {
+	// split the input at the first newline after every block_size characters
+	const char *end = p + n;
+	array = false;
+	blocks.clear();
+	for (const char *b = p; b != end; ) {
+		block_t blk = {b, end, 0, 0};
+		if (static_cast<size_t>(end - b) > block_size) {
+			const char *nl = static_cast<const char *>(memchr(b + block_size, '\n', end - b - block_size));
+			if (0 != nl)
+				blk.end = nl + 1;
+		}
+		blocks.push_back(blk);
+		b = blk.end;
+	}
+	return run(cb, ctx);
+}
+
+template<typename Handler>
+typename parallel_parser<Handler>::parser_t::result_t
+parallel_parser<Handler>::parse_array(const char *p, size_t n, hook_block_t cb, void *ctx) {
+	array = true;
+	input = p;
+	input_size = n;
+	blocks.clear();
+	if (!index.build(p, n) || index.size() < 2 || '[' != p[index[0]] || ']' != p[index[index.size() - 1]])
+		return parser_t::ERROR;
+	// split at the commas of the array, the first ones after every block_size characters
+	const size_t last = index.size() - 1;
+	unsigned long depth = 0;
+	block_t blk = {p + index[1], 0, 1, 0};
+	for (size_t i = 1; i < last; ++i) {
+		char c = p[index[i]];
+		if ('"' == c)
+			++i;
+		else if ('{' == c || '[' == c)
+			++depth;
+		else if ('}' == c || ']' == c) {
+			if (0 == depth--)
+				return parser_t::ERROR;
+		} else if (',' == c && 0 == depth && static_cast<size_t>(p + index[i] - blk.begin) >= block_size) {
+			blk.end = p + index[i];
+			blk.last = i;
+			blocks.push_back(blk);
+			blk.first = i + 1;
+			blk.begin = p + index[blk.first];
+		}
+	}
+	if (0 != depth)
+		return parser_t::ERROR;
+	if (blk.first < last) {
+		blk.end = p + index[last];
+		blk.last = last;
+		blocks.push_back(blk);
+	} else if (!blocks.empty())
+		// a trailing comma
+		return parser_t::ERROR;
+	return run(cb, ctx);
+}
+
+template<typename Handler>
+typename parallel_parser<Handler>::parser_t::result_t
+parallel_parser<Handler>::run(hook_block_t cb, void *ctx) {
+	const size_t count = blocks.size();
+	// a run that the callback cut short may have left parsed blocks behind
+	for (size_t i = 0; i < slots.size(); ++i)
+		slots[i]->done = false;
+	next = 0;
+	limit = count;
+	stopped = false;
+	delivered = 0;
+
+	std::vector<pthread_t> pool;
+	unsigned int t = count < nthreads ? static_cast<unsigned int>(count) : nthreads;
+	for (unsigned int i = 0; i < t; ++i) {
+		pthread_t th;
+		if (0 != pthread_create(&th, 0, &work, this)) {
+			// no more blocks for anybody, deliver what is taken
+			pthread_mutex_lock(&lock);
+			limit = next;
+			pthread_mutex_unlock(&lock);
+			if (pool.empty())
+				throw std::runtime_error("pthread_create");
+			break;
+		}
+		pool.push_back(th);
+	}
+
+	typename parser_t::result_t res = parser_t::OK;
+	for (size_t b = 0; b < count; ++b) {
+		slot_t& s = *slots[b % slots.size()];
+		pthread_mutex_lock(&lock);
+		if (b >= limit) {
+			// the block is never taken, see above
+			pthread_mutex_unlock(&lock);
+			res = parser_t::ERROR;
+			break;
+		}
+		while (!s.done)
+			pthread_cond_wait(&parsed, &lock);
+		pthread_mutex_unlock(&lock);
+
+		if (parser_t::OK != s.result)
+			res = parser_t::ERROR;
+		try {
+			if (0 != cb)
+				(*cb)(s.parser.handler(), s.result, blocks[b].begin, blocks[b].end - blocks[b].begin, ctx);
+		} catch (...) {
+			// stop the threads, including those that wait for a slot, before the exception leaves
+			pthread_mutex_lock(&lock);
+			stopped = true;
+			limit = next;
+			pthread_cond_broadcast(&released);
+			pthread_mutex_unlock(&lock);
+			for (size_t i = 0; i < pool.size(); ++i)
+				pthread_join(pool[i], 0);
+			// the handlers of the blocks that were parsed but not delivered are not consumed
+			for (size_t i = 0; i < slots.size(); ++i)
+				slots[i]->parser.handler() = prototype;
+			throw;
+		}
+
+		pthread_mutex_lock(&lock);
+		s.done = false;
+		++delivered;
+		pthread_cond_broadcast(&released);
+		pthread_mutex_unlock(&lock);
+	}
+	for (size_t i = 0; i < pool.size(); ++i)
+		pthread_join(pool[i], 0);
+	return res;
+}
+
+}
+
+#endif
@@ -1,22 +1,60 @@
 #ifndef __JSON_PARSER_HH__
 #define __JSON_PARSER_HH__
 
-#include <stack>
 #include <stdexcept>
 #include <string>
+#include <cstring>
 #include <istream>
 #include "json_scanner.hh"
+#include "json_index.hh"
+#include "json_handler.hh"
+#include "json_mmap.hh"
 
 namespace json {
 
 /**
- * \brief The json parser. Its public method is \link json::parser::parse parse\endlink.
+ * \brief The limits of a parser, for input from untrusted sources. A document that exceeds one is rejected as soon
+ * as the limit is crossed, with an \link json::parser::error error code\endlink that names it. 0 stands for no
+ * limit, which is the default for all of them. \sa json::parser::set_limits
+ */
+struct limits {
+	//! \brief The largest number of nested objects and arrays.
+	size_t max_depth;
+	//! \brief The largest number of characters of a token, e.g. of a string, quotes included, or of a number.
+	size_t max_token;
+	/**
+	 * \brief The largest number of characters of a document. In multi-document mode,
+	 * \link json::parser::feed feed\endlink applies it to every document, the blanks before it included, and
+	 * \link json::parser::parse(const Char *, size_t) parse\endlink to the whole buffer.
+	 */
+	size_t max_document;
+	//! \brief The constructor. No limit is set.
+	limits() : max_depth(0), max_token(0), max_document(0) {}
+};
+
+/**
+ * \brief The json parser. Its public methods are \link json::parser::feed feed\endlink and \link json::parser::parse parse\endlink.
  * It is an incremental parser adapted for streams, i.e. data may be incomplete
- * at the moment when parse is called. If new data arrives, \link json::parser::parse parse\endlink may be invoked again.
+ * at the moment when feed or parse is called. If new data arrives, \link json::parser::feed feed\endlink (or
+ * \link json::parser::parse parse\endlink) may be invoked again.
+ * \link json::parser::feed feed\endlink scans the chunk in place. \link json::parser::parse parse\endlink is an adapter
+ * that drains the input stream passed to the constructor and feeds what it got.
+ * 
+ * The parser reports what it encounters to its handler, which is its base class. The events are resolved at compile time,
+ * so they may be inlined, and the events that a handler derived from json::handler does not define compile to
+ * nothing. The default handler, json::hooks, forwards the events to callbacks that are set at run time. Hence
+ * parser<Char> offers the hook_* methods of json::hooks.
+ * 
+ * After the start event of an object or an array, the parser asks its handler whether to skip the container. If so,
+ * the content of the container is jumped over without being broken into tokens, and the end event of the
+ * container follows at once. \sa json::handler::skip
+ * 
+ * By default the input is one document. In \link json::parser::set_multi_document multi-document mode\endlink the
+ * input is a sequence of documents, e.g. newline-delimited JSON or concatenated JSON, that one parser handles in turn.
  * Check the unit tests for usage examples. 
  */
-template<typename Char>
-class parser {
+template<typename Char, typename Handler = json::hooks<Char> >
+class parser : public Handler {
 public:
 	/**
 	 * \brief The results of \link json::parser::parse parse\endlink. PENDING indicates that parsing has not completed
@@ -24,6 +62,16 @@ public:
 	 * is expected before the parser can decide if the input is legit.
 	 */ 
 	typedef enum {ERROR, PENDING, OK} result_t;
+	/**
+	 * \brief The reasons why the parser returned ERROR. SYNTAX is any input that is not JSON, ENCODING a string
+	 * that is not well-formed UTF-8 (see \link json::parser::set_validate_encoding set_validate_encoding\endlink)
+	 * or a file that does not hold a whole number of characters, the other ones are the \link json::limits limits\endlink that the input exceeds.
+	 */
+	typedef enum {NONE, SYNTAX, DEPTH_LIMIT, TOKEN_LIMIT, DOCUMENT_LIMIT, ENCODING} error_t;
+	/**
+	 * \brief The constructor of a parser that is given its input exclusively through \link json::parser::feed feed\endlink.
+	 */
+	parser();
 	/**
 	 * \brief The constructor. It gets a _reference_ to an input stream. The input stream
 	 * must be valid during the whole parsing process, i.e. it should not be destroyed
@@ -33,48 +81,196 @@ public:
 	 */
 	parser(std::basic_istream<Char>&);
 	/**
-	 * \brief The parse method. It invokes the scanner that gets characters from the stream
-	 * until either a scan or a parse error occurs or the end-of-stream is reached.
+	 * \brief The constructor of a parser that is given its input through \link json::parser::feed feed\endlink and whose
+	 * buffers are allocated from a resource of the caller. \sa json::memory_resource
+	 * 
+	 * \param r The resource.
+	 */
+	explicit parser(json::memory_resource *);
+	/**
+	 * \brief The constructor of a parser that is given its input through \link json::parser::feed feed\endlink and whose
+	 * handler is a copy of h.
+	 * 
+	 * \param h The handler.
+	 * \param r The resource the buffers of the parser are allocated from, 0 for json::new_delete_resource. The
+	 * handler allocates as it pleases, e.g. json::tape_builder from the resource of its tape.
+	 */
+	explicit parser(const Handler&, json::memory_resource * = 0);
+	//! \brief The handler.
+	Handler& handler() { return *this; }
+	/**
+	 * \brief Sets the multi-document mode. In this mode, the input is a sequence of zero or more documents separated
+	 * by optional blanks. When a document is complete, the handler gets the document_end event and the parser
+	 * starts over in place with the next document, which may follow in the same chunk. Nothing is allocated per
+	 * document. \link json::parser::feed feed\endlink then returns PENDING until the end of the input, when
+	 * it returns OK if the input ends between documents.
+	 * 
+	 * \param m true for the multi-document mode.
+	 */
+	void set_multi_document(bool m) { multi = m; }
+	/**
+	 * \brief Makes the parser ready for a new input, as if it were just constructed, but keeps the capacity of its
+	 * buffers, its mode and its handler. The handler gets the \link json::handler::reset reset\endlink event, so
+	 * that it drops what it kept of an unfinished document.
+	 */
+	void reset() { clear_state(); Handler::reset(); }
+	/**
+	 * \brief Sets the limits on the documents. The buffers that the limits bound are allocated at once: the token
+	 * buffers of the scanner for json::limits::max_token characters, and the structural index of
+	 * parse(const Char *, size_t) for json::limits::max_document positions. Since the automaton stack has a fixed
+	 * size, a parser with a token limit then allocates nothing when it is fed, whatever the input. The depth limit
+	 * bounds as well the recursion of the consumers of the document, e.g. json::node::print.
+	 *
+	 * \param l The limits.
+	 */
+	inline void set_limits(const json::limits&);
+	//! \brief The limits. \sa set_limits
+	const json::limits& get_limits() const { return lim; }
+	/**
+	 * \brief Sets whether the strings and the keys are validated as they are scanned: as UTF-8 for char, as UTF-16
+	 * for 16-bit characters and as code points for wider ones. So the handlers get well-formed text only and need
+	 * not check it again. \sa json::scanner::set_validate
+	 *
+	 * \param v true for validation. It is off by default.
+	 */
+	void set_validate_encoding(bool v) { scanner.set_validate(v); }
+	//! \brief Why the last ERROR was returned, NONE if none was returned since construction or the last \link json::parser::reset reset\endlink.
+	error_t error() const { return failure; }
+	/**
+	 * \brief Parses the chunk of n characters starting at p. The characters are scanned in place,
+	 * the chunk is not copied except for a token that is incomplete at its end. Hence the chunk needs to stay
+	 * valid only during the call. An empty chunk signals that no more data will arrive.
 	 * 
+	 * \param p The first character of the chunk.
+	 * \param n The number of characters in the chunk.
 	 * \return ERROR, PENDING, or OK.
-	 * \exception std::runtime_error if an I/O error occurs when reading from the stream.
-	 * std::logic_error for certain software bugs. 
+	 * \exception std::logic_error for certain software bugs. 
 	 */
-	result_t parse();
-
+	result_t feed(const Char *, size_t);
+	/**
+	 * \brief Parses a chunk like feed(const Char *, size_t) and tells how much of it was consumed.
+	 * 
+	 * \param p The first character of the chunk.
+	 * \param n The number of characters in the chunk.
+	 * \param consumed Set to the number of characters of the chunk that the parser is done with: all of them if
+	 * the result is PENDING, including the start of a token that is completed by the next chunk, or the
+	 * characters up to where the error was detected if the result is ERROR.
+	 * \return ERROR, PENDING, or OK.
+	 * \exception std::logic_error for certain software bugs. 
+	 */
+	result_t feed(const Char *, size_t, size_t&);
+	/**
+	 * \brief Signals that no more data will arrive, in one call. It feeds empty chunks until the parser
+	 * decides, which may take more than one (see usage_example.cc).
+	 * 
+	 * \return ERROR or OK.
+	 * \exception std::logic_error for certain software bugs. 
+	 */
+	result_t finish();
+	/**
+	 * \brief The number of characters the parser holds between two chunks, i.e. the start of a token that the
+	 * next chunk completes. Besides them, the state kept between two chunks is the automaton stack, whose
+	 * size is fixed. So a caller that suspends a document between two chunks may bound the memory it takes.
+	 */
+	size_t buffered() const { return scanner.buffered(); }
+	/**
+	 * \brief Writes the state of the parser to a string of bytes, so that a document that was fed in part may be
+	 * resumed by another parser, e.g. in another thread or on another host, without the chunks being fed again. The
+	 * state is the automaton stack, the depth and the document size, the mode, and the state of the scanner
+	 * including the start of a token that the next chunk completes, hence the checkpoint takes a few bytes per
+	 * level of nesting besides that token. The settings of the parser (limits, encoding validation) and the
+	 * handler are not part of it: the handler has to be carried over by the caller, e.g. the tape that a
+	 * json::tape_builder is building. The checkpoint does not depend on the host, but Char has the same size.
+	 *
+	 * It is taken between two calls to \link json::parser::feed feed\endlink, i.e. not from within the handler.
+	 * \sa restore
+	 *
+	 * \return The checkpoint.
+	 */
+	std::string checkpoint() const;
+	/**
+	 * \brief Reads a \link json::parser::checkpoint checkpoint\endlink. The next chunk that is fed then
+	 * continues the document where the parser that took the checkpoint left it. The settings of this parser are
+	 * kept, and they are checked against the checkpoint, e.g. the depth limit against its nesting.
+	 *
+	 * \param p The first byte of the checkpoint.
+	 * \param n The number of bytes.
+	 * \return false if the bytes are not a valid checkpoint, in which case the state of the parser is reset. The
+	 * handler is left alone either way: it is the one that goes on with the document.
+	 */
+	bool restore(const char *, size_t);
+	//! \brief Reads a checkpoint. \sa restore(const char *, size_t)
+	bool restore(const std::string& s) { return restore(s.data(), s.size()); }
+	/**
+	 * \brief A snapshot of the counters of the parser and of its scanner since construction or the last
+	 * \link json::parser::clear_stats clear_stats\endlink, e.g. for export to a metrics system. They are kept
+	 * across documents and \link json::parser::reset reset\endlink. The counters are compiled in only if
+	 * JSON_STATS is defined, otherwise they cost nothing and the snapshot is all 0.
+	 */
+	inline json::stats stats() const;
+	//! \brief Sets the counters to 0. \sa stats
+	inline void clear_stats();
+	/**
+	 * \brief Parses a whole document held in one buffer. It first builds the \link json::structural_index structural index\endlink
+	 * of the buffer and then runs the automaton on the tokens found at the indexed positions. Hence the
+	 * characters between tokens are never looked at by the scanner. The result is never PENDING, the end of
+	 * the buffer is the end of the input. The parser must not have been fed before.
+	 * 
+	 * \param p The first character of the document.
+	 * \param n The number of characters in the document.
+	 * \return ERROR or OK.
+	 * \exception std::logic_error for certain software bugs. 
+	 */
+	result_t parse(const Char *, size_t);
 	/**
-	 * \brief Specifies the type of the callback that is invoked when a key in a
-	 * key:value pair is encountered.
+	 * \brief Parses a whole document held in one buffer using an index that was built beforehand.
+	 * \sa parse(const Char *, size_t)
+	 * 
+	 * \param p The first character of the document.
+	 * \param n The number of characters in the document.
+	 * \param index The structural index of the n characters starting at p.
+	 * \return ERROR or OK.
+	 * \exception std::logic_error for certain software bugs. 
+	 */
+	result_t parse(const Char *, size_t, const json::structural_index<Char>&);
+	/**
+	 * \brief Parses some of the elements of an array, as if they were the elements of an array of their own.
+	 * The handler gets the events of that array: array_start, the elements, and array_end. Hence disjoint
+	 * ranges of the elements of one array may be parsed by several parsers at the same time, e.g. by
+	 * json::parallel_parser::parse_array. The parser must not have been fed before.
+	 *
+	 * \param p The first character of the buffer.
+	 * \param n The number of characters in the buffer.
+	 * \param index The structural index of the n characters starting at p.
+	 * \param first The index entry of the first character of the first element.
+	 * \param last The index entry of the comma or the bracket that follows the last element.
+	 * \return ERROR or OK.
+	 * \exception std::logic_error for certain software bugs.
 	 */
-	typedef void (*hook_key_t)(const std::basic_string<Char>&, void *);
+	result_t parse_elements(const Char *, size_t, const json::structural_index<Char>&, size_t, size_t);
 	/**
-	 * \brief Specifies the type of the callback that is invoked when primitive
-	 * data (strings, booleans, numbers, the null constant) are encountered as
-	 * values in key:value pairs or in array elements.
+	 * \brief Parses a whole document held in a file. The file is mapped into memory and parsed in place like a
+	 * buffer, see parse(const Char *, size_t), so no character is copied. The mapping is kept until the next call or
+	 * until the parser is destroyed, hence the views the handler got remain valid as long. The parser is
+	 * \link json::parser::reset reset\endlink first, so every call parses a new document.
+	 *
+	 * \param path The path of the file.
+	 * \return ERROR or OK. The \link json::parser::error error\endlink is ENCODING if the size of the file is
+	 * not a multiple of the size of Char.
+	 * \exception std::runtime_error if the file cannot be mapped.
+	 * std::logic_error for certain software bugs.
 	 */
-	typedef void (*hook_primitive_t)(const std::basic_string<Char>&, int, void *);
+	result_t parse_file(const char *);
 	/**
-	 * \brief Specifies the type of the callback that is invoked when objects or arrays start
-	 * or end.
+	 * \brief The parse method. It reads all characters that are available in the stream passed
+	 * to the constructor until the end-of-stream is reached and feeds them as one chunk.
+	 * 
+	 * \return ERROR, PENDING, or OK.
+	 * \exception std::runtime_error if an I/O error occurs when reading from the stream.
+	 * std::logic_error for certain software bugs or if the parser was constructed without a stream. 
 	 */
-	typedef void (*hook_start_end_t)(void *);
-	
-	//! \brief Sets the callback that is called when '{' is encountered.
-	inline void hook_obj_start(hook_start_end_t);
-	//! \brief Sets the callback that is called when the key of a key:value pair is encountered.
-	inline void hook_key(hook_key_t);
-	//! \brief Sets the callback that is called when a value of primitive type is encountered in a key:value pair
-	inline void hook_obj_data(hook_primitive_t);
-	//! \brief Sets the callback that is called when '}' is encountered.
-	inline void hook_obj_end(hook_start_end_t);
-	//! \brief Sets the callback that is called when '[' is encountered.
-	inline void hook_array_start(hook_start_end_t);
-	//! \brief Sets the callback that is called when an array element of primitive type is encountered.
-	inline void hook_array_data(hook_primitive_t);
-	//! \brief Sets the callback that is called when ']' is encountered.
-	inline void hook_array_end(hook_start_end_t);
-	//! \brief Sets a context that is passed to every callback.
-	inline void set_context(void *);
+	result_t parse();
+
 private:
 	//! \brief The current state in the parser automaton.
 	int crt;
@@ -82,25 +278,48 @@ private:
 	//! \brief The scanner.
 	json::scanner<Char> scanner;
 
-	//! \brief The stack that complements the parser automaton.
-	std::stack<int> st;
-
-	//! \brief The callback that is called when '{' is encountered.
-	hook_start_end_t obj_start_cb;
-	//! \brief The callback that is called when the key of a key:value pair is encountered.
-	hook_key_t  key_cb;
-	//! \brief The callback that is called when a value of primitive type is encountered in a key:value pair
-	hook_primitive_t obj_data_cb;
-	//! \brief The callback that is called when '}' is encountered.
-	hook_start_end_t obj_end_cb;
-	//! \brief The callback that is called when '[' is encountered.
-	hook_start_end_t array_start_cb;
-	//! \brief The callback that is called when an array element of primitive type is encountered.
-	hook_primitive_t array_data_cb;
-	//! \brief The callback that is called when ']' is encountered.
-	hook_start_end_t array_end_cb;
-	//! \brief The context that is passed to every callback.
-	void *ctx;
+	//! \brief The input stream drained by \link json::parser::parse parse\endlink. 0 if the parser is fed directly.
+	std::basic_istream<Char> *str;
+	//! \brief The buffer holding the chunk that \link json::parser::parse parse\endlink read from the stream.
+	typename json::scanner<Char>::buffer_t chunk;
+	//! \brief The structural index used by \link json::parser::parse(const Char *, size_t) parse\endlink.
+	json::structural_index<Char> index;
+	//! \brief The file mapped by \link json::parser::parse_file parse_file\endlink.
+	json::mapped_file file;
+#ifdef JSON_STATS
+	//! \brief The counters of the parser. Those of the scanner are kept by the scanner.
+	json::stats counters;
+#endif
+	//! \brief The limits. \sa set_limits
+	json::limits lim;
+	//! \brief The number of open objects and arrays.
+	size_t depth;
+	//! \brief The number of characters of the current document in the chunks before the current one.
+	size_t document_bytes;
+	//! \brief The first character of the current document in the current chunk, while a chunk is fed, 0 otherwise.
+	const Char *document_start;
+	//! \brief Why the last ERROR was returned. \sa error
+	error_t failure;
+	//! \brief true if the handler asked to skip the container that was just started.
+	bool skipping;
+	//! \brief true in multi-document mode.
+	bool multi;
+
+	/**
+	 * \brief The capacity of \link json::parser::st st\endlink. Every level of nesting takes up to three entries,
+	 * e.g. '{', the key and ':', or '[', an element and ',', hence any document that nests up to 340 levels is
+	 * accepted.
+	 */
+	static const unsigned int STACK_SIZE = 1024;
+	/**
+	 * \brief The stack that complements the parser automaton. It holds the states only, the symbols that led to
+	 * them are never looked at. Its depth grows with the nesting but not with the length of lists (see
+	 * \link json::parser::advance advance\endlink). It is part of the parser, so that no shift or reduce ever
+	 * allocates. Documents that nest deeper than the stack allows are rejected.
+	 */
+	unsigned char st[STACK_SIZE];
+	//! \brief The number of states on \link json::parser::st st\endlink.
+	unsigned int sp;
 
 	//! \brief The matrix elements type in the matrix representation of the automaton.
 	typedef struct {
@@ -111,31 +330,57 @@ private:
 		 * In the latter case, it indicates that the action to take is "reduce".
 		 * The positive integer indicates which non-terminal to reduce. 
 		 */
-		int what;
+		signed char what;
 		/**
 		 * \brief If \link json::parser::pt_cell_t::what what\endlink is ERROR, then \link json::parser::pt_cell_t::where where\endlink is unused.
 		 * If \link json::parser::pt_cell_t::what what\endlink is SHIFT, then \link json::parser::pt_cell_t::where where\endlink indicates the next state of the automaton.
 		 * If \link json::parser::pt_cell_t::what what\endlink is REDUCE, then \link json::parser::pt_cell_t::where where\endlink indicates how many states to reduce from the stack. 
 		 */
-		unsigned int where;
+		unsigned char where;
 	} pt_cell_t;
 
-	//! \brief The matrix representation of the parse automaton.
+	//! \brief The matrix representation of the parse automaton. Its 1368 bytes fit in a few cache lines.
 //	static const pt_cell_t pt[37][19];
 	static const pt_cell_t pt[38][18];
 
 	typedef enum { SHIFT = -2} command_t;
 
+	//! \brief The first bytes of a checkpoint, followed by its version. \sa checkpoint
+	static const char CHECKPOINT_MAGIC[4];
+	//! \brief The version of the checkpoint format.
+	static const unsigned int CHECKPOINT_VERSION = 1;
+
+	//! \brief Runs the automaton on the tokens of the chunk that has been fed to the scanner.
+	result_t run();
+	/**
+	 * \brief Runs the automaton on the tokens at the entries of an index, from first up to, but excluding, last.
+	 *
+	 * \return PENDING if all the tokens were shifted, OK if the input was accepted, ERROR otherwise.
+	 */
+	result_t run(const Char *, size_t, const json::structural_index<Char>&, size_t, size_t);
+	/**
+	 * \brief Runs the automaton on one token: performs the reductions it triggers and then shifts it.
+	 * 
+	 * \param term The token. Its text is the \link json::scanner::text text\endlink of the scanner.
+	 * \return PENDING if the token was shifted and the automaton waits for the next one, OK if the
+	 * input was accepted, ERROR if the token is not expected.
+	 * \exception std::logic_error for certain software bugs.
+	 */
+	result_t advance(int);
+	//! \brief Records why r is ERROR, if it is and if no reason was recorded yet. \return r
+	inline result_t fail(result_t);
+	//! \brief Resets the automaton, the counts and the scanner, but not the handler. \sa reset
+	void clear_state() { crt = 0; sp = 0; depth = 0; document_bytes = 0; failure = NONE; skipping = false; scanner.clear(); }
+
 	/**
 	 * \brief Called for semantic actions. It invokes the callbacks that are set.
 	 * 
 	 * \param state The current state in the parse automaton
-	 * \param token The currently scanned token.
 	 * \param term The currently scanned terminal. This is needed in the case of primitive data
 	 * in order to distinguish between, for example, the string token "1.2" and the number 1.2 or
 	 * between the string token "false" and the boolean constant 'false'.
 	 */	
-	void semantics(int, const std::basic_string<Char>&, int);
+	void semantics(int, int);
 };
 
 //template<typename Char>
@@ -178,8 +423,8 @@ private:
 //{{-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-2,36}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}},
 //{{-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {6,3}, {6,3}, {-1,0}, {-1,0}, {-1,0}, {-1,0}}};
 
-template<typename Char>
-const typename parser<Char>::pt_cell_t parser<Char>::pt[38][18] = {
+template<typename Char, typename Handler>
+const typename parser<Char, Handler>::pt_cell_t parser<Char, Handler>::pt[38][18] = {
 {{-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-2,1}, {-1,0}, {-2,19}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}},
 {{-1,0}, {-2,12}, {-2,14}, {-1,0}, {-2,15}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {1,0}, {-1,0}, {-1,0}, {-1,0}, {-2,2}, {-1,0}, {-1,0}, {-1,0}},
 {{-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-2,3}, {-1,0}, {-1,0}},
@@ -219,96 +464,488 @@ const typename parser<Char>::pt_cell_t parser<Char>::pt[38][18] = {
 {{-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {0,3}, {0,3}, {-1,0}, {-1,0}, {-1,0}, {-1,0}},
 {{-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {-1,0}, {0,3}}};
 
-template<typename Char>
-parser<Char>::parser(std::basic_istream<Char>& s) :
+template<typename Char, typename Handler>
+parser<Char, Handler>::parser() :
+	crt(0),
+	str(0),
+	depth(0),
+	document_bytes(0),
+	document_start(0),
+	failure(NONE),
+	skipping(false),
+	multi(false),
+	sp(0)
+{
+}
+
+template<typename Char, typename Handler>
+parser<Char, Handler>::parser(json::memory_resource *r) :
+	crt(0),
+	scanner(r),
+	str(0),
+	chunk(json::allocator<Char>(r)),
+	index(r),
+	depth(0),
+	document_bytes(0),
+	document_start(0),
+	failure(NONE),
+	skipping(false),
+	multi(false),
+	sp(0)
+{
+}
+
+template<typename Char, typename Handler>
+parser<Char, Handler>::parser(const Handler& h, json::memory_resource *r) :
+	Handler(h),
 	crt(0),
-	scanner(s),
-	obj_start_cb(0), key_cb(0), obj_data_cb(0), obj_end_cb(0),
-	array_start_cb(0), array_data_cb(0), array_end_cb(0),
-	ctx(0)
+	scanner(r),
+	str(0),
+	chunk(json::allocator<Char>(r)),
+	index(r),
+	depth(0),
+	document_bytes(0),
+	document_start(0),
+	failure(NONE),
+	skipping(false),
+	multi(false),
+	sp(0)
 {
-	s.unsetf(std::ios_base::skipws);
 }
 
-template<typename Char>
-typename parser<Char>::result_t
-parser<Char>::parse() {
-	int term;
-	std::basic_string<Char> token;
+template<typename Char, typename Handler>
+const char parser<Char, Handler>::CHECKPOINT_MAGIC[4] = {'J', 'S', 'C', 'P'};
 
-	term = scanner.get(token);
-	if (term == json::scanner<Char>::ERROR)
+template<typename Char, typename Handler>
+parser<Char, Handler>::parser(std::basic_istream<Char>& s) :
+	crt(0),
+	str(&s),
+	depth(0),
+	document_bytes(0),
+	document_start(0),
+	failure(NONE),
+	skipping(false),
+	multi(false),
+	sp(0)
+{
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::feed(const Char *p, size_t n) {
+	// the input ends inside a skipped container
+	if (skipping && 0 == n)
+		return fail(ERROR);
+	JSON_STATS_ADD(counters.bytes, n);
+	JSON_STATS_ADD(counters.chunks, 1);
+	if (0 != lim.max_document && document_bytes + n > lim.max_document && !multi) {
+		// rejected before it is scanned
+		failure = DOCUMENT_LIMIT;
 		return ERROR;
-	if (term == json::scanner<Char>::PENDING)
-		return PENDING;
+	}
+	document_start = p;
+	scanner.feed(p, n);
+	result_t r = run();
+	if (0 != n)
+		document_bytes += p + n - document_start;
+	document_start = 0;
+	if (PENDING == r && 0 != lim.max_document && document_bytes > lim.max_document) {
+		failure = DOCUMENT_LIMIT;
+		r = ERROR;
+	}
+	JSON_STATS_ADD(counters.resumptions, PENDING == r);
+	return fail(r);
+}
+
+template<typename Char, typename Handler>
+inline void
+parser<Char, Handler>::set_limits(const json::limits& l) {
+	lim = l;
+	scanner.set_max_token(l.max_token);
+	if (0 != l.max_document)
+		index.reserve(l.max_document + 1);
+}
+
+template<typename Char, typename Handler>
+inline typename parser<Char, Handler>::result_t
+parser<Char, Handler>::fail(result_t r) {
+	if (ERROR == r && NONE == failure)
+		failure = scanner.token_too_long() ? TOKEN_LIMIT : scanner.encoding_error() ? ENCODING : SYNTAX;
+	return r;
+}
 
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::feed(const Char *p, size_t n, size_t& consumed) {
+	result_t r = feed(p, n);
+	consumed = ERROR == r && 0 != n ? static_cast<size_t>(scanner.position() - p) : n;
+	return r;
+}
+
+template<typename Char, typename Handler>
+std::string
+parser<Char, Handler>::checkpoint() const {
+	std::string s(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	json::checkpoint_writer w(s);
+	w.put(CHECKPOINT_VERSION);
+	w.put(sizeof(Char));
+	w.put(multi);
+	w.put(failure);
+	w.put(skipping);
+	w.put(depth);
+	w.put(document_bytes);
+	w.put(crt);
+	w.put(sp);
+	for (unsigned int i = 0; i < sp; ++i)
+		w.put(st[i]);
+	scanner.checkpoint(w);
+	return s;
+}
+
+template<typename Char, typename Handler>
+bool
+parser<Char, Handler>::restore(const char *p, size_t n) {
+	clear_state();
+	if (n < sizeof(CHECKPOINT_MAGIC) || 0 != memcmp(p, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)))
+		return false;
+	json::checkpoint_reader r(p + sizeof(CHECKPOINT_MAGIC), n - sizeof(CHECKPOINT_MAGIC));
+	const uint64_t any = ~static_cast<uint64_t>(0), states = sizeof(pt) / sizeof(pt[0]) - 1;
+	uint64_t version, size, m, f, skip, d, bytes, state, height;
+	bool ok = r.get(version) && CHECKPOINT_VERSION == version && r.get(size) && sizeof(Char) == size
+		&& r.get(m, 1) && r.get(f, ENCODING) && r.get(skip, 1) && r.get(d, 0 == lim.max_depth ? any : lim.max_depth)
+		&& r.get(bytes, 0 == lim.max_document ? any : lim.max_document) && r.get(state, states)
+		&& r.get(height, STACK_SIZE);
+	for (unsigned int i = 0; ok && i < height; ++i) {
+		uint64_t s;
+		ok = r.get(s, states);
+		st[i] = static_cast<unsigned char>(s);
+	}
+	// the current state is the top of the stack, or the initial state if the stack is empty
+	ok = ok && (0 == height ? 0 == state : st[height - 1] == state);
+	if (!ok || !scanner.restore(r) || !r.at_end()) {
+		clear_state();
+		return false;
+	}
+	multi = 0 != m;
+	failure = static_cast<error_t>(f);
+	skipping = 0 != skip;
+	depth = static_cast<size_t>(d);
+	document_bytes = static_cast<size_t>(bytes);
+	crt = static_cast<int>(state);
+	sp = static_cast<unsigned int>(height);
+	return true;
+}
+
+template<typename Char, typename Handler>
+inline json::stats
+parser<Char, Handler>::stats() const {
+	json::stats s;
+#ifdef JSON_STATS
+	s = scanner.stats();
+	s.bytes = counters.bytes;
+	s.chunks = counters.chunks;
+	s.resumptions = counters.resumptions;
+	s.max_depth = counters.max_depth;
+#endif
+	return s;
+}
+
+template<typename Char, typename Handler>
+inline void
+parser<Char, Handler>::clear_stats() {
+#ifdef JSON_STATS
+	counters.clear();
+	scanner.clear_stats();
+#endif
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::finish() {
+	// every empty chunk returns at least one of the tokens that the end of the input completes
+	result_t r;
+	do
+		r = feed(0, 0);
+	while (PENDING == r);
+	return r;
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::parse() {
+	if (0 == str)
+		throw std::logic_error("No input stream.");
+	Char tmp[4096];
+	chunk.clear();
 	do {
-		switch (pt[crt][term].what) {
-		case -1:
+		str->read(tmp, sizeof(tmp) / sizeof(tmp[0]));
+		if (str->bad())
+			throw std::runtime_error("I/O");
+		chunk.append(tmp, str->gcount());
+		if (0 != lim.max_document && chunk.size() > lim.max_document) {
+			// stop reading
+			failure = DOCUMENT_LIMIT;
 			return ERROR;
-		case SHIFT:
-			st.push(term);
-			crt = pt[crt][term].where;
-			st.push(crt);
-			semantics(crt, token, term);
-			term = scanner.get(token);
-			if (term == json::scanner<Char>::ERROR)
+		}
+	} while (!str->eof());
+	return feed(chunk.data(), chunk.size());
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::parse(const Char *p, size_t n) {
+	JSON_STATS_ADD(counters.bytes, n);
+	if (0 != lim.max_document && n > lim.max_document) {
+		failure = DOCUMENT_LIMIT;
+		return ERROR;
+	}
+	if (!index.build(p, n))
+		return fail(ERROR);
+	return parse(p, n, index);
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::parse(const Char *p, size_t n, const json::structural_index<Char>& idx) {
+	result_t r = run(p, n, idx, 0, idx.size());
+	if (PENDING != r)
+		return fail(r);
+	return fail(OK == advance(json::scanner<Char>::EOS) ? OK : ERROR);
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::parse_file(const char *path) {
+	reset();
+	file.open(path);
+	if (0 != file.size() % sizeof(Char)) {
+		// not a whole number of characters
+		failure = ENCODING;
+		return ERROR;
+	}
+	return parse(reinterpret_cast<const Char *>(file.data()), file.size() / sizeof(Char));
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::parse_elements(const Char *p, size_t n, const json::structural_index<Char>& idx,
+		size_t first, size_t last) {
+	if (first >= last || last >= idx.size())
+		return fail(ERROR);
+	// the brackets of the array are made up, its elements are the tokens of the range
+	if (PENDING != advance(json::scanner<Char>::L_BRACKET))
+		return fail(ERROR);
+	if (skipping)
+		skipping = false;
+	else if (PENDING != run(p, n, idx, first, last))
+		return fail(ERROR);
+	if (PENDING != advance(json::scanner<Char>::R_BRACKET))
+		return fail(ERROR);
+	return fail(OK == advance(json::scanner<Char>::EOS) ? OK : ERROR);
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::run(const Char *p, size_t n, const json::structural_index<Char>& idx, size_t first,
+		size_t last) {
+	const Char *end = p + n;
+	const size_t *pos = idx.data();
+	size_t count = idx.size();
+
+	for (size_t i = first; i < last; ++i) {
+		const Char *q = p + pos[i];
+		int term;
+		switch (*q) {
+		case static_cast<Char>('{'):
+			term = json::scanner<Char>::L_BRACE;
+			break;
+		case static_cast<Char>('}'):
+			term = json::scanner<Char>::R_BRACE;
+			break;
+		case static_cast<Char>('['):
+			term = json::scanner<Char>::L_BRACKET;
+			break;
+		case static_cast<Char>(']'):
+			term = json::scanner<Char>::R_BRACKET;
+			break;
+		case static_cast<Char>(','):
+			term = json::scanner<Char>::COMMA;
+			break;
+		case static_cast<Char>(':'):
+			term = json::scanner<Char>::COLON;
+			break;
+		default: {
+			// a string (whose closing quote is the next entry) or a primitive. It has to be
+			// followed by blanks only up to the next entry.
+			if (static_cast<Char>('"') == *q)
+				++i;
+			const Char *limit = i + 1 < count ? p + pos[i + 1] : end;
+			term = scanner.scan(q, limit, limit == end ? end : limit + 1);
+			break;
+		}
+		}
+		if (json::scanner<Char>::ERROR == term)
+			return ERROR;
+		result_t r = advance(term);
+		if (PENDING != r)
+			return r;
+		if (skipping) {
+			// find the closing bracket in the index. Strings are pairs of entries.
+			unsigned long depth = 1;
+			for (++i; i < last; ++i) {
+				Char c = p[pos[i]];
+				if (static_cast<Char>('"') == c)
+					++i;
+				else if (static_cast<Char>('{') == c || static_cast<Char>('[') == c)
+					++depth;
+				else if ((static_cast<Char>('}') == c || static_cast<Char>(']') == c) && 0 == --depth)
+					break;
+			}
+			if (i == last)
 				return ERROR;
-			if (json::scanner<Char>::PENDING == term || json::scanner<Char>::EOS == term)
+			skipping = false;
+			// the closing bracket is next
+			--i;
+		}
+	}
+	return PENDING;
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::run() {
+	// EOS is the end of the input only if the chunk is empty, i.e. if it is returned first
+	bool first = true;
+	do {
+		if (skipping) {
+			if (!scanner.skip())
 				return PENDING;
-			break;
-		default: // reduce
-			int non_term = pt[crt][term].what;
-			if (st.size() < pt[crt][term].where * 2)
-				throw std::logic_error("Grammar error: Stack underflow.");
-			for (unsigned int i = 0; i < pt[crt][term].where; ++i) {
-				st.pop();
-				st.pop();
+			skipping = false;
+		}
+		int term = scanner.get();
+		if (term == json::scanner<Char>::ERROR)
+			return ERROR;
+		if (json::scanner<Char>::PENDING == term || (json::scanner<Char>::EOS == term && !first))
+			return PENDING;
+		first = false;
+		result_t r = advance(term);
+		if (PENDING != r)
+			return r;
+	} while (true);
+}
+
+template<typename Char, typename Handler>
+typename parser<Char, Handler>::result_t
+parser<Char, Handler>::advance(int term) {
+	// the refinements of OTHER share its column
+	int col = term > json::scanner<Char>::PENDING ? static_cast<int>(json::scanner<Char>::OTHER) : term;
+	// in multi-document mode, the input may end between documents
+	if (multi && 0 == sp && json::scanner<Char>::EOS == col)
+		return OK;
+	do {
+		switch (pt[crt][col].what) {
+		case -1:
+			return ERROR;
+		case SHIFT:
+			if (json::scanner<Char>::L_BRACE == term || json::scanner<Char>::L_BRACKET == term) {
+				if (0 != lim.max_depth && depth == lim.max_depth) {
+					failure = DEPTH_LIMIT;
+					return ERROR;
+				}
+				++depth;
+			} else if (json::scanner<Char>::R_BRACE == term || json::scanner<Char>::R_BRACKET == term)
+				--depth;
+			crt = pt[crt][col].where;
+			if ((16 == crt || 29 == crt) && sp >= 2 && st[sp - 2] == crt) {
+				// the lists of members and of elements are right recursive. A member followed by a comma
+				// leads from state 15 to 16 (an element from 27 to 29) whatever precedes it, so the stack
+				// would grow by one such pair per member. The reductions at the end of the list yield the
+				// same whether there are one or many pairs, so only one is kept.
+				--sp;
+			} else {
+				if (STACK_SIZE == sp) {
+					failure = DEPTH_LIMIT;
+					return ERROR;
+				}
+				st[sp++] = static_cast<unsigned char>(crt);
+#ifdef JSON_STATS
+				if (sp > counters.max_depth)
+					counters.max_depth = sp;
+#endif
 			}
-			if (st.empty()) {
-				if (non_term != 0 || term != json::scanner<Char>::EOS)
+			semantics(crt, term);
+			if (multi && 0 == pt[crt][json::scanner<Char>::EOS].what) {
+				// the document is complete: it would be accepted at EOS. Accept it and start over.
+				if (pt[crt][json::scanner<Char>::EOS].where != sp)
+					throw std::logic_error("Grammar error: Stack underflow.");
+				sp = 0;
+				crt = 0;
+				if (0 != document_start) {
+					// fed: the document ends in the current chunk
+					if (0 != lim.max_document && document_bytes + (scanner.position() - document_start) > lim.max_document) {
+						failure = DOCUMENT_LIMIT;
+						return ERROR;
+					}
+					document_bytes = 0;
+					document_start = scanner.position();
+				}
+				Handler::document_end();
+			}
+			return PENDING;
+		default: { // reduce
+			int non_term = pt[crt][col].what;
+			unsigned int n = pt[crt][col].where;
+			if (sp < n)
+				throw std::logic_error("Grammar error: Stack underflow.");
+			sp -= n;
+			if (0 == sp) {
+				if (non_term != 0 || col != json::scanner<Char>::EOS)
 					throw std::logic_error("Grammar error: Empty stack.");
 				return OK;
 			}
-			crt = st.top();
-			st.push(non_term);
-			crt = pt[crt][non_term].where;
-			if (-1 == crt)
+			crt = st[sp - 1];
+			if (SHIFT != pt[crt][non_term].what)
 				throw std::logic_error("Grammar error: Invalid arc.");
-			st.push(crt);
+			if (STACK_SIZE == sp) {
+				failure = DEPTH_LIMIT;
+				return ERROR;
+			}
+			crt = pt[crt][non_term].where;
+			st[sp++] = static_cast<unsigned char>(crt);
 			break;
 		}
+		}
 	} while (true);
 }
 
-template<typename Char>
+template<typename Char, typename Handler>
 void
-parser<Char>::semantics(int state, const std::basic_string<Char>& token, int term) {
+parser<Char, Handler>::semantics(int state, int term) {
 	switch (state) {
 	// obj start
 	case 1:
 	case 10:
 	case 11:
-		if (0 != obj_start_cb)
-			(*obj_start_cb)(ctx);
+		Handler::obj_start();
+		if (Handler::skip()) {
+			skipping = true;
+			scanner.start_skip();
+		}
 		break;
 	// key
 	case 2:
-		if (0 != key_cb)
-			(*key_cb)(token, ctx);
+		Handler::key(scanner.text());
 		break;
 	// object end
 	case 13:
 	case 32:
 	case 34:
-		if (0 != obj_end_cb)
-			(*obj_end_cb)(ctx);
+		Handler::obj_end();
 		break;
 	// object primitive data
 	case 4:
 	case 5:
-		if (0 != obj_data_cb)
-			(*obj_data_cb)(token, term, ctx);
+		Handler::obj_data(scanner.text(), term);
 		break;
 
 	// array
@@ -316,74 +953,27 @@ parser<Char>::semantics(int state, const std::basic_string<Char>& token, int ter
 	case 6:
 	case 9:
 	case 19:
-		if (0 != array_start_cb)
-			(*array_start_cb)(ctx);
+		Handler::array_start();
+		if (Handler::skip()) {
+			skipping = true;
+			scanner.start_skip();
+		}
 		break;
 	// array end
 	case 23:
 	case 36:
 	case 37:
-		if (0 != array_end_cb)
-			(*array_end_cb)(ctx);
+		Handler::array_end();
 		break;
 	// array primitive data
 	case 7:
 	case 8:
-		if (0 != array_data_cb)
-			(*array_data_cb)(token, term, ctx);
+		Handler::array_data(scanner.text(), term);
 		break;
 	default:
 		break;
 	}
 }
 
-template<typename Char>
-inline void
-parser<Char>::hook_obj_start(hook_start_end_t cb) {
-	obj_start_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::hook_key(hook_key_t cb) {
-	key_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::hook_obj_data(hook_primitive_t cb) {
-	obj_data_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::hook_obj_end(hook_start_end_t cb) {
-	obj_end_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::hook_array_start(hook_start_end_t cb) {
-	array_start_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::hook_array_data(hook_primitive_t cb) {
-	array_data_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::hook_array_end(hook_start_end_t cb) {
-	array_end_cb = cb;
-}
-
-template<typename Char>
-inline void
-parser<Char>::set_context(void *ctx_) {
-	ctx = ctx_;
-}
-
 }
 #endif
@@ -0,0 +1,24 @@
+#include <new>
+#include "json_resource.hh"
+
+namespace json {
+
+namespace {
+
+//! \brief The resource of the global operator new. \sa json::new_delete_resource
+class new_delete : public memory_resource {
+protected:
+	void *do_allocate(size_t n, size_t) { return ::operator new(n); }
+	void do_deallocate(void *p, size_t, size_t) { ::operator delete(p); }
+};
+
+}
+
+memory_resource *
+new_delete_resource() {
+	// never destroyed, so that it may serve the containers of static objects until the very end
+	static memory_resource *r = new new_delete();
+	return r;
+}
+
+}
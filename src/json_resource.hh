@@ -0,0 +1,103 @@
+#ifndef __JSON_RESOURCE_HH__
+#define __JSON_RESOURCE_HH__
+
+#include <cstddef>
+#include <new>
+
+namespace json {
+
+/**
+ * \brief A source of memory, in the manner of std::pmr::memory_resource. The buffers of the scanner, the parser,
+ * the structural index, the arena and the tape are allocated through a resource given to their constructors,
+ * json::new_delete_resource by default. Hence all the memory of a parse may be served by one pool of the
+ * caller, e.g. a json::arena_resource, and released with it in one step.
+ */
+class memory_resource {
+public:
+	virtual ~memory_resource() {}
+	/**
+	 * \brief Allocates n bytes.
+	 *
+	 * \param n The number of bytes.
+	 * \param alignment The alignment, a power of two.
+	 * \return The allocated memory. Never 0.
+	 * \exception std::bad_alloc if no memory is available.
+	 */
+	void *allocate(size_t n, size_t alignment = sizeof(void *)) { return do_allocate(n, alignment); }
+	/**
+	 * \brief Gives back memory that was returned by \link json::memory_resource::allocate allocate\endlink with
+	 * the same size and alignment.
+	 */
+	void deallocate(void *p, size_t n, size_t alignment = sizeof(void *)) { do_deallocate(p, n, alignment); }
+protected:
+	//! \brief Allocates n bytes. \sa allocate
+	virtual void *do_allocate(size_t, size_t) = 0;
+	//! \brief Gives back memory. \sa deallocate
+	virtual void do_deallocate(void *, size_t, size_t) = 0;
+};
+
+//! \brief The resource that allocates with the global operator new. It is never destroyed.
+extern memory_resource *new_delete_resource();
+
+/**
+ * \brief An allocator that allocates through a json::memory_resource, in the manner of std::pmr::polymorphic_allocator.
+ * The resource is part of the value of the allocator rather than of its type, so the containers of the library
+ * have the same type whatever resource they use. Two allocators are equal if they use the same resource.
+ */
+template<typename T>
+class allocator {
+public:
+	typedef T value_type;
+	typedef T *pointer;
+	typedef const T *const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+	//! \brief The same allocator for another type.
+	template<typename U> struct rebind { typedef json::allocator<U> other; };
+
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param r The resource, 0 for json::new_delete_resource.
+	 */
+	allocator(json::memory_resource *r = 0) : res(0 == r ? json::new_delete_resource() : r) {}
+	//! \brief The copy constructor from an allocator for another type.
+	template<typename U> allocator(const json::allocator<U>& a) : res(a.resource()) {}
+	//! \brief The resource.
+	json::memory_resource *resource() const { return res; }
+
+	T *allocate(size_t n, const void * = 0) { return static_cast<T *>(res->allocate(n * sizeof(T), alignment())); }
+	void deallocate(T *p, size_t n) { res->deallocate(p, n * sizeof(T), alignment()); }
+	size_t max_size() const { return static_cast<size_t>(-1) / sizeof(T); }
+	void construct(T *p, const T& v) { new(static_cast<void *>(p)) T(v); }
+	void destroy(T *p) { p->~T(); }
+	T *address(T& r) const { return &r; }
+	const T *address(const T& r) const { return &r; }
+private:
+	//! \brief The alignment of T.
+	static size_t alignment() {
+		struct probe { char c; T t; };
+		return offsetof(probe, t);
+	}
+
+	//! \brief The resource.
+	json::memory_resource *res;
+};
+
+template<typename T, typename U>
+inline bool
+operator==(const json::allocator<T>& a, const json::allocator<U>& b) {
+	return a.resource() == b.resource();
+}
+
+template<typename T, typename U>
+inline bool
+operator!=(const json::allocator<T>& a, const json::allocator<U>& b) {
+	return a.resource() != b.resource();
+}
+
+}
+
+#endif
@@ -4,28 +4,29 @@
 namespace json {
 
 /**
- * \brief Transforms a unicode character (16 bits) in a UTF-8 character (a sequence of 1 to 3 8-bit characters).
+ * \brief Appends a code point to a string in UTF-8, a sequence of 1 to 4 characters.
  * 
- * \param unicode The unicode character to transform
- * \return The UTF-8 character
+ * \param r The string
+ * \param cp The code point, at most U+10FFFF
  */
 template<>
-std::basic_string<char>
-scanner<char>::unicode2utf8(const unsigned short unicode) const {
-	unsigned int utf8 = 0;
-	char *p = reinterpret_cast<char *>(&utf8);
-
-	if (unicode < 0x0080)
-		p[0] = static_cast<char>(unicode & 0x007f);
-	else if (unicode < 0x0800) {
-		p[0] = static_cast<char>(0x00c0 | (unicode >> 6));
-		p[1] = static_cast<char>(0x0080 | (unicode & 0x003f));
+void
+scanner<char>::append_code_point(std::basic_string<char>& r, unsigned long cp) {
+	if (cp < 0x80)
+		r.push_back(static_cast<char>(cp));
+	else if (cp < 0x800) {
+		r.push_back(static_cast<char>(0xc0 | (cp >> 6)));
+		r.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
+	} else if (cp < 0x10000) {
+		r.push_back(static_cast<char>(0xe0 | (cp >> 12)));
+		r.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+		r.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
 	} else {
-		p[0] = static_cast<char>(0x00e0 | (unicode >> 12));
-		p[1] = static_cast<char>(0x0080 | ((unicode >> 6) & 0x03ff));
-		p[2] = static_cast<char>(0x0080 | (unicode & 0x003f));
+		r.push_back(static_cast<char>(0xf0 | (cp >> 18)));
+		r.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3f)));
+		r.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3f)));
+		r.push_back(static_cast<char>(0x80 | (cp & 0x3f)));
 	}
-	return std::basic_string<char>(p);
 }
 
 }
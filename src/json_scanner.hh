@@ -1,27 +1,78 @@
 #ifndef __JSON_SCANNER_HH__
 #define __JSON_SCANNER_HH__
 
-#include <istream>
-#include <sstream>
 #include <string>
 #include <cctype>
 #include <stdexcept>
+#include "json_simd.hh"
+#include "json_stats.hh"
+#include "json_resource.hh"
+#include "json_checkpoint.hh"
 
 namespace json {
 
 /**
- * \brief The json scanner. The only public method is \link json::scanner::get get\endlink.
+ * \brief A view of the text of the token that was scanned last. No character is copied: the view points into
+ * the chunk that was fed to the scanner or, for a token that spans chunks, into a buffer of the scanner. Hence
+ * it is valid only until the scanner is invoked again.
  * 
- * The scanning is incremental, i.e. if end-of-stream occurs in the middle of an token,
+ * For STRING tokens the view is the raw body of the string, without the quotes. If the body contains escape
+ * sequences, \link json::string_ref::escaped escaped\endlink is true and \link json::string_ref::decode decode\endlink
+ * has to be used in order to get the actual string. Otherwise the raw body is the string.
+ * For the other tokens the view is the text of the token.
+ */
+template<typename Char>
+class string_ref {
+public:
+	//! \brief An empty view.
+	string_ref() : p(0), n(0), esc(false) {}
+	/**
+	 * \brief A view of n characters starting at p.
+	 * 
+	 * \param p The first character.
+	 * \param n The number of characters.
+	 * \param esc true if the characters contain escape sequences.
+	 */
+	string_ref(const Char *p_, size_t n_, bool esc_ = false) : p(p_), n(n_), esc(esc_) {}
+	//! \brief The first character of the raw text.
+	const Char *data() const { return p; }
+	//! \brief The number of characters of the raw text.
+	size_t size() const { return n; }
+	//! \brief true if the raw text contains escape sequences, i.e. if it differs from the decoded text.
+	bool escaped() const { return esc; }
+	/**
+	 * \brief Assigns the decoded text to s. The escape sequences are replaced only if there are any.
+	 * 
+	 * \param s The string that receives the decoded text.
+	 */
+	inline void decode(std::basic_string<Char>&) const;
+	//! \brief Returns the decoded text. \sa decode
+	inline std::basic_string<Char> str() const;
+private:
+	//! \brief The first character.
+	const Char *p;
+	//! \brief The number of characters.
+	size_t n;
+	//! \brief true if the characters contain escape sequences.
+	bool esc;
+};
+
+/**
+ * \brief The json scanner. The public methods are \link json::scanner::feed feed\endlink and \link json::scanner::get get\endlink.
+ * 
+ * The scanner runs its DFA directly over a contiguous range of characters (a chunk) that is
+ * handed to it by \link json::scanner::feed feed\endlink. No stream is involved.
+ * 
+ * The scanning is incremental, i.e. if the end of the chunk occurs in the middle of an token,
  * the scanner does not return a scan error but it returns PENDING, signalling to the caller
  * that input data is incompletely scanned.
- * After data is appended to the stream, the client may invoke the scanning method (\link json::scanner::get get\endlink) again.
+ * After the next chunk is fed, the client may invoke the scanning method (\link json::scanner::get get\endlink) again.
  * The scanner resumes from where it left.
  * 
  * For example, the stream contains initially '{ "hell'. Invoking the scanner twice results
  * in getting L_BRACE PENDING. Next, 'o" : 12' is added to the stream. Subsequently invoking the
  * scanner three times results in getting STRING("hello") COLON PENDING. Next, '3.4} ' is added to the
- * stream. Subsequently invoking the scanner three times results in getting OTHER(123.4) R_BRACE PENDING.
+ * stream. Subsequently invoking the scanner three times results in getting DOUBLE(123.4) R_BRACE PENDING.
  * In order to signal to the scanner that nothing will be added to the stream and that scanning must
  * complete, the scanner is invoked one more time, without adding anything to the stream. In this
  * case, the scanner returns EOS.
@@ -33,43 +84,147 @@ namespace json {
  * scanner is informed that nothing will be added to the stream anymore, i.e. "doll" without the closing
  * quote is really the last thing in the stream.
  * 
- * template<typename Char> std::basic_istream<Char>& operator>>(std::basic_istream<Char>&, Char&) or
- * template<typename Char> std::basic_istream<Char>& std::basic_istream<Char>::operator>>(Char&)
- * must be defined
+ * In the stream terminology used above, "adding something to the stream" means feeding the next
+ * chunk and "adding nothing" means feeding an empty chunk.
  * 
  */
 template<typename Char>
 class scanner {
 public:
-	//! The tokens IDs that may be returned by the scanner
+	/**
+	 * \brief The tokens IDs that may be returned by the scanner. OTHER is the class of the primitive tokens that are
+	 * not strings and it is not returned any more. Numbers are INTEGER if they have neither a fraction nor an exponent,
+	 * and DOUBLE otherwise. The constants true, false, and null are TRUE_CONST, FALSE_CONST, and NULL_CONST. The token
+	 * IDs that follow PENDING are refinements of OTHER, the parser treats them like OTHER.
+	 */
 	typedef enum {ERROR = -1, L_BRACE = 9, R_BRACE = 10, L_BRACKET = 11, R_BRACKET = 12,
-		COMMA = 13, STRING = 14, COLON = 15, OTHER = 16, EOS = 17, PENDING = 18} token_t;
+		COMMA = 13, STRING = 14, COLON = 15, OTHER = 16, EOS = 17, PENDING = 18,
+		INTEGER = 19, DOUBLE = 20, TRUE_CONST = 21, FALSE_CONST = 22, NULL_CONST = 23} token_t;
+
+	//! \brief The type of the buffers of the scanner.
+	typedef std::basic_string<Char, std::char_traits<Char>, json::allocator<Char> > buffer_t;
 
 	/**
-	 * \brief The scanner constructor. Gets a _reference_ to an istream. Scanning is performed on this
-	 * istream. Therefore, clients should not destroy the stream between calls to the parser.
-	 * If no scan error occurs, the scanner reads from the stream until end-of-stream is reached and the
-	 * eof flag is set. Therefore, the caller is responsible for clearing the state flags (eof flag)
-	 * of the stream between consecutive calls.
+	 * \brief The scanner constructor. The scanner has no chunk to scan until \link json::scanner::feed feed\endlink is called.
+	 *
+	 * \param r The resource the buffers are allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit scanner(json::memory_resource * = 0);
+	/**
+	 * \brief Sets the chunk that subsequent calls to \link json::scanner::get get\endlink scan. The characters
+	 * are not copied, so the chunk must stay valid until \link json::scanner::get get\endlink returns PENDING, EOS or
+	 * ERROR. A token that is incomplete at the end of the chunk is kept by the scanner, the chunk itself may then
+	 * be released. Feeding an empty chunk signals that no more data will arrive.
 	 * 
-	 * \param b The istream to scan.
-	 */  
-	scanner(std::basic_istream<Char>&);
+	 * \param p The first character of the chunk.
+	 * \param n The number of characters in the chunk.
+	 */
+	inline void feed(const Char *, size_t);
+	//! \brief Makes the scanner ready for a new input. The capacity of its buffers is kept.
+	inline void clear();
+	//! \brief The next character of the chunk to be scanned.
+	const Char *position() const { return cur; }
+	//! \brief The number of characters read before the current chunk that are kept for the next token.
+	size_t buffered() const { return data.size() + la_len; }
+	/**
+	 * \brief Sets the largest number of characters of a token, quotes included, and reserves the buffers for it.
+	 * A longer token is an ERROR, detected before it is buffered beyond the limit, so the scanner then never
+	 * allocates. \sa json::limits
+	 *
+	 * \param n The number of characters, 0 for no limit.
+	 */
+	inline void set_max_token(size_t);
+	//! \brief true if the last ERROR was a token longer than the limit. \sa set_max_token
+	bool token_too_long() const { return too_long; }
 	/**
-	 * \brief The scanning method. Scans the istream that was passed in the constructor.
+	 * \brief Sets whether the encoding of the strings and keys is validated, see json::simd::find_invalid_encoding.
+	 * The body of every string is checked when the string is complete, while it is still in the cache, and a
+	 * string that is not well-formed is an ERROR. The rest of the tokens is ASCII by the grammar anyway. The
+	 * containers that are \link json::scanner::skip skipped\endlink are not validated.
+	 *
+	 * \param v true for validation.
+	 */
+	void set_validate(bool v) { validate = v; }
+	//! \brief true if the last ERROR was a string that is not well-formed. \sa set_validate
+	bool encoding_error() const { return invalid; }
+#ifdef JSON_STATS
+	//! \brief The counters of the scanner. \sa json::parser::stats
+	const json::stats& stats() const { return counters; }
+	//! \brief Sets the counters to 0.
+	void clear_stats() { counters.clear(); }
+#endif
+	/**
+	 * \brief The scanning method. Scans the chunk that was passed to \link json::scanner::feed feed\endlink.
 	 * 
 	 * \param token A string that is filled by the method with the scanned token. This is used for
-	 * communicating the string to the caller and for determining the type of the OTHER tokens. For
+	 * communicating the string to the caller and for determining the value of the numbers. For
 	 * example, "123" (with quotes) will return STRING and the argument token will contain the string
-	 * "123" while 123 (without quotes) will return OTHER and the argument token will contain the string
+	 * "123" while 123 (without quotes) will return INTEGER and the argument token will contain the string
 	 * "123". Similarly, "true", "false", and "null" (with quotes) will return STRING,
-	 * while 'true', 'false', 'null' (without quotes) will return OTHER. In all cases, 'token' will contain
-	 * the string "true", "false", or "null" respectively. 
+	 * while 'true', 'false', 'null' (without quotes) will return TRUE_CONST, FALSE_CONST, and NULL_CONST. In all
+	 * cases, 'token' will contain the string "true", "false", or "null" respectively. 
 	 * \return The token that was scanned. One of ERROR, L_BRACE, R_BRACE, L_BRACKET, R_BRACKET, COMMA,
-	 * STRING, COLON, OTHER, EOS, and PENDING.
-	 * \exception std::runtime_error if an I/O error occurs while reading from the istream. 
+	 * STRING, COLON, INTEGER, DOUBLE, TRUE_CONST, FALSE_CONST, NULL_CONST, EOS, and PENDING.
 	 */
 	token_t get(std::basic_string<Char>&);
+	/**
+	 * \brief The scanning method that does not copy the scanned token. The text of the token is available
+	 * through \link json::scanner::text text\endlink until the scanner is invoked again.
+	 * \sa get(std::basic_string<Char>&)
+	 * 
+	 * \return The token that was scanned.
+	 */
+	token_t get();
+	//! \brief The text of the token that was scanned last. \sa string_ref
+	const string_ref<Char>& text() const { return lexeme; }
+	/**
+	 * \brief Replaces the escape sequences in the body of a string.
+	 * 
+	 * \param data The body of the string, without quotes.
+	 * \param len The length of the body.
+	 * \param r The string that receives the result.
+	 */
+	static void unescape(const Char *, size_t, std::basic_string<Char>&);
+	/**
+	 * \brief Scans one complete token that starts at p, independently of any chunk that was fed. This is
+	 * used by parsers that know where tokens start, e.g. from a \link json::structural_index structural index\endlink.
+	 * The state of the scanner is reset before and after the scan.
+	 * 
+	 * \param p The first character of the token.
+	 * \param limit The token may be followed only by blanks up to limit.
+	 * \param stop The characters up to stop may be read as lookahead. It is either limit or one past limit.
+	 * \return The token that was scanned, or ERROR if the characters up to limit are not one token. Its text
+	 * is available through \link json::scanner::text text\endlink.
+	 */
+	token_t scan(const Char *, const Char *, const Char *);
+	/**
+	 * \brief Prepares \link json::scanner::skip skip\endlink to jump over the content of the container whose opening
+	 * bracket was the last token.
+	 */
+	inline void start_skip();
+	/**
+	 * \brief Jumps over the content of a container without producing tokens. Only the nesting of the brackets and
+	 * whether the characters are in a string, possibly escaped, are tracked, so the content is not validated. The
+	 * scanner stops in front of the bracket that closes the container, which is the next token.
+	 * 
+	 * \return true if the closing bracket was reached, false if the chunk was exhausted before. In the latter
+	 * case, skip resumes from where it left when called after the next chunk is fed.
+	 */
+	bool skip();
+	/**
+	 * \brief Writes the state that the scanner keeps between two chunks: the DFA state, the part of the token that
+	 * the next chunk completes, the lookahead and the state of \link json::scanner::skip skip\endlink. The chunk
+	 * itself is not part of it, so it is taken after get or skip returned PENDING or false. The settings of the
+	 * scanner are not part of it either. \sa json::parser::checkpoint
+	 */
+	void checkpoint(json::checkpoint_writer&) const;
+	/**
+	 * \brief Reads the state that \link json::scanner::checkpoint checkpoint\endlink wrote. The scanner then
+	 * scans the next chunk that is fed as if it had scanned the previous ones itself.
+	 *
+	 * \return false if the state is not valid, in which case the scanner is cleared.
+	 */
+	bool restore(json::checkpoint_reader&);
 
 private:
 	/**
@@ -125,67 +280,130 @@ private:
 	token_t punctuation(const Char&) const;
 	/**
 	 * \brief This function is invoked by \link json::scanner::get get\endlink when scanning was successful in finding a token.
-	 * This function fills the argument with the substring of the input that constitutes the token
-	 * and returns the integer value corresponding to the token. It invokes \link json::scanner::punctuation punctuation\endlink if the
-	 * scanned character is in the PUNCT category. It buffers in \link json::scanner::buf buf\endlink the characters that it read from the
-	 * stream but did not include in the token that is currently returned.
+	 * This function points \link json::scanner::lexeme lexeme\endlink to the substring of the input that constitutes
+	 * the token and returns the integer value corresponding to the token. It invokes \link json::scanner::punctuation punctuation\endlink if the
+	 * scanned character is in the PUNCT character category. It gives back (\link json::scanner::unget unget\endlink) the characters
+	 * that it read but did not include in the token that is currently returned.
 	 * 
-	 * \param token The substring of the input stream that constitutes the token that is currently returned.
 	 * \return The integer value corresponding to the token.
 	 */
-	token_t success(std::basic_string<Char>&);
+	token_t success();
 	
 	/**
-	 * \brief Transforms a unicode character (16 bits) in a UTF-8 character
-	 * (a sequence of 1 to 3 8-bit characters).
+	 * \brief Appends a code point to a string in the encoding of the characters: UTF-8 for char (a sequence of
+	 * 1 to 4 characters), UTF-16 for 16-bit characters (a code point beyond U+FFFF becomes a surrogate pair), and
+	 * the code point itself for wider characters.
 	 * 
-	 * \param unicode The unicode character to transform
-	 * \return The UTF-8 character
+	 * \param r The string.
+	 * \param cp The code point, at most U+10FFFF.
 	 */
-	std::basic_string<Char> unicode2utf8(const unsigned short) const;
+	static inline void append_code_point(std::basic_string<Char>&, unsigned long);
 	/**
-	 * \brief This function is invoked on string tokens. It replaces the escape sequences in the string.
+	 * \brief Decodes the four hexadecimal digits starting at p.
 	 * 
-	 * \param data The string to be postprocessed
-	 * \param len The length of the string
-	 * \return The postprocessed string
+	 * \param p The first digit.
+	 * \return The value of the digits or -1 if one of the characters is not a hexadecimal digit.
 	 */
-	const std::basic_string<Char> postprocess(const std::basic_string<Char>&, size_t) const;
+	static inline int hex4(const Char *);
 	/**
 	 * \brief Resets the scanner, i.e. sets the current state to the initial state of the DFA and clears the
-	 * buffer in which the token that is currently scanned is buffered. However, it does not flush \link json::scanner::buf buf\endlink, the buffer
-	 * in which data that was read from the stream but not used in any token is kept for being retrieved in
+	 * buffer in which the token that is currently scanned is buffered. The next token starts at the current
+	 * position. However, it does not flush \link json::scanner::la la\endlink, the ring buffer in which
+	 * characters that were read but not used in any token are kept for being retrieved in
 	 * a subsequent invokation of \link json::scanner::get get\endlink.
 	 */
 	inline void reset();
 	/**
-	 * \brief Upon successful detection of a token, the data that was read from the stream but not included
-	 * in the found token is pushed in an internal buffer.
+	 * \brief Upon successful detection of a token, gives back the \link json::scanner::to_unget to_unget\endlink characters
+	 * that were read but not included in the found token. The characters that belong to the current chunk are given
+	 * back by moving \link json::scanner::cur cur\endlink backwards. The ones that were read before the current chunk are
+	 * pushed in front of the ring buffer \link json::scanner::la la\endlink. Hence the cost is O(lookahead) and no
+	 * memory is allocated.
+	 * 
+	 * \exception std::logic_error if more characters than the DFA lookahead are given back.
 	 */
 	inline void unget();
 	/**
-	 * \brief First it attempts to get a character from \link json::scanner::buf buf\endlink, the internal buffer in which characters read
-	 * from the input stream but not used in the last returned token are stored. If \link json::scanner::buf buf\endlink is empty, it attempts
-	 * to get a character from the input stream.
+	 * \brief First it attempts to get a character from \link json::scanner::la la\endlink, the ring buffer in which characters read
+	 * but not used in the last returned token are stored. Such a character is appended to \link json::scanner::data data\endlink
+	 * as it does not belong to the current chunk. If \link json::scanner::la la\endlink is empty, it takes
+	 * the next character of the chunk.
 	 * 
-	 * \param c The character that is got from \link json::scanner::buf buf\endlink or from the input stream
-	 * \exception runtime_error if an I/O error occurs during reading from the input stream.
+	 * \param c The character that is got from \link json::scanner::la la\endlink or from the chunk
+	 * \return false if both \link json::scanner::la la\endlink and the chunk are exhausted.
 	 */
-	void get(Char&);
+	inline bool get(Char&);
+	//! \brief Appends characters to \link json::scanner::data data\endlink.
+	inline void keep(const Char *, const Char *);
 
 	/**
-	 * \brief A reference to the input stream.
+	 * \brief The next character of the chunk to be scanned.
+	 */
+	const Char *cur;
+	/**
+	 * \brief One past the last character of the chunk.
+	 */
+	const Char *end;
+	/**
+	 * \brief The first character of the part of the currently scanned token that lies in the current chunk.
+	 * The currently scanned token consists of \link json::scanner::data data\endlink followed by the characters
+	 * from start to \link json::scanner::cur cur\endlink.
+	 */
+	const Char *start;
+	/**
+	 * \brief The buffer in which the part of the currently scanned token that does not lie in the current
+	 * chunk is buffered. This only happens for tokens that span chunks or that start with characters that
+	 * were given back to \link json::scanner::la la\endlink.
+	 */
+	buffer_t data;
+	/**
+	 * \brief The buffer that holds the last returned token if it did not lie in the chunk. It is swapped
+	 * with \link json::scanner::data data\endlink, so that the capacity of both buffers is kept.
+	 */
+	buffer_t held;
+	//! \brief The text of the last returned token.
+	string_ref<Char> lexeme;
+	//! \brief The largest number of characters of a token, 0 for no limit. \sa set_max_token
+	size_t max_token;
+	//! \brief true if the last ERROR was a token longer than \link json::scanner::max_token max_token\endlink.
+	bool too_long;
+	//! \brief true if the encoding of the strings is validated. \sa set_validate
+	bool validate;
+	//! \brief true if the last ERROR was a string that is not well-formed.
+	bool invalid;
+	//! \brief true if a backslash was encountered in the body of the currently scanned string.
+	bool escaped;
+	//! \brief The nesting depth of the container that \link json::scanner::skip skip\endlink jumps over.
+	unsigned long skip_depth;
+	//! \brief true if \link json::scanner::skip skip\endlink is in a string.
+	bool skip_in_string;
+	//! \brief true if \link json::scanner::skip skip\endlink is right after a backslash in a string.
+	bool skip_escape;
+	/**
+	 * \brief Tracks one character skipped by \link json::scanner::skip skip\endlink.
+	 * 
+	 * \return true if the character closes the container.
 	 */
-	std::basic_istream<Char>& str;
+	inline bool skip(const Char&);
+#ifdef JSON_STATS
+	//! \brief The counters.
+	json::stats counters;
+#endif
+
 	/**
-	 * \brief The buffer in which the currently scanned token is buffered.
+	 * \brief The capacity of the lookahead ring buffer, a power of two. The DFA never reads more than
+	 * three characters past an accepting state ("1e+" followed by a non-digit).
 	 */
-	std::basic_string<Char> data;
+	static const unsigned int LOOKAHEAD = 4;
 	/**
-	 * \brief The buffer in which characters that were read from the input stream but not used in the last
+	 * \brief The ring buffer in which characters that were read before the current chunk but not used in the last
 	 * returned token are stored for a subsequent invokation of the scanner.
 	 */
-	std::basic_stringstream<Char> buf;
+	Char la[LOOKAHEAD];
+	//! \brief The index of the first character in \link json::scanner::la la\endlink.
+	unsigned int la_head;
+	//! \brief The number of characters in \link json::scanner::la la\endlink.
+	unsigned int la_len;
 
 	/**
 	 * \brief The current DFA state.
@@ -201,10 +419,9 @@ private:
 	 */
 	context_t context;
 	/**
-	 * \brief Indicates how many characters have been read from the input stream but not yet included in a token.
-	 * They are stored in \link json::scanner::data data\endlink. After a token is detected, the part of \link json::scanner::data data\endlink that forms the token is returned to
-	 * the caller and the length of the token is subtracted from to_unget. The remaining characters (the ones read
-	 * but not included in the token) are then stored ("ungot") in \link json::scanner::buf buf\endlink in order to be retrieved
+	 * \brief Indicates how many characters have been read but not yet included in a token, i.e. how many
+	 * characters were read since the last accepting state. After a token is detected, these characters
+	 * are given back by \link json::scanner::unget unget\endlink in order to be retrieved
 	 * in a subsequent call to \link json::scanner::get get\endlink.
 	 */
 	unsigned int to_unget;
@@ -212,20 +429,24 @@ private:
 	/**
 	 * \brief The DFA.
 	 */
-	static const int st[28][19];
+	static const signed char st[28][19];
 	/**
 	 * \brief An array indicating if the DFA state corresponding to the array entry is an accepting state.
 	 * If yes, the array indicates which token the state accepts.
 	 */
-	static const int final[28];
+	static const signed char final[28];
+	/**
+	 * \brief The values of the hexadecimal digits, indexed by the ASCII characters. -1 for the other characters.
+	 */
+	static const signed char hex[128];
 };
 
-template<typename Char> const int
+template<typename Char> const signed char
 scanner<Char>::st[28][19] =
 	// A   E   F   L   N   R   S   T   U {}[]:, 1-9 \. +-  \   " [^"\] . ' \t\r\n\f'
 	{{-1, -1, 16, -1,  7, -1, -1, 11, -1, 15,  2, 22, 27, -1,  1, -1, -1,  0, 21},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  5,  4,  3, -1, -1, -1},
-	 {-1, 24, -1, -1, -1, -1, -1, -1, -1, -1,  2, 23, -1, -1,  1, -1, -1, -1,  2},
+	 {-1, 24, -1, -1, -1, -1, -1, -1, -1, -1,  2, 23, -1, -1, -1, -1, -1, -1,  2},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  5,  4,  3, -1, -1, -1},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  6, -1, -1},
@@ -244,21 +465,64 @@ scanner<Char>::st[28][19] =
 	 {-1, -1, -1, -1, -1, -1, 19, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 	 {-1, 20, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1},
-	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 23, -1, -1, -1, -1, -1, -1. -1},
+	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 23, -1, -1, -1, -1, -1, -1, -1},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 23, -1, -1, -1, -1, -1, -1, -1, 23},
 	 {-1, 24, -1, -1, -1, -1, -1, -1, -1, -1, 23, -1, -1, -1, -1, -1, -1, -1, 23},
-	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1, 25, -1, -1, -1, -1, -1, -1},
-	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1, -1, -1, -1, -1, -1, -1, -1},
+	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1, 25, -1, -1, -1, -1, -1, 26},
+	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1, -1, -1, -1, -1, -1, -1, 26},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 26, -1, -1, -1, -1, -1, -1, -1, 26},
 	 {-1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  2, 22, -1, -1, -1, -1, -1, -1, 21}};
 
 template<typename Char>
-const int
-scanner<Char>::final[] = {0, 0, OTHER, 0, STRING, 0, 0, 0, 0, 0, OTHER, 0, 0, 0, OTHER, PUNCT, 0, 0, 0, 0, OTHER, OTHER, 0, OTHER, 0, 0, OTHER, 0};
+const signed char
+scanner<Char>::final[] = {0, 0, INTEGER, 0, STRING, 0, 0, 0, 0, 0, NULL_CONST, 0, 0, 0, TRUE_CONST, PUNCT, 0, 0, 0, 0, FALSE_CONST, INTEGER, 0, DOUBLE, 0, 0, DOUBLE, 0};
+
+template<typename Char>
+const signed char
+scanner<Char>::hex[128] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+
+template<typename Char>
+inline void
+string_ref<Char>::decode(std::basic_string<Char>& s) const {
+	if (esc)
+		scanner<Char>::unescape(p, n, s);
+	else
+		s.assign(p, n);
+}
+
+template<typename Char>
+inline std::basic_string<Char>
+string_ref<Char>::str() const {
+	std::basic_string<Char> s;
+	decode(s);
+	return s;
+}
 
 template<typename Char>
-scanner<Char>::scanner(std::basic_istream<Char>& b) :
-	str(b),
+scanner<Char>::scanner(json::memory_resource *r) :
+	cur(0),
+	end(0),
+	start(0),
+	data(json::allocator<Char>(r)),
+	held(json::allocator<Char>(r)),
+	max_token(0),
+	too_long(false),
+	validate(false),
+	invalid(false),
+	escaped(false),
+	skip_depth(0),
+	skip_in_string(false),
+	skip_escape(false),
+	la_head(0),
+	la_len(0),
 	crt(0),
 	last_final(-1),
 	context(DFLT_CONTEXT),
@@ -266,26 +530,69 @@ scanner<Char>::scanner(std::basic_istream<Char>& b) :
 {
 }
 
+template<typename Char>
+inline void
+scanner<Char>::feed(const Char *p, size_t n) {
+	cur = p;
+	end = p + n;
+	start = p;
+}
+
+template<typename Char>
+inline void
+scanner<Char>::clear() {
+	cur = end = start = 0;
+	la_head = la_len = 0;
+	last_final = -1;
+	to_unget = 0;
+	skip_depth = 0;
+	skip_in_string = skip_escape = false;
+	too_long = invalid = false;
+	reset();
+}
+
+template<typename Char>
+inline void
+scanner<Char>::set_max_token(size_t n) {
+	max_token = n;
+	if (0 != n) {
+		// the characters given back to the lookahead may be appended to a token of the maximal length
+		data.reserve(n + LOOKAHEAD);
+		held.reserve(n + LOOKAHEAD);
+	}
+}
+
 template<typename Char>
 inline void 
 scanner<Char>::reset() {
 	crt = 0;
 	context = DFLT_CONTEXT;
+	escaped = false;
 	data.clear();
+	start = cur;
 }
 
 // called from success.
 template<typename Char>
 inline void
 scanner<Char>::unget() {
-	std::basic_string<Char> internal(buf.str());
-	// discard the characters already read.
-	internal.erase(0, buf.tellg());
-	// push the characters in data that were not used in the last detected token
-	internal.insert(0, data.substr(data.size() - to_unget));
-	buf.str(internal);
-	// clear the eof flag
-	buf.clear();
+	// give back the characters of the current chunk
+	unsigned int n = static_cast<unsigned int>(cur - start);
+	if (n > to_unget)
+		n = to_unget;
+	cur -= n;
+	to_unget -= n;
+	if (0 == to_unget)
+		return;
+	// push the characters read before the current chunk in front of the ring buffer
+	if (la_len + to_unget > LOOKAHEAD)
+		throw std::logic_error("Lookahead");
+	JSON_STATS_ADD(counters.unget_bytes, to_unget);
+	la_head = (la_head - to_unget) & (LOOKAHEAD - 1);
+	la_len += to_unget;
+	for (unsigned int i = 0; i < to_unget; ++i)
+		la[(la_head + i) & (LOOKAHEAD - 1)] = data[data.size() - to_unget + i];
+	data.resize(data.size() - to_unget);
 	to_unget = 0;
 }
 
@@ -298,6 +605,7 @@ scanner<Char>::translate(const Char& c) {
 		switch (c) {
 		case static_cast<Char>('\\'):
 			context = BACKSLASH_CONTEXT;
+			escaped = true;
 			return BACKSLASH;
 		case static_cast<Char>('\"'):
 			context = DFLT_CONTEXT;
@@ -400,113 +708,354 @@ scanner<Char>::punctuation(const Char& c) const {
 }
 
 template<typename Char>
-const std::basic_string<Char>
-scanner<Char>::postprocess(const std::basic_string<Char>& data, size_t len) const {
-	std::basic_string<Char> r;
-	for (size_t i = 1; i < len; ++i) {
-		Char c = data[i];
-		if (c != static_cast<Char>('\\'))
-			r.push_back(static_cast<Char>(c));
-		else {
-			++i;
-			c = data[i];
-			switch (c) {
-			case static_cast<Char>('\\'):
-			case static_cast<Char>('/'):
-			case static_cast<Char>('"'):
-				r.push_back(static_cast<Char>(c));
-				break;
-			case static_cast<Char>('t'):
-				r.push_back(static_cast<Char>('\t'));
-				break;
-			case static_cast<Char>('n'):
-				r.push_back(static_cast<Char>('\n'));
-				break;
-			case static_cast<Char>('r'):
-				r.push_back(static_cast<Char>('\r'));
-				break;
-			case static_cast<Char>('f'):
-				r.push_back(static_cast<Char>('\f'));
-				break;
-			case static_cast<Char>('b'):
-				r.push_back(static_cast<Char>('\b'));
-				break;
-			case static_cast<Char>('u'):
-				if (i + 4 < len) {
-					std::basic_istringstream<Char> s(data.substr(i + 1, 4));
-					unsigned short unicode;
-					s >> std::hex >> unicode;
-					if (s.eof()) {
-						r.append(unicode2utf8(unicode)); 
-						i += 4;
-						break;
+inline int
+scanner<Char>::hex4(const Char *p) {
+	int r = 0;
+	for (unsigned int i = 0; i < 4; ++i) {
+		if (static_cast<unsigned long>(p[i]) >= sizeof(hex))
+			return -1;
+		int d = hex[static_cast<unsigned long>(p[i])];
+		if (d < 0)
+			return -1;
+		r = (r << 4) | d;
+	}
+	return r;
+}
+
+template<typename Char>
+inline void
+scanner<Char>::append_code_point(std::basic_string<Char>& r, unsigned long cp) {
+	if (2 == sizeof(Char) && cp > 0xffff) {
+		cp -= 0x10000;
+		r.push_back(static_cast<Char>(0xd800 + (cp >> 10)));
+		r.push_back(static_cast<Char>(0xdc00 + (cp & 0x3ff)));
+	} else
+		r.push_back(static_cast<Char>(cp));
+}
+
+//! \brief Appends a code point in UTF-8. \sa scanner::append_code_point
+template<>
+void scanner<char>::append_code_point(std::basic_string<char>&, unsigned long);
+
+template<typename Char>
+void
+scanner<Char>::unescape(const Char *data, size_t len, std::basic_string<Char>& r) {
+	r.clear();
+	size_t i = 0;
+	while (i < len) {
+		// copy the run up to the next backslash at once
+		size_t j = i;
+		while (j < len && data[j] != static_cast<Char>('\\'))
+			++j;
+		r.append(data + i, j - i);
+		if (j + 1 >= len)
+			break;
+		i = j + 2;
+		Char c = data[j + 1];
+		switch (c) {
+		case static_cast<Char>('t'):
+			r.push_back(static_cast<Char>('\t'));
+			break;
+		case static_cast<Char>('n'):
+			r.push_back(static_cast<Char>('\n'));
+			break;
+		case static_cast<Char>('r'):
+			r.push_back(static_cast<Char>('\r'));
+			break;
+		case static_cast<Char>('f'):
+			r.push_back(static_cast<Char>('\f'));
+			break;
+		case static_cast<Char>('b'):
+			r.push_back(static_cast<Char>('\b'));
+			break;
+		case static_cast<Char>('u'):
+			if (i + 4 <= len) {
+				long cp = hex4(data + i);
+				if (cp >= 0) {
+					i += 4;
+					// a high surrogate followed by the escape of a low one is one code point
+					if (cp >= 0xd800 && cp < 0xdc00 && i + 6 <= len && static_cast<Char>('\\') == data[i]
+							&& static_cast<Char>('u') == data[i + 1]) {
+						long low = hex4(data + i + 2);
+						if (low >= 0xdc00 && low < 0xe000) {
+							cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
+							i += 6;
+						}
 					}
+					// an unpaired surrogate has no encoding: it becomes the replacement character
+					if (cp >= 0xd800 && cp < 0xe000)
+						cp = 0xfffd;
+					append_code_point(r, static_cast<unsigned long>(cp));
+					break;
 				}
-				r.push_back(static_cast<Char>('u'));
-				break;
-			default:
-				r.push_back(c);
-				break;
 			}
+			r.push_back(static_cast<Char>('u'));
+			break;
+		default:
+			// '\\', '/', '"' and any other escaped character stand for themselves
+			r.push_back(c);
+			break;
 		}
 	}
-	return r;
 }
 
 template<typename Char>
 typename scanner<Char>::token_t
-scanner<Char>::success(std::basic_string<Char>& token) {
+scanner<Char>::success() {
 	int terminal = final[last_final];
+	bool esc = escaped;
 	last_final = -1;
-	if (terminal == STRING)
-		token = postprocess(data, data.size() - to_unget - 1);
-	else
-		token = data.substr(0, data.size() - to_unget);
 	if (to_unget > 0)
 		unget();
+	const Char *p;
+	size_t n;
+	if (0 != max_token && data.size() + (cur - start) > max_token) {
+		too_long = true;
+		reset();
+		return ERROR;
+	}
+	if (data.empty()) {
+		// the usual case: the token lies entirely in the current chunk
+		p = start;
+		n = cur - start;
+	} else {
+		keep(start, cur);
+		held.swap(data);
+		p = held.data();
+		n = held.size();
+	}
+	if (terminal == STRING) {
+		if (validate && json::simd::find_invalid_encoding(p + 1, p + n - 1) != p + n - 1) {
+			invalid = true;
+			reset();
+			return ERROR;
+		}
+		lexeme = string_ref<Char>(p + 1, n - 2, esc);
+	} else
+		lexeme = string_ref<Char>(p, n);
 	reset();
-	if (terminal != PUNCT)
-		return static_cast<token_t>(terminal);
-	return punctuation(token.at(0));
+	token_t t = terminal != PUNCT ? static_cast<token_t>(terminal) : punctuation(*p);
+	JSON_STATS_ADD(counters.tokens[t], 1);
+	return t;
+}
+
+template<typename Char>
+typename scanner<Char>::token_t
+scanner<Char>::scan(const Char *p, const Char *limit, const Char *stop) {
+	la_len = 0;
+	last_final = -1;
+	to_unget = 0;
+	feed(p, stop - p);
+	reset();
+	token_t t = get();
+	if (PENDING == t)
+		t = get();
+	if (0 != la_len || cur > limit || json::simd::skip_blanks(cur, limit) != limit || EOS == t)
+		t = ERROR;
+	la_len = 0;
+	last_final = -1;
+	to_unget = 0;
+	reset();
+	return t;
 }
 
 template<typename Char>
 void
+scanner<Char>::checkpoint(json::checkpoint_writer& w) const {
+	w.put(crt);
+	w.put(last_final + 1);
+	w.put(context);
+	w.put(to_unget);
+	w.put(escaped);
+	w.put(too_long);
+	w.put(invalid);
+	w.put(skip_depth);
+	w.put(skip_in_string);
+	w.put(skip_escape);
+	w.put(la_len);
+	for (unsigned int i = 0; i < la_len; ++i)
+		w.put_char(la[(la_head + i) & (LOOKAHEAD - 1)]);
+	w.put(data.size());
+	for (size_t i = 0; i < data.size(); ++i)
+		w.put_char(data[i]);
+}
+
+template<typename Char>
+bool
+scanner<Char>::restore(json::checkpoint_reader& r) {
+	clear();
+	uint64_t v[11];
+	const uint64_t max[11] = {sizeof(st) / sizeof(st[0]) - 1, sizeof(final), DFLT_CONTEXT, ~static_cast<uint64_t>(0), 1, 1, 1,
+		~static_cast<uint64_t>(0), 1, 1, LOOKAHEAD};
+	for (unsigned int i = 0; i < sizeof(v) / sizeof(v[0]); ++i)
+		if (!r.get(v[i], max[i]))
+			return false;
+	for (la_len = 0; la_len < v[10]; ++la_len)
+		if (!r.get_char(la[la_len])) {
+			clear();
+			return false;
+		}
+	uint64_t n;
+	bool ok = r.get(n) && n >= v[3] && (0 == max_token || n <= max_token + LOOKAHEAD);
+	for (uint64_t i = 0; ok && i < n; ++i) {
+		Char c;
+		ok = r.get_char(c);
+		if (ok)
+			data.push_back(c);
+	}
+	if (!ok || (0 != v[1] && 0 == final[v[1] - 1])) {
+		clear();
+		return false;
+	}
+	crt = static_cast<int>(v[0]);
+	last_final = static_cast<int>(v[1]) - 1;
+	context = static_cast<context_t>(v[2]);
+	to_unget = static_cast<unsigned int>(v[3]);
+	escaped = 0 != v[4];
+	too_long = 0 != v[5];
+	invalid = 0 != v[6];
+	skip_depth = static_cast<unsigned long>(v[7]);
+	skip_in_string = 0 != v[8];
+	skip_escape = 0 != v[9];
+	return true;
+}
+
+template<typename Char>
+inline void
+scanner<Char>::start_skip() {
+	skip_depth = 1;
+	skip_in_string = false;
+	skip_escape = false;
+}
+
+template<typename Char>
+inline bool
+scanner<Char>::skip(const Char& c) {
+	if (skip_in_string) {
+		if (skip_escape)
+			skip_escape = false;
+		else if (static_cast<Char>('\\') == c)
+			skip_escape = true;
+		else if (static_cast<Char>('"') == c)
+			skip_in_string = false;
+		return false;
+	}
+	switch (c) {
+	case static_cast<Char>('"'):
+		skip_in_string = true;
+		break;
+	case static_cast<Char>('{'):
+	case static_cast<Char>('['):
+		++skip_depth;
+		break;
+	case static_cast<Char>('}'):
+	case static_cast<Char>(']'):
+		return 0 == --skip_depth;
+	default:
+		break;
+	}
+	return false;
+}
+
+template<typename Char>
+bool
+scanner<Char>::skip() {
+	// the characters given back to the ring buffer come first
+	while (la_len > 0) {
+		Char c = la[la_head];
+		la_head = (la_head + 1) & (LOOKAHEAD - 1);
+		--la_len;
+		if (skip(c)) {
+			// give the closing bracket back
+			la_head = (la_head - 1) & (LOOKAHEAD - 1);
+			++la_len;
+			reset();
+			return true;
+		}
+	}
+	while (cur != end) {
+		if (skip_in_string && !skip_escape) {
+			// jump over the run of ordinary characters of the string
+			cur = json::simd::find_string_special(cur, end);
+			if (cur == end)
+				break;
+		}
+		if (skip(*cur)) {
+			reset();
+			return true;
+		}
+		++cur;
+	}
+	reset();
+	return false;
+}
+
+template<typename Char>
+inline bool
 scanner<Char>::get(Char& c) {
-	buf >> c;
-	if (buf.bad())
-		throw std::runtime_error("I/O");
-	if (buf.eof()) {
-		str >> c;
-		if (str.bad())
-			throw std::runtime_error("I/O");
+	if (la_len > 0) {
+		c = la[la_head];
+		la_head = (la_head + 1) & (LOOKAHEAD - 1);
+		--la_len;
+		keep(&c, &c + 1);
+		return true;
 	}
+	if (cur == end)
+		return false;
+	c = *cur++;
+	return true;
+}
+
+template<typename Char>
+inline void
+scanner<Char>::keep(const Char *b, const Char *e) {
+#ifdef JSON_STATS
+	size_t capacity = data.capacity();
+	data.append(b, e);
+	counters.copied_bytes += e - b;
+	counters.allocated_bytes += data.capacity() - capacity;
+#else
+	data.append(b, e);
+#endif
 }
 
 template<typename Char>
 typename scanner<Char>::token_t
 scanner<Char>::get(std::basic_string<Char>& token) {
+	token_t t = get();
+	if (ERROR != t && PENDING != t && EOS != t)
+		lexeme.decode(token);
+	return t;
+}
+
+template<typename Char>
+typename scanner<Char>::token_t
+scanner<Char>::get() {
 	Char c;
-	get(c);
-	if (buf.eof() && str.eof()) {
+	if (!get(c)) {
 		if (last_final != -1)
-			return success(token);
+			return success();
 		if (to_unget > 0) {
 			reset();
 			return ERROR;
 		}
 		return EOS;
 	}
-	symbols_t type = translate(c);
-	if (type != BLANK) {
-		data.push_back(c);
-		++to_unget;
-	}
 	do {
+		symbols_t type = translate(c);
+		if (0 == crt && type == BLANK) {
+			// blanks between tokens are not part of any token. Jump over the whole run.
+			if (0 == la_len)
+				cur = json::simd::skip_blanks(cur, end);
+			data.clear();
+			start = cur;
+			continue;
+		}
+		++to_unget;
 		crt = st[crt][type];
 		if (-1 == crt) {
 			if (last_final != -1)
-				return success(token);
+				return success();
 			else {
 				reset();
 				return ERROR;
@@ -516,15 +1065,26 @@ scanner<Char>::get(std::basic_string<Char>& token) {
 			last_final = crt;
 			to_unget = 0;
 		}
-		get(c);
-		if (buf.eof() && str.eof())
-			return PENDING;
-		type = translate(c);
-		if (type != BLANK) {
-			data.push_back(c);
-			++to_unget;
+		if (STRING_CONTEXT == context && 0 == la_len) {
+			// in the body of a string (states 1, 3, and 6) every character but quote, backslash and the
+			// control characters leads to state 3. Jump over the whole run.
+			const Char *special = json::simd::find_string_special(cur, end);
+			if (special != cur) {
+				to_unget += static_cast<unsigned int>(special - cur);
+				cur = special;
+				crt = 3;
+			}
 		}
-	} while (true);
+	} while (get(c));
+	// the chunk is exhausted. Keep the part of the token that lies in it, unless the token is too long already.
+	if (0 != max_token && data.size() + (cur - start) > max_token) {
+		too_long = true;
+		reset();
+		return ERROR;
+	}
+	keep(start, cur);
+	start = cur;
+	return PENDING;
 }
 
 }
@@ -0,0 +1,431 @@
+#include "json_simd.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define JSON_SIMD_X86
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define JSON_SIMD_NEON
+#endif
+
+namespace json {
+
+namespace simd {
+
+namespace {
+
+inline bool
+is_special(char c) {
+	return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+inline bool
+is_blank(char c) {
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+const char *
+find_string_special_scalar(const char *p, const char *end) {
+	for (; p != end; ++p)
+		if (is_special(*p))
+			return p;
+	return end;
+}
+
+const char *
+skip_blanks_scalar(const char *p, const char *end) {
+	for (; p != end; ++p)
+		if (!is_blank(*p))
+			return p;
+	return end;
+}
+
+// Returns the length of the well-formed UTF-8 sequence that starts at p, 0 if there is none (Unicode, table 3-7).
+inline size_t
+utf8_sequence(const char *p, const char *end) {
+	const unsigned char *u = reinterpret_cast<const unsigned char *>(p);
+	size_t avail = end - p;
+	unsigned char c = u[0];
+	if (c < 0x80)
+		return 1;
+	size_t n;
+	unsigned char lo = 0x80, hi = 0xbf;
+	if (c < 0xc2)
+		return 0;
+	else if (c < 0xe0)
+		n = 2;
+	else if (c < 0xf0) {
+		n = 3;
+		if (0xe0 == c)
+			lo = 0xa0;
+		else if (0xed == c)
+			hi = 0x9f;
+	} else if (c < 0xf5) {
+		n = 4;
+		if (0xf0 == c)
+			lo = 0x90;
+		else if (0xf4 == c)
+			hi = 0x8f;
+	} else
+		return 0;
+	if (avail < n || u[1] < lo || u[1] > hi)
+		return 0;
+	for (size_t i = 2; i < n; ++i)
+		if ((u[i] & 0xc0) != 0x80)
+			return 0;
+	return n;
+}
+
+const char *
+find_invalid_encoding_scalar(const char *p, const char *end) {
+	while (p != end) {
+		size_t n = utf8_sequence(p, end);
+		if (0 == n)
+			return p;
+		p += n;
+	}
+	return end;
+}
+
+void
+classify_scalar(const char *p, block_masks_t& m) {
+	m.quote = m.backslash = m.op = m.blank = 0;
+	for (unsigned int i = 0; i < 64; ++i) {
+		uint64_t bit = static_cast<uint64_t>(1) << i;
+		switch (p[i]) {
+		case '"':
+			m.quote |= bit;
+			break;
+		case '\\':
+			m.backslash |= bit;
+			break;
+		case '{':
+		case '}':
+		case '[':
+		case ']':
+		case ':':
+		case ',':
+			m.op |= bit;
+			break;
+		case ' ':
+		case '\t':
+		case '\n':
+		case '\r':
+		case '\f':
+			m.blank |= bit;
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+#ifdef JSON_SIMD_X86
+
+__attribute__((target("sse2"))) void
+classify_sse2(const char *p, block_masks_t& m) {
+	m.quote = m.backslash = m.op = m.blank = 0;
+	for (unsigned int i = 0; i < 64; i += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i));
+		// '[' | 0x20 == '{' and ']' | 0x20 == '}'
+		__m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+		__m128i op = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(lower, _mm_set1_epi8('{')), _mm_cmpeq_epi8(lower, _mm_set1_epi8('}'))),
+			_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(':')), _mm_cmpeq_epi8(v, _mm_set1_epi8(','))));
+		__m128i blank = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\f'))));
+		m.quote |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('"'))) & 0xffff) << i;
+		m.backslash |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))) & 0xffff) << i;
+		m.op |= static_cast<uint64_t>(_mm_movemask_epi8(op) & 0xffff) << i;
+		m.blank |= static_cast<uint64_t>(_mm_movemask_epi8(blank) & 0xffff) << i;
+	}
+}
+
+__attribute__((target("avx2"))) void
+classify_avx2(const char *p, block_masks_t& m) {
+	m.quote = m.backslash = m.op = m.blank = 0;
+	for (unsigned int i = 0; i < 64; i += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + i));
+		__m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		__m256i op = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(lower, _mm256_set1_epi8('{')), _mm256_cmpeq_epi8(lower, _mm256_set1_epi8('}'))),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(':')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8(','))));
+		__m256i blank = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f'))));
+		m.quote |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('"'))))) << i;
+		m.backslash |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\\'))))) << i;
+		m.op |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(op))) << i;
+		m.blank |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(blank))) << i;
+	}
+}
+
+__attribute__((target("sse2"))) const char *
+find_string_special_sse2(const char *p, const char *end) {
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	const __m128i control = _mm_set1_epi8(0x1f);
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		// v <= 0x1f (unsigned) iff min(v, 0x1f) == v
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+			_mm_cmpeq_epi8(_mm_min_epu8(v, control), v));
+		int mask = _mm_movemask_epi8(m);
+		if (0 != mask)
+			return p + __builtin_ctz(mask);
+	}
+	return find_string_special_scalar(p, end);
+}
+
+__attribute__((target("sse2"))) const char *
+skip_blanks_sse2(const char *p, const char *end) {
+	for (; end - p >= 16; p += 16) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		__m128i m = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))),
+				_mm_cmpeq_epi8(v, _mm_set1_epi8('\f'))));
+		int mask = ~_mm_movemask_epi8(m) & 0xffff;
+		if (0 != mask)
+			return p + __builtin_ctz(mask);
+	}
+	return skip_blanks_scalar(p, end);
+}
+
+__attribute__((target("avx2"))) const char *
+find_string_special_avx2(const char *p, const char *end) {
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i backslash = _mm256_set1_epi8('\\');
+	const __m256i control = _mm256_set1_epi8(0x1f);
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, quote), _mm256_cmpeq_epi8(v, backslash)),
+			_mm256_cmpeq_epi8(_mm256_min_epu8(v, control), v));
+		unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(m));
+		if (0 != mask)
+			return p + __builtin_ctz(mask);
+	}
+	return find_string_special_sse2(p, end);
+}
+
+__attribute__((target("avx2"))) const char *
+skip_blanks_avx2(const char *p, const char *end) {
+	for (; end - p >= 32; p += 32) {
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		__m256i m = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+			_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))),
+				_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\f'))));
+		unsigned int mask = ~static_cast<unsigned int>(_mm256_movemask_epi8(m));
+		if (0 != mask)
+			return p + __builtin_ctz(mask);
+	}
+	return skip_blanks_sse2(p, end);
+}
+
+__attribute__((target("sse2"))) const char *
+find_invalid_encoding_sse2(const char *p, const char *end) {
+	while (end - p >= 16) {
+		int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+		if (0 == mask) {
+			p += 16;
+			continue;
+		}
+		// jump to the first byte that is not ASCII and check its sequence
+		p += __builtin_ctz(mask);
+		size_t n = utf8_sequence(p, end);
+		if (0 == n)
+			return p;
+		p += n;
+	}
+	return find_invalid_encoding_scalar(p, end);
+}
+
+__attribute__((target("avx2"))) const char *
+find_invalid_encoding_avx2(const char *p, const char *end) {
+	while (end - p >= 32) {
+		unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p))));
+		if (0 == mask) {
+			p += 32;
+			continue;
+		}
+		p += __builtin_ctz(mask);
+		size_t n = utf8_sequence(p, end);
+		if (0 == n)
+			return p;
+		p += n;
+	}
+	return find_invalid_encoding_sse2(p, end);
+}
+
+#endif
+
+#ifdef JSON_SIMD_NEON
+
+// Returns a 64-bit mask with 4 bits per byte of the comparison result m.
+inline uint64_t
+neon_mask(uint8x16_t m) {
+	return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+
+// Returns a 16-bit mask with 1 bit per byte of the comparison result m.
+inline uint64_t
+neon_movemask(uint8x16_t m) {
+	static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+	uint8x16_t t = vandq_u8(m, vld1q_u8(weights));
+	return static_cast<uint64_t>(vaddv_u8(vget_low_u8(t))) | (static_cast<uint64_t>(vaddv_u8(vget_high_u8(t))) << 8);
+}
+
+void
+classify_neon(const char *p, block_masks_t& m) {
+	m.quote = m.backslash = m.op = m.blank = 0;
+	for (unsigned int i = 0; i < 64; i += 16) {
+		uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p + i));
+		uint8x16_t lower = vorrq_u8(v, vdupq_n_u8(0x20));
+		uint8x16_t op = vorrq_u8(vorrq_u8(vceqq_u8(lower, vdupq_n_u8('{')), vceqq_u8(lower, vdupq_n_u8('}'))),
+			vorrq_u8(vceqq_u8(v, vdupq_n_u8(':')), vceqq_u8(v, vdupq_n_u8(','))));
+		uint8x16_t blank = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+			vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))),
+				vceqq_u8(v, vdupq_n_u8('\f'))));
+		m.quote |= neon_movemask(vceqq_u8(v, vdupq_n_u8('"'))) << i;
+		m.backslash |= neon_movemask(vceqq_u8(v, vdupq_n_u8('\\'))) << i;
+		m.op |= neon_movemask(op) << i;
+		m.blank |= neon_movemask(blank) << i;
+	}
+}
+
+const char *
+find_string_special_neon(const char *p, const char *end) {
+	const uint8x16_t quote = vdupq_n_u8('"');
+	const uint8x16_t backslash = vdupq_n_u8('\\');
+	const uint8x16_t control = vdupq_n_u8(0x20);
+	for (; end - p >= 16; p += 16) {
+		uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+		uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vcltq_u8(v, control));
+		uint64_t mask = neon_mask(m);
+		if (0 != mask)
+			return p + (__builtin_ctzll(mask) >> 2);
+	}
+	return find_string_special_scalar(p, end);
+}
+
+const char *
+skip_blanks_neon(const char *p, const char *end) {
+	for (; end - p >= 16; p += 16) {
+		uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+		uint8x16_t m = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+			vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))),
+				vceqq_u8(v, vdupq_n_u8('\f'))));
+		uint64_t mask = ~neon_mask(m);
+		if (0 != mask)
+			return p + (__builtin_ctzll(mask) >> 2);
+	}
+	return skip_blanks_scalar(p, end);
+}
+
+const char *
+find_invalid_encoding_neon(const char *p, const char *end) {
+	while (end - p >= 16) {
+		uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+		if (vmaxvq_u8(v) < 0x80) {
+			p += 16;
+			continue;
+		}
+		p += __builtin_ctzll(neon_mask(vcgeq_u8(v, vdupq_n_u8(0x80)))) >> 2;
+		size_t n = utf8_sequence(p, end);
+		if (0 == n)
+			return p;
+		p += n;
+	}
+	return find_invalid_encoding_scalar(p, end);
+}
+
+#endif
+
+//! \brief A set of kernels.
+struct kernels_t {
+	isa_t isa;
+	const char *(*find_string_special)(const char *, const char *);
+	const char *(*skip_blanks)(const char *, const char *);
+	const char *(*find_invalid_encoding)(const char *, const char *);
+	void (*classify)(const char *, block_masks_t&);
+};
+
+// the sets are constant-initialised, so they may be used before the dynamic initialisation of any translation unit
+const kernels_t scalar_kernels = {SCALAR, &find_string_special_scalar, &skip_blanks_scalar, &find_invalid_encoding_scalar, &classify_scalar};
+#ifdef JSON_SIMD_X86
+const kernels_t sse2_kernels = {SSE2, &find_string_special_sse2, &skip_blanks_sse2, &find_invalid_encoding_sse2, &classify_sse2};
+const kernels_t avx2_kernels = {AVX2, &find_string_special_avx2, &skip_blanks_avx2, &find_invalid_encoding_avx2, &classify_avx2};
+#endif
+#ifdef JSON_SIMD_NEON
+const kernels_t neon_kernels = {NEON, &find_string_special_neon, &skip_blanks_neon, &find_invalid_encoding_neon, &classify_neon};
+#endif
+
+//! \brief The best set that the processor supports and that is not better than isa.
+const kernels_t *
+kernels(isa_t isa) {
+#ifdef JSON_SIMD_X86
+	__builtin_cpu_init();
+	if (AVX2 == isa && __builtin_cpu_supports("avx2"))
+		return &avx2_kernels;
+	if ((AVX2 == isa || SSE2 == isa) && __builtin_cpu_supports("sse2"))
+		return &sse2_kernels;
+#endif
+#ifdef JSON_SIMD_NEON
+	if (SCALAR != isa)
+		return &neon_kernels;
+#endif
+	return &scalar_kernels;
+}
+
+//! \brief The set that is used, 0 until the first use or select. It is read and written atomically.
+const kernels_t *current = 0;
+
+//! \brief The set that is used. The first use picks the best one, unless select was called before.
+inline const kernels_t&
+used() {
+	const kernels_t *k = __atomic_load_n(&current, __ATOMIC_ACQUIRE);
+	if (0 == k) {
+		const kernels_t *expected = 0;
+		k = kernels(AVX2);
+		// if another thread got there first, its choice stands
+		if (!__atomic_compare_exchange_n(&current, &expected, k, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			k = expected;
+	}
+	return *k;
+}
+
+}
+
+const char *
+find_string_special(const char *p, const char *end) {
+	return (*used().find_string_special)(p, end);
+}
+
+const char *
+skip_blanks(const char *p, const char *end) {
+	return (*used().skip_blanks)(p, end);
+}
+
+const char *
+find_invalid_encoding(const char *p, const char *end) {
+	return (*used().find_invalid_encoding)(p, end);
+}
+
+void
+classify(const char *p, block_masks_t& m) {
+	(*used().classify)(p, m);
+}
+
+isa_t
+select(isa_t isa) {
+	const kernels_t *k = kernels(isa);
+	__atomic_store_n(&current, k, __ATOMIC_RELEASE);
+	return k->isa;
+}
+
+isa_t
+active() {
+	return used().isa;
+}
+
+}
+
+}
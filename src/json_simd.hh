@@ -0,0 +1,146 @@
+#ifndef __JSON_SIMD_HH__
+#define __JSON_SIMD_HH__
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace json {
+
+/**
+ * \brief Vectorised kernels that let the scanner jump over runs of characters that do not change the
+ * state of the DFA: the bodies of strings and the blanks between tokens. There is one more for the
+ * validation of the encoding.
+ *
+ * The kernels are defined for char only. The best instruction set supported by the processor
+ * (AVX2, SSE2 or NEON) is chosen at run time, the scalar kernels are the fallback. The generic
+ * templates are the scalar kernels for the other character types.
+ */
+namespace simd {
+
+//! \brief The instruction sets for which kernels are available.
+typedef enum {SCALAR, SSE2, AVX2, NEON} isa_t;
+
+/**
+ * \brief Returns the first character in [p, end) that ends the plain part of a string body, i.e. a
+ * quote, a backslash or a control character (below 0x20).
+ *
+ * \param p The first character to examine.
+ * \param end One past the last character to examine.
+ * \return The position of the first such character or end if there is none.
+ */
+const char *find_string_special(const char *, const char *);
+/**
+ * \brief Returns the first character in [p, end) that is not a blank (space, tab, line feed,
+ * carriage return, form feed).
+ *
+ * \param p The first character to examine.
+ * \param end One past the last character to examine.
+ * \return The position of the first non-blank character or end if there is none.
+ */
+const char *skip_blanks(const char *, const char *);
+/**
+ * \brief Returns the start of the first sequence in [p, end) that is not well-formed UTF-8, i.e. an invalid
+ * byte, a truncated sequence, an overlong form, a surrogate, or a code point beyond U+10FFFF. The runs of
+ * ASCII characters are jumped over by the vector units.
+ *
+ * \param p The first character to examine.
+ * \param end One past the last character to examine.
+ * \return The position of the first invalid sequence or end if there is none.
+ */
+const char *find_invalid_encoding(const char *, const char *);
+
+/**
+ * \brief The character classes of a block of 64 characters, one bit per character. Bit i corresponds
+ * to the i-th character of the block.
+ */
+struct block_masks_t {
+	//! \brief Quotes.
+	uint64_t quote;
+	//! \brief Backslashes.
+	uint64_t backslash;
+	//! \brief The punctuation characters {}[]:,
+	uint64_t op;
+	//! \brief Blanks.
+	uint64_t blank;
+};
+
+/**
+ * \brief Computes the character classes of the 64 characters starting at p.
+ *
+ * \param p The first of the 64 characters.
+ * \param m The masks that are filled in.
+ */
+void classify(const char *, block_masks_t&);
+
+/**
+ * \brief Selects the kernels to be used. If the processor does not support the requested instruction
+ * set, the best supported one that is not better than the requested one is selected. Until it is called,
+ * the best supported set is used, chosen on the first use of a kernel. It must not be called while
+ * documents are parsed, e.g. by the threads of json::parallel_parser: it is meant for the start of a
+ * program or for tests.
+ *
+ * \param isa The requested instruction set.
+ * \return The instruction set that is actually used.
+ */
+isa_t select(isa_t);
+//! \brief Returns the instruction set of the kernels that are currently used.
+isa_t active();
+
+//! \brief The scalar kernel for characters other than char. \sa find_string_special(const char *, const char *)
+template<typename Char>
+inline const Char *
+find_string_special(const Char *p, const Char *end) {
+	for (; p != end; ++p)
+		if (*p == static_cast<Char>('"') || *p == static_cast<Char>('\\') || static_cast<unsigned long>(*p) < 0x20)
+			return p;
+	return end;
+}
+
+/**
+ * \brief The scalar kernel for characters other than char: 16-bit characters hold UTF-16, e.g. char16_t or
+ * wchar_t on Windows, and wider ones hold code points, e.g. char32_t or wchar_t elsewhere. Unpaired surrogates
+ * and code points beyond U+10FFFF are invalid. \sa find_invalid_encoding(const char *, const char *)
+ */
+template<typename Char>
+inline const Char *
+find_invalid_encoding(const Char *p, const Char *end) {
+	for (; p != end; ++p) {
+		unsigned long c = static_cast<unsigned long>(*p);
+		if (sizeof(Char) > 2 && c > 0x10ffff)
+			return p;
+		if (c < 0xd800 || c > 0xdfff)
+			continue;
+		// a high surrogate followed by a low one is a pair in UTF-16, any other surrogate is invalid
+		if (sizeof(Char) != 2 || c > 0xdbff || end - p < 2)
+			return p;
+		unsigned long low = static_cast<unsigned long>(p[1]);
+		if (low < 0xdc00 || low > 0xdfff)
+			return p;
+		++p;
+	}
+	return end;
+}
+
+//! \brief The scalar kernel for characters other than char. \sa skip_blanks(const char *, const char *)
+template<typename Char>
+inline const Char *
+skip_blanks(const Char *p, const Char *end) {
+	for (; p != end; ++p)
+		switch (*p) {
+		case static_cast<Char>(' '):
+		case static_cast<Char>('\t'):
+		case static_cast<Char>('\n'):
+		case static_cast<Char>('\r'):
+		case static_cast<Char>('\f'):
+			break;
+		default:
+			return p;
+		}
+	return end;
+}
+
+}
+
+}
+
+#endif
@@ -0,0 +1,144 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+#include "json_snapshot.hh"
+
+namespace json {
+
+namespace {
+
+const char MAGIC[8] = {'J', 'S', 'O', 'N', 'T', 'A', 'P', 'E'};
+const uint32_t ORDER_MARK = 0x01020304;
+
+//! \brief Writes n bytes to f. \exception std::runtime_error on failure.
+void
+put(std::FILE *f, const void *p, size_t n, const std::string& path) {
+	if (0 != n && std::fwrite(p, 1, n, f) != n) {
+		int e = errno;
+		std::fclose(f);
+		std::remove(path.c_str());
+		throw std::runtime_error(path + ": " + strerror(e));
+	}
+}
+
+}
+
+uint64_t
+tape_snapshot::hash(const char *p, size_t n) {
+	// FNV-1a on 64-bit words, with a shift that folds the high bits of the product back into the low ones
+	const uint64_t prime = (static_cast<uint64_t>(0x100) << 32) | 0x1b3;
+	uint64_t h = ((static_cast<uint64_t>(0xcbf29ce4) << 32) | 0x84222325) ^ n;
+	for (; n >= sizeof(uint64_t); p += sizeof(uint64_t), n -= sizeof(uint64_t)) {
+		uint64_t w;
+		memcpy(&w, p, sizeof(w));
+		h = (h ^ w) * prime;
+		h ^= h >> 29;
+	}
+	for (; 0 != n; ++p, --n)
+		h = (h ^ static_cast<unsigned char>(*p)) * prime;
+	return h ^ (h >> 32);
+}
+
+void
+tape_snapshot::save(const json::tape& t, uint64_t hash, uint64_t size, const char *path) {
+	header_t h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, MAGIC, sizeof(h.magic));
+	h.version = VERSION;
+	h.byte_order = ORDER_MARK;
+	h.source_hash = hash;
+	h.source_size = size;
+	h.entries = t.size();
+	h.strings = t.strings().size();
+
+	std::string tmp = std::string(path) + ".tmp";
+	std::FILE *f = std::fopen(tmp.c_str(), "wb");
+	if (0 == f)
+		throw std::runtime_error(tmp + ": " + strerror(errno));
+	put(f, &h, sizeof(h), tmp);
+	put(f, t.data(), t.size() * sizeof(uint64_t), tmp);
+	put(f, t.strings().data(), t.strings().size(), tmp);
+	if (0 != std::fclose(f)) {
+		int e = errno;
+		std::remove(tmp.c_str());
+		throw std::runtime_error(tmp + ": " + strerror(e));
+	}
+	if (0 != std::rename(tmp.c_str(), path)) {
+		int e = errno;
+		std::remove(tmp.c_str());
+		throw std::runtime_error(std::string(path) + ": " + strerror(e));
+	}
+}
+
+bool
+tape_snapshot::open(const char *path) {
+	close();
+	try {
+		file.open(path);
+	} catch (const std::runtime_error&) {
+		// e.g. no snapshot was saved yet
+		return false;
+	}
+	header_t h;
+	if (file.size() < sizeof(h)) {
+		close();
+		return false;
+	}
+	memcpy(&h, file.data(), sizeof(h));
+	size_t room = file.size() - sizeof(h);
+	if (0 != memcmp(h.magic, MAGIC, sizeof(MAGIC)) || VERSION != h.version || ORDER_MARK != h.byte_order
+			|| 0 == h.entries || h.entries > room / sizeof(uint64_t) || h.strings != room - h.entries * sizeof(uint64_t)) {
+		close();
+		return false;
+	}
+	e = reinterpret_cast<const uint64_t *>(file.data() + sizeof(h));
+	s = file.data() + sizeof(h) + h.entries * sizeof(uint64_t);
+	count = static_cast<size_t>(h.entries);
+	hash_ = h.source_hash;
+	size_ = h.source_size;
+	// the root is a container that spans the whole tape
+	json::tape_cursor r = root();
+	if (!r.is_container() || r.end().index() != count - 1) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+bool
+tape_snapshot::open(const char *path, const char *p, size_t n) {
+	if (!open(path))
+		return false;
+	if (size_ != n || hash_ != hash(p, n)) {
+		close();
+		return false;
+	}
+	return true;
+}
+
+void
+tape_snapshot::close() {
+	file.close();
+	e = 0;
+	s = 0;
+	count = 0;
+	hash_ = 0;
+	size_ = 0;
+}
+
+void
+tape_snapshot::write(json::writer& w) const {
+	if (is_open())
+		root().write(w);
+}
+
+std::ostream&
+tape_snapshot::print(std::ostream& os) const {
+	json::writer w(json::writer::SPACED);
+	write(w);
+	return os << w.str();
+}
+
+}
@@ -0,0 +1,140 @@
+#ifndef __JSON_SNAPSHOT_HH__
+#define __JSON_SNAPSHOT_HH__
+
+#include <cstddef>
+#include <iostream>
+#include <stdint.h>
+#include "json_tape.hh"
+#include "json_mmap.hh"
+
+namespace json {
+
+/**
+ * \brief A json::tape saved to a file, mapped back read-only. The tape holds indices and offsets only, no
+ * pointer, so the file is the tape itself: a header, the entries, and the string buffer. Opening a snapshot maps
+ * the file and checks the header, nothing is decoded or copied, and only the pages that are read are loaded.
+ * Hence a large document that is read at every start, e.g. a configuration or reference data, is parsed once.
+ *
+ * The header records the hash and the size of the source text, so a snapshot that was saved from another version
+ * of the source is detected as stale. The entries are in the byte order of the host that wrote them, a snapshot
+ * written by a host of the other byte order is rejected like a stale one.
+ *
+ * \code
+ * json::tape_snapshot s;
+ * if (!s.open("config.tape", text, len)) {
+ * 	json::tape t;
+ * 	json::parser<char, json::tape_builder> p((json::tape_builder(t)));
+ * 	if (p.OK == p.parse(text, len))
+ * 		json::tape_snapshot::save(t, json::tape_snapshot::hash(text, len), len, "config.tape");
+ * }
+ * \endcode
+ */
+class tape_snapshot {
+public:
+	//! \brief The version of the format, increased whenever the layout of the tape or of the header changes.
+	static const uint32_t VERSION = 1;
+
+	//! \brief Nothing is open.
+	tape_snapshot() : e(0), s(0), count(0), hash_(0), size_(0) {}
+	/**
+	 * \brief The hash of a source text that is recorded in its snapshot. It reads 8 bytes per step, so it is
+	 * much faster than parsing the text. It is not a cryptographic hash.
+	 *
+	 * \param p The first character of the text.
+	 * \param n The number of characters of the text.
+	 * \return The hash.
+	 */
+	static uint64_t hash(const char *, size_t);
+	/**
+	 * \brief Saves a tape to a file. The file is written under a temporary name and renamed, so a snapshot that
+	 * is being written is never opened in part.
+	 *
+	 * \param t The tape. It must not be empty.
+	 * \param hash The hash of the source text of the tape. \sa hash
+	 * \param size The number of characters of the source text.
+	 * \param path The path of the file.
+	 * \exception std::runtime_error if the file cannot be written.
+	 */
+	static void save(const json::tape&, uint64_t, uint64_t, const char *);
+	/**
+	 * \brief Maps a snapshot. The previous one, if any, is released first.
+	 *
+	 * \param path The path of the file.
+	 * \return false if the file cannot be mapped, e.g. if it does not exist, or if it is not a snapshot of this
+	 * version and byte order. Nothing is open then.
+	 */
+	bool open(const char *);
+	/**
+	 * \brief Maps a snapshot of the given source text. \sa open(const char *)
+	 *
+	 * \param path The path of the file.
+	 * \param p The first character of the source text.
+	 * \param n The number of characters of the source text.
+	 * \return false if the file cannot be mapped, if it is not a snapshot, or if it is stale, i.e. it was saved
+	 * from another text.
+	 */
+	bool open(const char *, const char *, size_t);
+	//! \brief Unmaps the snapshot, if any.
+	void close();
+	//! \brief true if a snapshot is open.
+	bool is_open() const { return 0 != e; }
+	//! \brief The hash of the source text, as given to \link json::tape_snapshot::save save\endlink.
+	uint64_t source_hash() const { return hash_; }
+	//! \brief The number of characters of the source text.
+	uint64_t source_size() const { return size_; }
+	//! \brief The number of entries of the tape.
+	size_t size() const { return count; }
+	//! \brief A cursor on the root of the document. A snapshot must be open.
+	json::tape_cursor root() const { return json::tape_cursor(e, s, 0); }
+	/**
+	 * \brief Writes the document to a writer. Nothing is written if no snapshot is open.
+	 *
+	 * \param w The writer the document is written to.
+	 */
+	void write(json::writer&) const;
+	/**
+	 * \brief Prints the document to the output stream, in the format of json::tape::print.
+	 *
+	 * \param os The output stream the document is printed to.
+	 * \return The output stream the document is printed to.
+	 */
+	std::ostream& print(std::ostream&) const;
+private:
+	//! \brief The header of the file. The entries follow it, then the string buffer.
+	struct header_t {
+		//! \brief "JSONTAPE".
+		char magic[8];
+		//! \brief VERSION.
+		uint32_t version;
+		//! \brief 0x01020304 in the byte order of the host that wrote the file.
+		uint32_t byte_order;
+		//! \brief The hash of the source text.
+		uint64_t source_hash;
+		//! \brief The number of characters of the source text.
+		uint64_t source_size;
+		//! \brief The number of entries.
+		uint64_t entries;
+		//! \brief The number of bytes of the string buffer.
+		uint64_t strings;
+	};
+
+	//! \brief The mapping.
+	json::mapped_file file;
+	//! \brief The entries, in the mapping.
+	const uint64_t *e;
+	//! \brief The string buffer, in the mapping.
+	const char *s;
+	//! \brief The number of entries.
+	size_t count;
+	//! \brief The hash of the source text.
+	uint64_t hash_;
+	//! \brief The number of characters of the source text.
+	uint64_t size_;
+
+	tape_snapshot(const tape_snapshot&);
+	tape_snapshot& operator=(const tape_snapshot&);
+};
+
+}
+
+#endif
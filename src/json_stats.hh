@@ -0,0 +1,59 @@
+#ifndef __JSON_STATS_HH__
+#define __JSON_STATS_HH__
+
+#include <cstring>
+#include <stdint.h>
+
+/**
+ * \brief Adds n to a counter of json::stats if the counters are compiled in, i.e. if JSON_STATS is defined.
+ * Otherwise it expands to nothing, its arguments are not even compiled, so the counters cost nothing.
+ */
+#ifdef JSON_STATS
+#define JSON_STATS_ADD(counter, n) ((counter) += (n))
+#else
+#define JSON_STATS_ADD(counter, n) ((void)0)
+#endif
+
+namespace json {
+
+/**
+ * \brief A snapshot of the counters of a parser and its scanner, see json::parser::stats. The counters are
+ * compiled in only if JSON_STATS is defined, e.g. with CXXFLAGS=-DJSON_STATS; otherwise they are all 0.
+ */
+struct stats {
+	//! \brief true if the counters are compiled in.
+	static const bool enabled =
+#ifdef JSON_STATS
+		true;
+#else
+		false;
+#endif
+	//! \brief The size of \link json::stats::tokens tokens\endlink, larger than any token.
+	static const unsigned int TOKEN_KINDS = 32;
+
+	//! \brief The number of characters given to feed or parse.
+	uint64_t bytes;
+	//! \brief The number of chunks given to feed, including the empty ones.
+	uint64_t chunks;
+	//! \brief The number of chunks after which the parser returned PENDING, i.e. that the next one resumes.
+	uint64_t resumptions;
+	//! \brief The number of tokens of each kind, indexed by json::scanner::token_t.
+	uint64_t tokens[TOKEN_KINDS];
+	//! \brief The number of characters read before the current chunk that were given back to the lookahead buffer.
+	uint64_t unget_bytes;
+	//! \brief The number of characters copied to the token buffer, for tokens that span chunks.
+	uint64_t copied_bytes;
+	//! \brief The number of characters by which the token buffers grew.
+	uint64_t allocated_bytes;
+	//! \brief The largest number of states on the stack of the automaton.
+	uint64_t max_depth;
+
+	//! \brief All counters are 0.
+	stats() { clear(); }
+	//! \brief Sets all counters to 0.
+	void clear() { memset(this, 0, sizeof(*this)); }
+};
+
+}
+
+#endif
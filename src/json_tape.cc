@@ -0,0 +1,164 @@
+#include <iostream>
+#include <cstring>
+#include "json_tape.hh"
+
+namespace json {
+
+std::ostream&
+tape::print(std::ostream& os) const {
+	json::writer w(json::writer::SPACED);
+	write(w);
+	return os << w.str();
+}
+
+void
+tape::write(json::writer& w) const {
+	if (!entries.empty())
+		root().write(w);
+}
+
+void
+tape_cursor::write(json::writer& w) const {
+	switch (tag()) {
+	case tape::OBJECT_START:
+	case tape::ARRAY_START: {
+		bool obj = tape::OBJECT_START == tag();
+		if (obj)
+			w.obj_start();
+		else
+			w.array_start();
+		for (tape_cursor c = first(); !c.at_end(); c = c.next()) {
+			if (obj) {
+				json::string_ref<char> k = c.string();
+				w.key(k.data(), k.size());
+				c = c.next();
+			}
+			c.write(w);
+		}
+		if (obj)
+			w.obj_end();
+		else
+			w.array_end();
+		break;
+	}
+	case tape::STRING: {
+		json::string_ref<char> v = string();
+		w.string(v.data(), v.size());
+		break;
+	}
+	case tape::INT64:
+		w.integer(integer());
+		break;
+	case tape::DOUBLE:
+		w.number(number());
+		break;
+	case tape::TRUE_VALUE:
+	case tape::FALSE_VALUE:
+		w.boolean(boolean());
+		break;
+	default:
+		w.null();
+		break;
+	}
+}
+
+size_t
+tape_cursor::size() const {
+	size_t n = static_cast<size_t>(payload() >> 32);
+	if (n < json::tape::MAX_COUNT)
+		return n;
+	// the count is saturated, count the children one by one
+	n = 0;
+	for (tape_cursor c = first(); !c.at_end(); c = c.next())
+		++n;
+	return json::tape::OBJECT_START == tag() ? n / 2 : n;
+}
+
+tape_cursor
+tape_cursor::find(const char *k, size_t len) const {
+	tape_cursor c = first();
+	for (; !c.at_end(); c = c.next().next()) {
+		json::string_ref<char> s = c.string();
+		if (s.size() == len && 0 == memcmp(s.data(), k, len))
+			return c.next();
+	}
+	return c;
+}
+
+void
+tape_builder::start(json::tape::tag_t tag) {
+	if (open.empty())
+		t->clear();
+	else if (json::tape::ARRAY_START == (t->entries[open.back().start] >> 56))
+		++open.back().count;
+	frame_t f;
+	f.start = t->entries.size();
+	f.count = 0;
+	open.push_back(f);
+	t->entries.push_back(json::tape::entry(tag, 0));
+}
+
+void
+tape_builder::end(json::tape::tag_t tag) {
+	const frame_t& f = open.back();
+	uint64_t count = f.count < json::tape::MAX_COUNT ? f.count : json::tape::MAX_COUNT;
+	uint64_t last = t->entries.size();
+	t->entries[f.start] |= (count << 32) | last;
+	t->entries.push_back(json::tape::entry(tag, f.start));
+	open.pop_back();
+}
+
+void
+tape_builder::string(const json::string_ref<char>& s) {
+	const char *p = s.data();
+	uint32_t n = static_cast<uint32_t>(s.size());
+	if (s.escaped()) {
+		s.decode(scratch);
+		p = scratch.data();
+		n = static_cast<uint32_t>(scratch.size());
+	}
+	t->entries.push_back(json::tape::entry(json::tape::STRING, t->strings_.size()));
+	t->strings_.append(reinterpret_cast<const char *>(&n), sizeof(n));
+	t->strings_.append(p, n);
+	t->strings_.push_back('\0');
+}
+
+void
+tape_builder::leaf(const json::string_ref<char>& d, int term) {
+	switch (term) {
+	case json::scanner<char>::STRING:
+		string(d);
+		break;
+	case json::scanner<char>::INTEGER:
+	case json::scanner<char>::DOUBLE: {
+		int64_t i;
+		double v;
+		if (json::parse_number(d.data(), d.size(), json::scanner<char>::INTEGER == term, i, v)) {
+			t->entries.push_back(json::tape::entry(json::tape::INT64, 0));
+			t->entries.push_back(static_cast<uint64_t>(i));
+		} else {
+			uint64_t bits;
+			memcpy(&bits, &v, sizeof(bits));
+			t->entries.push_back(json::tape::entry(json::tape::DOUBLE, 0));
+			t->entries.push_back(bits);
+		}
+		break;
+	}
+	case json::scanner<char>::TRUE_CONST:
+		t->entries.push_back(json::tape::entry(json::tape::TRUE_VALUE, 0));
+		break;
+	case json::scanner<char>::FALSE_CONST:
+		t->entries.push_back(json::tape::entry(json::tape::FALSE_VALUE, 0));
+		break;
+	default:
+		t->entries.push_back(json::tape::entry(json::tape::NULL_VALUE, 0));
+		break;
+	}
+}
+
+}
+
+std::ostream&
+operator<<(std::ostream& os, const json::tape& t) {
+	return t.print(os);
+}
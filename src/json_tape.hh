@@ -0,0 +1,269 @@
+#ifndef __JSON_TAPE_HH__
+#define __JSON_TAPE_HH__
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <cstring>
+#include <stdint.h>
+#include "json_handler.hh"
+#include "json_writer.hh"
+#include "json_resource.hh"
+
+namespace json {
+
+class tape_cursor;
+
+/**
+ * \brief A document recorded as one contiguous array of tagged 64-bit entries, the tape, plus one buffer for
+ * the strings. The values follow each other on the tape in document order:
+ * - an object is a OBJECT_START entry, the keys and the values of its members in turn, and a OBJECT_END entry;
+ * - an array is a ARRAY_START entry, its elements, and a ARRAY_END entry;
+ * - a string or a key is an entry holding the offset of the string in the string buffer;
+ * - an integer or a double is an entry followed by one entry holding the bits of the number;
+ * - true, false, and null are one entry each.
+ *
+ * The tag lies in the 8 upper bits of an entry, the payload in the 56 other ones. The start entry of a container
+ * holds the index of its end entry in the 32 lower bits of the payload and the number of its children (members
+ * for an object) in the 24 upper bits, saturated. Hence a subtree is skipped in constant time. The end entry
+ * of a container holds the index of its start entry. In the string buffer, every string is preceded by its
+ * length, in 32 bits, and followed by a null character.
+ *
+ * A tape is filled by json::tape_builder and read by a json::tape_cursor. Its two buffers are allocated from the
+ * json::memory_resource given to its constructor.
+ */
+class tape {
+public:
+	//! \brief The tags of the entries.
+	typedef enum {
+		OBJECT_START = '{', OBJECT_END = '}', ARRAY_START = '[', ARRAY_END = ']', STRING = '"',
+		INT64 = 'l', DOUBLE = 'd', TRUE_VALUE = 't', FALSE_VALUE = 'f', NULL_VALUE = 'n'
+	} tag_t;
+	//! \brief The largest number of children recorded in the start entry of a container.
+	static const uint32_t MAX_COUNT = 0xffffff;
+	//! \brief The type of the string buffer.
+	typedef std::basic_string<char, std::char_traits<char>, json::allocator<char> > strings_t;
+
+	/**
+	 * \brief The constructor of an empty tape.
+	 *
+	 * \param r The resource the buffers are allocated from, 0 for json::new_delete_resource.
+	 */
+	explicit tape(json::memory_resource *r = 0) : entries(json::allocator<uint64_t>(r)), strings_(json::allocator<char>(r)) {}
+
+	//! \brief Discards the document. The capacity is kept.
+	void clear() { entries.clear(); strings_.clear(); }
+	//! \brief true if no document is recorded.
+	bool empty() const { return entries.empty(); }
+	//! \brief The number of entries.
+	size_t size() const { return entries.size(); }
+	//! \brief The entries.
+	const uint64_t *data() const { return entries.empty() ? 0 : &entries[0]; }
+	//! \brief The string buffer.
+	const strings_t& strings() const { return strings_; }
+	//! \brief A cursor on the root of the document. The tape must not be empty.
+	inline tape_cursor root() const;
+	/**
+	 * \brief Prints the document to the output stream, in the format of json::root_node.
+	 *
+	 * \param os The output stream the document is printed to.
+	 * \return The output stream the document is printed to.
+	 */
+	std::ostream& print(std::ostream&) const;
+	/**
+	 * \brief Writes the document to a writer. Nothing is written if the tape is empty.
+	 *
+	 * \param w The writer the document is written to.
+	 */
+	void write(json::writer&) const;
+private:
+	friend class tape_builder;
+
+	//! \brief Builds an entry.
+	static uint64_t entry(tag_t tag, uint64_t payload) { return (static_cast<uint64_t>(tag) << 56) | payload; }
+
+	//! \brief The tape.
+	std::vector<uint64_t, json::allocator<uint64_t> > entries;
+	//! \brief The string buffer.
+	strings_t strings_;
+};
+
+/**
+ * \brief A read-only position on a json::tape, i.e. the first entry of a value, or the end entry of a container
+ * when the children of the container are exhausted. A cursor is three words and is passed by value. It reads the
+ * entries and the string buffer only, wherever they lie, so it reads a json::tape_snapshot as well as a json::tape.
+ *
+ * \code
+ * // the members of an object: the keys and the values alternate
+ * for (json::tape_cursor k = c.first(); !k.at_end(); k = k.next().next())
+ * 	use(k.string(), k.next());
+ * \endcode
+ */
+class tape_cursor {
+public:
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param tp The tape.
+	 * \param idx The index of the entry.
+	 */
+	tape_cursor(const json::tape& tp, size_t idx) : e(tp.data()), s(tp.strings().data()), i(idx) {}
+	/**
+	 * \brief The constructor of a cursor on entries and strings laid out like those of a json::tape.
+	 *
+	 * \param entries The entries.
+	 * \param strings The string buffer.
+	 * \param idx The index of the entry.
+	 */
+	tape_cursor(const uint64_t *entries, const char *strings, size_t idx) : e(entries), s(strings), i(idx) {}
+	//! \brief The tag of the entry.
+	json::tape::tag_t tag() const { return static_cast<json::tape::tag_t>(e[i] >> 56); }
+	//! \brief The index of the entry.
+	size_t index() const { return i; }
+	//! \brief true if the cursor is on the end entry of a container.
+	bool at_end() const { return json::tape::OBJECT_END == tag() || json::tape::ARRAY_END == tag(); }
+	//! \brief true if the value is an object or an array.
+	bool is_container() const { return json::tape::OBJECT_START == tag() || json::tape::ARRAY_START == tag(); }
+	//! \brief true if the value is an integer or a double.
+	bool is_number() const { return json::tape::INT64 == tag() || json::tape::DOUBLE == tag(); }
+	//! \brief The cursor of the value that follows this one. Subtrees are skipped in constant time.
+	tape_cursor next() const {
+		if (is_container())
+			return tape_cursor(e, s, static_cast<uint32_t>(payload()) + 1);
+		return tape_cursor(e, s, is_number() ? i + 2 : i + 1);
+	}
+	//! \brief The cursor of the first child of a container. It is at_end if the container is empty.
+	tape_cursor first() const { return tape_cursor(e, s, i + 1); }
+	//! \brief The cursor of the end entry of a container.
+	tape_cursor end() const { return tape_cursor(e, s, static_cast<uint32_t>(payload())); }
+	//! \brief The number of children of an array, the number of members of an object.
+	size_t size() const;
+	/**
+	 * \brief Looks a key up in an object. The members are searched linearly but their values are skipped in
+	 * constant time, so one entry is read per member and no string is compared unless the lengths match.
+	 * 
+	 * \param k The first character of the key.
+	 * \param len The number of characters of the key.
+	 * \return The cursor of the value of the first member with the key, the end of the object if there is none.
+	 */
+	tape_cursor find(const char *, size_t) const;
+	//! \brief The boolean constant of a TRUE_VALUE or FALSE_VALUE entry.
+	bool boolean() const { return json::tape::TRUE_VALUE == tag(); }
+	//! \brief The value of an INT64 entry.
+	int64_t integer() const { return static_cast<int64_t>(e[i + 1]); }
+	//! \brief The value of an INT64 or DOUBLE entry, as a double.
+	inline double number() const;
+	//! \brief The decoded characters of a STRING entry. They are followed by a null character.
+	json::string_ref<char> string() const {
+		const char *p = s + payload();
+		uint32_t n;
+		memcpy(&n, p, sizeof(n));
+		return json::string_ref<char>(p + sizeof(n), n);
+	}
+	/**
+	 * \brief Writes the value and its descendants to a writer.
+	 *
+	 * \param w The writer the value is written to.
+	 */
+	void write(json::writer&) const;
+private:
+	//! \brief The payload of the entry.
+	uint64_t payload() const { return e[i] & ((static_cast<uint64_t>(1) << 56) - 1); }
+
+	//! \brief The entries.
+	const uint64_t *e;
+	//! \brief The string buffer.
+	const char *s;
+	//! \brief The index of the entry.
+	size_t i;
+};
+
+inline tape_cursor
+tape::root() const {
+	return tape_cursor(*this, 0);
+}
+
+inline double
+tape_cursor::number() const {
+	uint64_t bits = e[i + 1];
+	if (json::tape::INT64 == tag())
+		return static_cast<double>(static_cast<int64_t>(bits));
+	double d;
+	memcpy(&d, &bits, sizeof(d));
+	return d;
+}
+
+/**
+ * \brief The parser handler that records a document on a json::tape. The tape is cleared when a document starts,
+ * so one tape, and its capacity, may be reused across documents. After the parser returned ERROR, the document
+ * that was left unfinished is dropped when the parser is \link json::parser::reset reset\endlink.
+ *
+ * \code
+ * json::tape t;
+ * json::parser<char, json::tape_builder> p((json::tape_builder(t)));
+ * p.parse(buf, len);
+ * t.print(std::cout);
+ * \endcode
+ */
+class tape_builder : public json::handler<char> {
+public:
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param tp The tape the documents are recorded on.
+	 */
+	explicit tape_builder(json::tape& tp) : t(&tp) {}
+
+	//! \brief Records a OBJECT_START entry. \sa handler::obj_start
+	void obj_start() { start(json::tape::OBJECT_START); }
+	//! \brief Records a key. \sa handler::key
+	void key(const json::string_ref<char>& k) { ++open.back().count; string(k); }
+	//! \brief Records a leaf. \sa handler::obj_data
+	void obj_data(const json::string_ref<char>& d, int term) { leaf(d, term); }
+	//! \brief Records a OBJECT_END entry. \sa handler::obj_end
+	void obj_end() { end(json::tape::OBJECT_END); }
+	//! \brief Records a ARRAY_START entry. \sa handler::array_start
+	void array_start() { start(json::tape::ARRAY_START); }
+	//! \brief Records a leaf. \sa handler::array_data
+	void array_data(const json::string_ref<char>& d, int term) { ++open.back().count; leaf(d, term); }
+	//! \brief Records a ARRAY_END entry. \sa handler::array_end
+	void array_end() { end(json::tape::ARRAY_END); }
+	//! \brief Drops the containers that are not closed and clears the tape. \sa handler::reset
+	void reset() { open.clear(); t->clear(); }
+private:
+	//! \brief A container that is not closed yet.
+	struct frame_t {
+		//! \brief The index of its start entry.
+		size_t start;
+		//! \brief The number of its children so far.
+		size_t count;
+	};
+	//! \brief Records the start entry of a container. Its payload is set by \link json::tape_builder::end end\endlink.
+	void start(json::tape::tag_t);
+	//! \brief Records the end entry of the current container and completes its start entry.
+	void end(json::tape::tag_t);
+	//! \brief Records a string, a number, a boolean or null.
+	void leaf(const json::string_ref<char>&, int);
+	//! \brief Records a STRING entry and appends the decoded string to the string buffer.
+	void string(const json::string_ref<char>&);
+
+	//! \brief The tape.
+	json::tape *t;
+	//! \brief The containers on the path from the root to the current value.
+	std::vector<frame_t> open;
+	//! \brief The buffer in which escaped strings are decoded.
+	std::string scratch;
+};
+
+}
+
+/**
+ * \brief Operator printing the document recorded on the tape t to the output stream os
+ *
+ * \param os The output stream the document is printed to
+ * \param t The tape.
+ * \return The output stream the document is printed to
+ */
+extern std::ostream& operator<<(std::ostream&, const json::tape&);
+
+#endif
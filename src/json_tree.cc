@@ -2,7 +2,7 @@
 #include <cassert>
 #include <vector>
 #include <stack>
-#include <cstdlib>
+#include <algorithm>
 #include <cstring>
 #include "json_tree.hh"
 #include "json_parser.hh"
@@ -26,69 +26,281 @@ obj_list_node::~obj_list_node() {
 			delete *i;
 }
 
+namespace {
+
+//! \brief Orders the key:value pairs by key.
+bool
+name_less(const obj_node *a, const obj_node *b) {
+	return a->name() < b->name();
+}
+
+//! \brief Compares the key of a key:value pair with a key.
+bool
+name_less_key(const obj_node *a, const std::string& k) {
+	return a->name() < k;
+}
+
+}
+
+void
+obj_list_node::index_keys() const {
+	if (v.size() < INDEX_THRESHOLD || index.size() == v.size())
+		return;
+	index = v;
+	std::stable_sort(index.begin(), index.end(), name_less);
+}
+
+const obj_node *
+obj_list_node::find(const std::string& k) const {
+	if (v.size() < INDEX_THRESHOLD) {
+		for (std::vector<const obj_node *>::const_iterator i = v.begin(); i != v.end(); ++i)
+			if ((*i)->name() == k)
+				return *i;
+		return 0;
+	}
+	index_keys();
+	std::vector<const obj_node *>::const_iterator i = std::lower_bound(index.begin(), index.end(), k, name_less_key);
+	if (i == index.end() || (*i)->name() != k)
+		return 0;
+	return *i;
+}
+
+namespace {
+
+//! \brief Prints a node to an output stream through a writer, in the layout of json::node::print.
+template<typename T>
+std::ostream&
+print_through(std::ostream& os, const T& n) {
+	json::writer w(json::writer::SPACED);
+	n.write(w);
+	return os << w.str();
+}
+
+}
+
 std::ostream&
 string_node::print(std::ostream& os) const {
-	return os << '"' << name_ << '"';
+	return print_through(os, *this);
+}
+
+void
+string_node::write(json::writer& w) const {
+	w.string(name_.data(), name_.size());
 }
 
 std::ostream&
 number_node::print(std::ostream& os) const {
-	return os << number_;
+	return print_through(os, *this);
+}
+
+void
+number_node::write(json::writer& w) const {
+	w.number(number_);
 }
 
 std::ostream&
 bool_node::print(std::ostream& os) const {
-	return os << (flag_ ? "true" : "false");
+	return print_through(os, *this);
+}
+
+void
+bool_node::write(json::writer& w) const {
+	w.boolean(flag_);
 }
 
 std::ostream&
 root_node::print(std::ostream& os) const {
+	return print_through(os, *this);
+}
+
+void
+root_node::write(json::writer& w) const {
 	if (0 == value_)
-		return os << "null";
+		w.null();
 	else
-		return value_->print(os);
+		value_->write(w);
 }
 
 std::ostream&
 obj_node::print(std::ostream& os) const {
-	os << '"' << name_ << "\" : ";
-	return root_node::print(os);
+	return print_through(os, *this);
+}
+
+void
+obj_node::write(json::writer& w) const {
+	w.key(name_.data(), name_.size());
+	root_node::write(w);
 }
 
 std::ostream&
 array_node::print(std::ostream& os) const {
-	os << "[";
-	std::vector<const node *>::const_iterator i = v.begin();
-	if (i != v.end()) {
+	return print_through(os, *this);
+}
+
+void
+array_node::write(json::writer& w) const {
+	w.array_start();
+	for (std::vector<const node *>::const_iterator i = v.begin(); i != v.end(); ++i)
 		if (0 == *i)
-			os << "null";
+			w.null();
 		else
-			(*i)->print(os);
-		for (++i; i != v.end(); ++i) {
-			os << ", ";
-			if (0 == *i)
-				os << "null";
-			else
-				(*i)->print(os);
-		}
-	}
-	os << "]";
-	return os;
+			(*i)->write(w);
+	w.array_end();
 }
 
 std::ostream&
 obj_list_node::print(std::ostream& os) const {
-	os << "{";
-	std::vector<const obj_node *>::const_iterator i = v.begin();
-	if (i != v.end()) {
-		(*i)->print(os);
-		for (++i; i != v.end(); ++i) {
-			os << ", ";
-			(*i)->print(os);
+	return print_through(os, *this);
+}
+
+void
+obj_list_node::write(json::writer& w) const {
+	w.obj_start();
+	for (std::vector<const obj_node *>::const_iterator i = v.begin(); i != v.end(); ++i)
+		(*i)->write(w);
+	w.obj_end();
+}
+
+std::ostream&
+arena_node::print(std::ostream& os) const {
+	return print_through(os, *this);
+}
+
+void
+arena_node::write(json::writer& w) const {
+	switch (kind_) {
+	case BOOL_NODE:
+		w.boolean(u.flag);
+		break;
+	case NUMBER_NODE:
+		w.number(u.number);
+		break;
+	case STRING_NODE:
+		w.string(u.text, n);
+		break;
+	case ARRAY_NODE:
+	case OBJECT_NODE:
+		if (ARRAY_NODE == kind_)
+			w.array_start();
+		else
+			w.obj_start();
+		for (const arena_node *c = u.first; 0 != c; c = c->next_) {
+			if (OBJECT_NODE == kind_)
+				w.key(c->key_, c->key_size_);
+			c->write(w);
 		}
+		if (ARRAY_NODE == kind_)
+			w.array_end();
+		else
+			w.obj_end();
+		break;
+	default:
+		w.null();
+		break;
+	}
+}
+
+const arena_node *
+arena_node::find(const char *k, size_t len) const {
+	for (const arena_node *c = u.first; 0 != c; c = c->next_)
+		if (c->key_size_ == len && 0 == memcmp(c->key_, k, len))
+			return c;
+	return 0;
+}
+
+const arena_node *
+arena_node::find(int id) const {
+	if (json::key_table<char>::NO_KEY == id)
+		return 0;
+	for (const arena_node *c = u.first; 0 != c; c = c->next_)
+		if (c->key_id_ == id)
+			return c;
+	return 0;
+}
+
+arena_node *
+arena_builder::add(arena_node::kind_t kind) {
+	arena_node *r = static_cast<arena_node *>(a->allocate(sizeof(arena_node)));
+	r->kind_ = kind;
+	r->u.first = 0;
+	r->n = 0;
+	r->next_ = 0;
+	r->key_ = 0;
+	r->key_size_ = 0;
+	r->key_id_ = json::key_table<char>::NO_KEY;
+	if (frames.empty()) {
+		root_ = r;
+		return r;
+	}
+	frame_t& top = frames.back();
+	if (arena_node::OBJECT_NODE == top.node->kind_) {
+		r->key_ = key_;
+		r->key_size_ = key_size_;
+		r->key_id_ = key_id_;
+	}
+	if (0 == top.last)
+		top.node->u.first = r;
+	else
+		top.last->next_ = r;
+	top.last = r;
+	++top.node->n;
+	return r;
+}
+
+void
+arena_builder::start(arena_node::kind_t kind) {
+	frame_t f;
+	f.node = add(kind);
+	f.last = 0;
+	frames.push_back(f);
+}
+
+const char *
+arena_builder::copy(const json::string_ref<char>& t, size_t& n) {
+	if (!t.escaped()) {
+		n = t.size();
+		return a->copy(t.data(), n);
+	}
+	t.decode(scratch);
+	n = scratch.size();
+	return a->copy(scratch.data(), n);
+}
+
+void
+arena_builder::key(const json::string_ref<char>& t) {
+	key_id_ = 0 == keys ? json::key_table<char>::NO_KEY : keys->intern(t);
+	if (json::key_table<char>::NO_KEY == key_id_)
+		key_ = copy(t, key_size_);
+	else {
+		const std::string& k = keys->name(key_id_);
+		key_ = k.data();
+		key_size_ = k.size();
+	}
+}
+
+void
+arena_builder::leaf(const json::string_ref<char>& t, int term) {
+	switch (term) {
+	case json::scanner<char>::STRING: {
+		arena_node *r = add(arena_node::STRING_NODE);
+		r->u.text = copy(t, r->n);
+		break;
+	}
+	case json::scanner<char>::INTEGER:
+	case json::scanner<char>::DOUBLE: {
+		arena_node *r = add(arena_node::NUMBER_NODE);
+		r->u.number = 0;
+		json::parse_double(t.data(), t.size(), r->u.number);
+		break;
+	}
+	case json::scanner<char>::TRUE_CONST:
+	case json::scanner<char>::FALSE_CONST:
+		add(arena_node::BOOL_NODE)->u.flag = json::scanner<char>::TRUE_CONST == term;
+		break;
+	default:
+		add(arena_node::NULL_NODE);
+		break;
 	}
-	os << "}";
-	return os;
 }
 
 }
@@ -98,6 +310,11 @@ operator<<(std::ostream& os, const json::root_node& r) {
 	return r.print(os);
 }
 
+std::ostream&
+operator<<(std::ostream& os, const json::arena_node& r) {
+	return r.print(os);
+}
+
 void
 obj_start_cb(std::stack<json::internal_node *> *st) {
 	json::obj_list_node *ol = new json::obj_list_node();
@@ -126,14 +343,16 @@ obj_data_cb(const std::string& data, int term, std::stack<json::internal_node *>
 	json::obj_node *obj = dynamic_cast<json::obj_node *>(st->top());
 	if (json::scanner<char>::STRING == term)
 		obj->add(data);
-	else if (0 == strcasecmp("false", data.c_str()))
+	else if (json::scanner<char>::INTEGER == term || json::scanner<char>::DOUBLE == term) {
+		double d = 0;
+		json::parse_double(data.data(), data.size(), d);
+		obj->add(d);
+	} else if (json::scanner<char>::FALSE_CONST == term)
 		obj->add(false);
-	else if (0 == strcasecmp("true", data.c_str()))
+	else if (json::scanner<char>::TRUE_CONST == term)
 		obj->add(true);
-	else if (0 == strcasecmp("null", data.c_str()))
-		obj->add(static_cast<const json::node *>(0));
 	else
-		obj->add(strtod(data.c_str(), 0));
+		obj->add(static_cast<const json::node *>(0));
 	st->pop();
 }
 
@@ -157,12 +376,14 @@ array_data_cb(const std::string& data, int term, std::stack<json::internal_node
 	json::array_node *a = dynamic_cast<json::array_node *>(st->top());
 	if (json::scanner<char>::STRING == term)
 		a->add(data);
-	else if (0 == strcasecmp("false", data.c_str()))
+	else if (json::scanner<char>::INTEGER == term || json::scanner<char>::DOUBLE == term) {
+		double d = 0;
+		json::parse_double(data.data(), data.size(), d);
+		a->add(d);
+	} else if (json::scanner<char>::FALSE_CONST == term)
 		a->add(false);
-	else if (0 == strcasecmp("true", data.c_str()))
+	else if (json::scanner<char>::TRUE_CONST == term)
 		a->add(true);
-	else if (0 == strcasecmp("null", data.c_str()))
-		a->add(static_cast<const json::node *>(0));
 	else
-		a->add(strtod(data.c_str(), 0));
+		a->add(static_cast<const json::node *>(0));
 }
@@ -5,6 +5,10 @@
 #include <stack>
 #include <vector>
 #include <iostream>
+#include "json_arena.hh"
+#include "json_handler.hh"
+#include "json_intern.hh"
+#include "json_writer.hh"
 
 namespace json {
 
@@ -22,6 +26,12 @@ public:
 	 * \return The output stream 
 	 */
 	virtual std::ostream& print(std::ostream&) const = 0;
+	/**
+	 * \brief Abstract method that writes the DOM tree node to a writer.
+	 * 
+	 * \param w The writer
+	 */
+	virtual void write(json::writer&) const = 0;
 };
 
 /**
@@ -48,6 +58,12 @@ public:
 	 * \return The output stream the string is printed to.
 	 */
 	std::ostream& print(std::ostream& os) const;
+	/**
+	 * \brief Writes the string to a writer.
+	 * 
+	 * \param w The writer the string is written to.
+	 */
+	void write(json::writer&) const;
 private:
 	//! \brief The string.
 	const std::string name_;
@@ -77,6 +93,12 @@ public:
 	 * \return The output stream the number is printed to.
 	 */
 	std::ostream& print(std::ostream& os) const;
+	/**
+	 * \brief Writes the number to a writer.
+	 * 
+	 * \param w The writer the number is written to.
+	 */
+	void write(json::writer&) const;
 private:
 	//! \brief The number.
 	const double number_;
@@ -104,6 +126,12 @@ public:
 	 * \return The output stream the boolean is printed to.
 	 */
 	std::ostream& print(std::ostream& os) const;
+	/**
+	 * \brief Writes the boolean to a writer.
+	 * 
+	 * \param w The writer the boolean is written to.
+	 */
+	void write(json::writer&) const;
 private:
 	//! \brief The boolean constant
 	const bool flag_;
@@ -156,6 +184,12 @@ public:
 	 * \return The output stream the wrapped object is printed to.
 	 */
 	virtual std::ostream& print(std::ostream& os) const;
+	/**
+	 * \brief Writes the wrapped object to a writer.
+	 * 
+	 * \param w The writer the wrapped object is written to.
+	 */
+	virtual void write(json::writer&) const;
 protected:
 	//! \brief The wrapped object.
 	const node *value_;
@@ -209,6 +243,12 @@ public:
 	 * \return The output stream the key:value pair is printed to.
 	 */
 	std::ostream& print(std::ostream&) const;
+	/**
+	 * \brief Writes the key:value pair to a writer.
+	 * 
+	 * \param w The writer the key:value pair is written to.
+	 */
+	void write(json::writer&) const;
 private:
 	//! \brief The key.
 	const std::string name_;
@@ -252,6 +292,12 @@ public:
 	 * \return The output stream the array is printed to.
 	 */
 	std::ostream& print(std::ostream&) const;
+	/**
+	 * \brief Writes the array to a writer.
+	 * 
+	 * \param w The writer the array is written to.
+	 */
+	void write(json::writer&) const;
 private:
 	//! \brief The array elements.
 	std::vector<const node *> v;
@@ -265,11 +311,28 @@ public:
 	//! \brief Destructs the list of key:value pairs as well.
 	~obj_list_node();
 	/**
-	 * \brief Adds a key:value pair to the object.
+	 * \brief Adds a key:value pair to the object. The index of the keys, if any, is dropped. \sa index_keys
 	 * 
 	 * \param obj The key:value pair to add to the object. 
 	 */
-	void add(const obj_node *obj) { v.push_back(obj); }
+	void add(const obj_node *obj) { v.push_back(obj); index.clear(); }
+	/**
+	 * \brief Builds the index of the pairs sorted by key that \link json::obj_list_node::find find\endlink
+	 * otherwise builds on the first lookup. Calling it after the last \link json::obj_list_node::add add\endlink
+	 * makes the lookups read-only, e.g. before the tree is searched by several threads at once.
+	 */
+	void index_keys() const;
+	/**
+	 * \brief Looks a key up. Small objects are searched linearly. For the other ones, an index of the pairs
+	 * sorted by key is built on the first lookup and kept until the next \link json::obj_list_node::add add\endlink,
+	 * so objects that are never searched pay nothing. Since that first lookup fills the index, an object must not
+	 * be searched by several threads at once unless \link json::obj_list_node::index_keys index_keys\endlink was
+	 * called before.
+	 * 
+	 * \param k The key.
+	 * \return The first key:value pair with the key, 0 if there is none.
+	 */
+	const obj_node *find(const std::string&) const;
 	/**
 	 * \brief Prints the object to the output stream.
 	 * 
@@ -277,9 +340,193 @@ public:
 	 * \return The output stream the object is printed to.
 	 */
 	std::ostream& print(std::ostream&) const;
+	/**
+	 * \brief Writes the object to a writer.
+	 * 
+	 * \param w The writer the object is written to.
+	 */
+	void write(json::writer&) const;
 private:
+	//! \brief The size from which objects are searched through the index.
+	static const size_t INDEX_THRESHOLD = 8;
 	//! \brief The list of key:value pairs.
 	std::vector<const obj_node *> v;
+	//! \brief The key:value pairs sorted by key, empty until the first lookup.
+	mutable std::vector<const obj_node *> index;
+};
+
+/**
+ * \brief A node of the arena DOM built by json::arena_builder. Unlike the json::node hierarchy, there is one
+ * class for all kinds of values, tagged with its kind, that has neither virtual methods nor a destructor. The
+ * nodes and their strings lie in a json::arena and are all released at once with the arena.
+ *
+ * The children of an array or an object form a singly linked list starting at
+ * \link json::arena_node::first first\endlink. The children of an object carry their key.
+ */
+class arena_node {
+public:
+	//! \brief The kinds of nodes.
+	typedef enum {
+		NULL_NODE, BOOL_NODE, NUMBER_NODE, STRING_NODE, ARRAY_NODE, OBJECT_NODE
+	} kind_t;
+	//! \brief Accessor method. Gets the kind of the node.
+	kind_t kind() const { return kind_; }
+	//! \brief Accessor method. Gets the boolean constant of a BOOL_NODE.
+	bool boolean() const { return u.flag; }
+	//! \brief Accessor method. Gets the number of a NUMBER_NODE.
+	double number() const { return u.number; }
+	//! \brief Accessor method. Gets the characters of a STRING_NODE, decoded. They are not null terminated.
+	const char *data() const { return u.text; }
+	//! \brief Accessor method. Gets the number of characters of a STRING_NODE or the number of children of a container.
+	size_t size() const { return n; }
+	//! \brief Accessor method. Gets the first child of an ARRAY_NODE or an OBJECT_NODE, 0 if there is none.
+	const arena_node *first() const { return u.first; }
+	/**
+	 * \brief Looks a key up in an OBJECT_NODE. The members are searched linearly: the nodes are immutable and
+	 * the arena has no room for an index. \sa find(int)
+	 * 
+	 * \param k The first character of the key.
+	 * \param len The number of characters of the key.
+	 * \return The first member with the key, 0 if there is none.
+	 */
+	const arena_node *find(const char *, size_t) const;
+	/**
+	 * \brief Looks a key up by the ID it has in the key table of the builder. Only integers are compared.
+	 * 
+	 * \param id The ID of the key.
+	 * \return The first member with the key, 0 if there is none.
+	 */
+	const arena_node *find(int) const;
+	//! \brief Accessor method. Gets the next sibling, 0 if the node is the last child of its parent.
+	const arena_node *next() const { return next_; }
+	//! \brief Accessor method. Gets the key of a child of an object, decoded. It is not null terminated.
+	const char *key() const { return key_; }
+	//! \brief Accessor method. Gets the number of characters of the key.
+	size_t key_size() const { return key_size_; }
+	//! \brief Accessor method. Gets the ID of the key in the key table of the builder, json::key_table::NO_KEY if it has none.
+	int key_id() const { return key_id_; }
+	/**
+	 * \brief Prints the node and its descendants to the output stream, in the format of json::root_node.
+	 * 
+	 * \param os The output stream the node is printed to.
+	 * \return The output stream the node is printed to.
+	 */
+	std::ostream& print(std::ostream&) const;
+	/**
+	 * \brief Writes the node and its descendants to a writer.
+	 * 
+	 * \param w The writer the node and its descendants is written to.
+	 */
+	void write(json::writer&) const;
+private:
+	friend class arena_builder;
+
+	//! \brief The kind of the node.
+	kind_t kind_;
+	//! \brief The payload. Which member is valid depends on the kind.
+	union {
+		bool flag;
+		double number;
+		const char *text;
+		const arena_node *first;
+	} u;
+	//! \brief The number of characters of a string or the number of children of a container.
+	size_t n;
+	//! \brief The next sibling.
+	const arena_node *next_;
+	//! \brief The key if the parent is an object, 0 otherwise.
+	const char *key_;
+	//! \brief The number of characters of the key.
+	size_t key_size_;
+	//! \brief The ID of the key.
+	int key_id_;
+};
+
+/**
+ * \brief The parser handler that builds an arena DOM. Every node and every string is allocated from the
+ * json::arena given to the constructor, hence building a document costs no heap allocation once the arena
+ * has grown, and \link json::arena::reset resetting\endlink the arena frees the document in constant time.
+ * The containers under construction are kept on a stack of the builder, so no RTTI is involved.
+ *
+ * If the builder is given a json::key_table, the keys found in it, or added to it, are not copied to the arena:
+ * the nodes point to the text of the table and carry the \link json::arena_node::key_id ID\endlink of the key.
+ *
+ * The parser is \link json::parser::reset reset\endlink before the arena, so that the builder drops the root
+ * and the containers of the last document, whether it was complete or not, while they still lie in the arena.
+ *
+ * \code
+ * json::arena a;
+ * json::parser<char, json::arena_builder> p((json::arena_builder(a)));
+ * for (...) {
+ * 	if (p.OK == p.parse(buf, len))
+ * 		use(p.handler().root());
+ * 	p.reset();
+ * 	a.reset();
+ * }
+ * \endcode
+ */
+class arena_builder : public json::handler<char> {
+public:
+	/**
+	 * \brief The constructor.
+	 * 
+	 * \param ar The arena the nodes are allocated from. It must outlive the documents.
+	 * \param kt The table the keys are interned in, 0 for none. It must outlive the documents.
+	 */
+	explicit arena_builder(json::arena& ar, json::key_table<char> *kt = 0)
+		: a(&ar), keys(kt), root_(0), key_(0), key_size_(0), key_id_(json::key_table<char>::NO_KEY) {}
+	//! \brief Accessor method. Gets the root of the last document, 0 if none was started.
+	const arena_node *root() const { return root_; }
+
+	//! \brief Starts an OBJECT_NODE. \sa handler::obj_start
+	void obj_start() { start(arena_node::OBJECT_NODE); }
+	//! \brief Copies the key to the arena. \sa handler::key
+	void key(const json::string_ref<char>&);
+	//! \brief Adds a leaf to the current object. \sa handler::obj_data
+	void obj_data(const json::string_ref<char>& t, int term) { leaf(t, term); }
+	//! \brief Ends the current object. \sa handler::obj_end
+	void obj_end() { frames.pop_back(); }
+	//! \brief Starts an ARRAY_NODE. \sa handler::array_start
+	void array_start() { start(arena_node::ARRAY_NODE); }
+	//! \brief Adds a leaf to the current array. \sa handler::array_data
+	void array_data(const json::string_ref<char>& t, int term) { leaf(t, term); }
+	//! \brief Ends the current array. \sa handler::array_end
+	void array_end() { frames.pop_back(); }
+	//! \brief Drops the root and the containers under construction. The arena is not reset. \sa handler::reset
+	void reset() { frames.clear(); root_ = 0; key_ = 0; key_size_ = 0; key_id_ = json::key_table<char>::NO_KEY; }
+private:
+	//! \brief A container under construction.
+	struct frame_t {
+		//! \brief The container.
+		arena_node *node;
+		//! \brief Its last child, 0 if it has none yet.
+		arena_node *last;
+	};
+	//! \brief Allocates a node of the given kind and links it to the current container.
+	arena_node *add(arena_node::kind_t);
+	//! \brief Adds a container and makes it the current one.
+	void start(arena_node::kind_t);
+	//! \brief Adds a string, a number, a boolean or null.
+	void leaf(const json::string_ref<char>&, int);
+	//! \brief Copies the decoded text of a token to the arena.
+	const char *copy(const json::string_ref<char>&, size_t&);
+
+	//! \brief The arena.
+	json::arena *a;
+	//! \brief The key table.
+	json::key_table<char> *keys;
+	//! \brief The root of the last document.
+	const arena_node *root_;
+	//! \brief The containers on the path from the root to the current node.
+	std::vector<frame_t> frames;
+	//! \brief The last key, copied to the arena.
+	const char *key_;
+	//! \brief The number of characters of the last key.
+	size_t key_size_;
+	//! \brief The ID of the last key.
+	int key_id_;
+	//! \brief The buffer escaped tokens are decoded in before they are copied to the arena.
+	std::string scratch;
 };
 
 }
@@ -293,6 +540,15 @@ private:
  */
 extern std::ostream& operator<<(std::ostream&, const json::root_node&);
 
+/**
+ * \brief Operator printing the arena DOM tree rooted in r to the output stream os
+ * 
+ * \param os The output stream the DOM tree is printed to
+ * \param r The DOM tree root node.
+ * \return The output stream the DOM tree is printed to
+ */
+extern std::ostream& operator<<(std::ostream&, const json::arena_node&);
+
 /**
  * \brief Creates a \link json::obj_list_node object node\endlink and adds it to the node
  * at the top of the stack passed as an argument.
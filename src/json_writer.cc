@@ -0,0 +1,113 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "json_simd.hh"
+#include "json_writer.hh"
+
+#if defined(__has_include)
+#if __has_include(<charconv>) && __cplusplus >= 201703L
+#include <charconv>
+#endif
+#endif
+
+namespace json {
+
+void
+writer::escape(std::string& out, const char *p, size_t n) {
+	static const char hex[] = "0123456789abcdef";
+	const char *end = p + n;
+	out.push_back('"');
+	while (p != end) {
+		// copy the run up to the next character to escape at once
+		const char *q = json::simd::find_string_special(p, end);
+		out.append(p, q);
+		if (q == end)
+			break;
+		switch (*q) {
+		case '"':
+			out.append("\\\"");
+			break;
+		case '\\':
+			out.append("\\\\");
+			break;
+		case '\n':
+			out.append("\\n");
+			break;
+		case '\t':
+			out.append("\\t");
+			break;
+		case '\r':
+			out.append("\\r");
+			break;
+		case '\b':
+			out.append("\\b");
+			break;
+		case '\f':
+			out.append("\\f");
+			break;
+		default: {
+			unsigned char c = static_cast<unsigned char>(*q);
+			const char u[] = {'\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf]};
+			out.append(u, sizeof(u));
+			break;
+		}
+		}
+		p = q + 1;
+	}
+	out.push_back('"');
+}
+
+void
+writer::format(std::string& out, int64_t i) {
+	char buf[24];
+	char *p = buf + sizeof(buf);
+	// the magnitude, computed without overflowing for the smallest int64_t
+	uint64_t v = i < 0 ? static_cast<uint64_t>(-(i + 1)) + 1 : static_cast<uint64_t>(i);
+	do {
+		*--p = static_cast<char>('0' + v % 10);
+		v /= 10;
+	} while (0 != v);
+	if (i < 0)
+		*--p = '-';
+	out.append(p, buf + sizeof(buf) - p);
+}
+
+void
+writer::format(std::string& out, double d) {
+	if (d != d || d - d != 0) {
+		out.append("null");
+		return;
+	}
+	// integers that a double represents exactly are written without fraction and exponent, -0 is not one
+	if (std::floor(d) == d && std::fabs(d) < 9007199254740992.0 && (0 != d || 1 / d > 0)) {
+		format(out, static_cast<int64_t>(d));
+		return;
+	}
+#if defined(__cpp_lib_to_chars)
+	// to_chars writes the shortest text that reads back, in one pass and whatever the locale
+	char buf[32];
+	std::to_chars_result res = std::to_chars(buf, buf + sizeof(buf), d);
+	out.append(buf, res.ptr);
+#else
+	// the fewest digits that read back, searched by bisection: 17 digits always do, and a precision that
+	// reads back stays the upper bound, so the text reads back even where more digits would not
+	char buf[32];
+	int low = 1, high = 17;
+	while (low < high) {
+		int precision = (low + high) / 2;
+		snprintf(buf, sizeof(buf), "%.*g", precision, d);
+		if (strtod(buf, 0) == d)
+			high = precision;
+		else
+			low = precision + 1;
+	}
+	snprintf(buf, sizeof(buf), "%.*g", high, d);
+	// the decimal point of the locale is not the one of JSON
+	for (char *p = buf; '\0' != *p; ++p)
+		if ((*p < '0' || *p > '9') && '-' != *p && '+' != *p && 'e' != *p)
+			*p = '.';
+	out.append(buf);
+#endif
+}
+
+}
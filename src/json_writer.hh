@@ -0,0 +1,220 @@
+#ifndef __JSON_WRITER_HH__
+#define __JSON_WRITER_HH__
+
+#include <string>
+#include <stdint.h>
+#include "json_handler.hh"
+
+namespace json {
+
+/**
+ * \brief A serializer that appends JSON text to one contiguous buffer, either a string of the caller or one of
+ * its own. The document is written through calls that follow its structure, the same way the parser reports
+ * it, so the writer may be driven by anything that walks a document: a DOM, a tape, or the parser itself (see
+ * json::write_handler). The separators between the values are inserted by the writer.
+ *
+ * Strings are escaped: the runs of characters that need no escaping are found with
+ * json::simd::find_string_special and copied at once. Doubles are written with the fewest digits that read
+ * back to the same value. JSON has no representation for NaN and the infinities, they are written as null.
+ *
+ * \code
+ * std::string out;
+ * json::writer w(out);
+ * w.obj_start();
+ * w.key("a", 1);
+ * w.number(0.1);
+ * w.obj_end();
+ * \endcode
+ */
+class writer {
+public:
+	//! \brief The layouts of the text.
+	typedef enum {
+		//! \brief No blanks, e.g. {"a":[1,2]}.
+		COMPACT,
+		//! \brief The layout of json::node::print, e.g. {"a" : [1, 2]}.
+		SPACED
+	} style_t;
+	/**
+	 * \brief The constructor of a writer that appends to a string of the caller. The string is not cleared, and
+	 * its capacity may be kept from one document to the next.
+	 *
+	 * \param o The string.
+	 * \param s The layout.
+	 */
+	explicit writer(std::string& o, style_t s = COMPACT) : out(&o), style(s), separate(false) {}
+	//! \brief The constructor of a writer that appends to a string of its own. \sa str
+	explicit writer(style_t s = COMPACT) : out(&own), style(s), separate(false) {}
+	//! \brief Writes '{'.
+	void obj_start() { value(); out->push_back('{'); separate = false; }
+	/**
+	 * \brief Writes a key. The value follows.
+	 *
+	 * \param p The first character of the decoded key.
+	 * \param n The number of characters.
+	 */
+	void key(const char *p, size_t n) {
+		value();
+		escape(*out, p, n);
+		out->append(COMPACT == style ? ":" : " : ");
+		separate = false;
+	}
+	//! \brief Writes '}'.
+	void obj_end() { out->push_back('}'); separate = true; }
+	//! \brief Writes '['.
+	void array_start() { value(); out->push_back('['); separate = false; }
+	//! \brief Writes ']'.
+	void array_end() { out->push_back(']'); separate = true; }
+	/**
+	 * \brief Writes a string, escaping it.
+	 *
+	 * \param p The first character of the decoded string.
+	 * \param n The number of characters.
+	 */
+	void string(const char *p, size_t n) { value(); escape(*out, p, n); separate = true; }
+	//! \brief Writes a double.
+	void number(double d) { value(); format(*out, d); separate = true; }
+	//! \brief Writes an integer.
+	void integer(int64_t i) { value(); format(*out, i); separate = true; }
+	//! \brief Writes true or false.
+	void boolean(bool b) { value(); out->append(b ? "true" : "false"); separate = true; }
+	//! \brief Writes null.
+	void null() { value(); out->append("null"); separate = true; }
+	/**
+	 * \brief Writes a value as it is, e.g. the text of a number token, so that it is not converted back and forth.
+	 *
+	 * \param p The first character of the value.
+	 * \param n The number of characters.
+	 */
+	void raw(const char *p, size_t n) { value(); out->append(p, n); separate = true; }
+	//! \brief The text written so far.
+	const std::string& str() const { return *out; }
+	//! \brief Clears the text, keeping the capacity of the string, to start another document.
+	void clear() { out->clear(); separate = false; }
+
+	/**
+	 * \brief Appends a string in quotes, escaping the quote, the backslash and the control characters.
+	 *
+	 * \param out The string appended to.
+	 * \param p The first character of the string.
+	 * \param n The number of characters.
+	 */
+	static void escape(std::string&, const char *, size_t);
+	//! \brief Appends the shortest text that reads back to the double. NaN and the infinities are appended as null.
+	static void format(std::string&, double);
+	//! \brief Appends an integer.
+	static void format(std::string&, int64_t);
+private:
+	//! \brief Called before every value and key, writes the separator if one is due.
+	void value() {
+		if (separate)
+			out->append(COMPACT == style ? "," : ", ");
+	}
+
+	//! \brief The string appended to.
+	std::string *out;
+	//! \brief The string of the writer, if it is given none.
+	std::string own;
+	//! \brief The layout.
+	style_t style;
+	//! \brief true if a value was written last, so a separator is due before the next one.
+	bool separate;
+
+	writer(const writer&);
+	writer& operator=(const writer&);
+};
+
+/**
+ * \brief The parser handler that writes what the parser reports to a json::writer, without building a DOM. The
+ * numbers are copied as they are in the input, so they keep their digits and are not converted back and forth,
+ * unless they are out of the JSON grammar, e.g. +1 or .5, which the scanner accepts: those are converted and
+ * written again. The strings are decoded and escaped again, so the output is valid JSON whatever the input. A handler derived from it may transform the
+ * document on the way, e.g. drop or rename keys.
+ *
+ * \code
+ * std::string out;
+ * json::writer w(out);
+ * json::parser<char, json::write_handler> p((json::write_handler(w)));
+ * p.parse(buf, len);
+ * \endcode
+ */
+class write_handler : public json::handler<char> {
+public:
+	/**
+	 * \brief The constructor.
+	 *
+	 * \param out The writer. It must outlive the handler.
+	 */
+	explicit write_handler(json::writer& out) : w(&out) {}
+	//! \brief Writes '{'. \sa handler::obj_start
+	void obj_start() { w->obj_start(); }
+	//! \brief Writes a key. \sa handler::key
+	void key(const json::string_ref<char>& k) {
+		if (k.escaped()) {
+			k.decode(scratch);
+			w->key(scratch.data(), scratch.size());
+		} else
+			w->key(k.data(), k.size());
+	}
+	//! \brief Writes a value. \sa handler::obj_data
+	void obj_data(const json::string_ref<char>& d, int term) { primitive(d, term); }
+	//! \brief Writes '}'. \sa handler::obj_end
+	void obj_end() { w->obj_end(); }
+	//! \brief Writes '['. \sa handler::array_start
+	void array_start() { w->array_start(); }
+	//! \brief Writes an element. \sa handler::array_data
+	void array_data(const json::string_ref<char>& d, int term) { primitive(d, term); }
+	//! \brief Writes ']'. \sa handler::array_end
+	void array_end() { w->array_end(); }
+protected:
+	//! \brief The writer.
+	json::writer *w;
+private:
+	//! \brief Writes a primitive value.
+	void primitive(const json::string_ref<char>& d, int term) {
+		switch (term) {
+		case json::scanner<char>::STRING:
+			if (d.escaped()) {
+				d.decode(scratch);
+				w->string(scratch.data(), scratch.size());
+			} else
+				w->string(d.data(), d.size());
+			break;
+		case json::scanner<char>::INTEGER:
+		case json::scanner<char>::DOUBLE:
+			number(d, term);
+			break;
+		case json::scanner<char>::TRUE_CONST:
+			w->boolean(true);
+			break;
+		case json::scanner<char>::FALSE_CONST:
+			w->boolean(false);
+			break;
+		default:
+			w->null();
+			break;
+		}
+	}
+	//! \brief Writes a number, as it is if it is a JSON number.
+	void number(const json::string_ref<char>& d, int term) {
+		if (json::is_json_number(d.data(), d.size())) {
+			w->raw(d.data(), d.size());
+			return;
+		}
+		int64_t i;
+		if (json::scanner<char>::INTEGER == term && json::parse_integer(d.data(), d.size(), i)) {
+			w->integer(i);
+			return;
+		}
+		double v = 0;
+		json::parse_double(d.data(), d.size(), v);
+		w->number(v);
+	}
+
+	//! \brief The buffer escaped tokens are decoded in.
+	std::string scratch;
+};
+
+}
+
+#endif
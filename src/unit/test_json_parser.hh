@@ -3,9 +3,28 @@
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/HelperMacros.h>
+#include <clocale>
+#include <sstream>
+#include <vector>
+#include <limits>
+#include <fstream>
+#include <cstdio>
+#include <unistd.h>
 #include "json_parser.hh"
 #include "json_scanner.hh"
 #include "json_tree.hh"
+#include "json_simd.hh"
+#include "json_index.hh"
+#include "json_tape.hh"
+#include "json_snapshot.hh"
+#include "json_batch.hh"
+#include "json_bind.hh"
+#include "json_intern.hh"
+#include "json_filter.hh"
+#include "json_parallel.hh"
+#include "json_mmap.hh"
+#include "json_writer.hh"
+#include "json_ondemand.hh"
 
 template<typename Char> size_t strlen(const Char *);
 
@@ -27,6 +46,41 @@ class TestJSONParser : public CppUnit::TestFixture {
 	CPPUNIT_TEST(error_scanner_error_at_beginning_of_chunk);
 	CPPUNIT_TEST(error_scanner_error_within_chunk);
 	CPPUNIT_TEST(error_trailing_incomplete_token);
+	CPPUNIT_TEST(ok_feed_one_char_chunks);
+	CPPUNIT_TEST(error_feed_syntax_error);
+	CPPUNIT_TEST(ok_single_chunk_linear_work);
+	CPPUNIT_TEST(ok_simd_kernels);
+	CPPUNIT_TEST(ok_simd_long_strings_and_blanks);
+	CPPUNIT_TEST(ok_structural_index);
+	CPPUNIT_TEST(ok_parse_whole_buffer);
+	CPPUNIT_TEST(error_parse_whole_buffer);
+	CPPUNIT_TEST(ok_string_ref);
+	CPPUNIT_TEST(ok_unescape);
+	CPPUNIT_TEST(ok_number_tokens);
+	CPPUNIT_TEST(ok_literal_tokens);
+	CPPUNIT_TEST(ok_static_handler);
+	CPPUNIT_TEST(ok_deep_nesting);
+	CPPUNIT_TEST(error_too_deep_nesting);
+	CPPUNIT_TEST(ok_arena_tree);
+	CPPUNIT_TEST(ok_tape);
+	CPPUNIT_TEST(ok_bind);
+	CPPUNIT_TEST(ok_key_table);
+	CPPUNIT_TEST(ok_find_key);
+	CPPUNIT_TEST(ok_path_filter);
+	CPPUNIT_TEST(ok_multi_document);
+	CPPUNIT_TEST(ok_parallel_ndjson);
+	CPPUNIT_TEST(ok_parallel_array);
+	CPPUNIT_TEST(ok_parse_file);
+	CPPUNIT_TEST(ok_feed_consumed_finish);
+	CPPUNIT_TEST(ok_writer);
+	CPPUNIT_TEST(ok_stats);
+	CPPUNIT_TEST(ok_memory_resource);
+	CPPUNIT_TEST(error_limits);
+	CPPUNIT_TEST(ok_unicode);
+	CPPUNIT_TEST(ok_on_demand);
+	CPPUNIT_TEST(ok_checkpoint);
+	CPPUNIT_TEST(ok_snapshot);
+	CPPUNIT_TEST(ok_event_batch);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -44,6 +98,109 @@ class TestJSONParser : public CppUnit::TestFixture {
 	void error_scanner_error_at_beginning_of_chunk();
 	void error_scanner_error_within_chunk();
 	void error_trailing_incomplete_token();
+	void ok_feed_one_char_chunks();
+	void error_feed_syntax_error();
+	void ok_single_chunk_linear_work();
+
+	void ok_simd_kernels();
+	void ok_simd_long_strings_and_blanks();
+	void ok_structural_index();
+	void ok_parse_whole_buffer();
+	void error_parse_whole_buffer();
+	void ok_string_ref();
+	void ok_unescape();
+	void ok_number_tokens();
+	void ok_literal_tokens();
+	void ok_static_handler();
+	void ok_deep_nesting();
+	void error_too_deep_nesting();
+	void ok_arena_tree();
+	void ok_tape();
+	void ok_bind();
+	void ok_key_table();
+	void ok_find_key();
+	void ok_path_filter();
+	void ok_multi_document();
+	void ok_parallel_ndjson();
+	void ok_parallel_array();
+	void ok_parse_file();
+	void ok_feed_consumed_finish();
+	void ok_writer();
+	void ok_stats();
+	void ok_memory_resource();
+	void error_limits();
+	void ok_unicode();
+	void ok_on_demand();
+	void ok_checkpoint();
+	void ok_snapshot();
+	void ok_event_batch();
+
+	std::string parse_to_string(const std::basic_string<Char>&, size_t);
+	std::string parse_whole_to_string(const std::basic_string<Char>&);
+
+	// What the callbacks taking views were given.
+	struct ref_log_t {
+		const Char *begin, *end;
+		std::vector<std::basic_string<Char> > text;
+		std::vector<bool> escaped, in_place;
+	};
+	static void key_ref_cb(const json::string_ref<Char>&, void *);
+	static void data_ref_cb(const json::string_ref<Char>&, int, void *);
+
+	// What the number callbacks were given.
+	struct number_log_t {
+		std::vector<int64_t> integers;
+		std::vector<double> doubles;
+	};
+	static void integer_cb(int64_t, void *);
+	static void double_cb(double, void *);
+	static void literal_cb(int, void *);
+	static void key_id_cb(int, void *);
+	static void match_cb(size_t, const json::string_ref<Char>&, int, void *);
+	static void document_end_cb(void *);
+	static void batch_cb(json::event_batch<char>&, void *);
+
+	// A handler that records the object events and ignores the array events.
+	struct obj_handler_t : public json::handler<Char> {
+		obj_handler_t() : depth(0), max_depth(0) {}
+		void obj_start() { if (++depth > max_depth) max_depth = depth; }
+		void obj_end() { --depth; }
+		void key(const json::string_ref<Char>& k) { keys.append(k.str()).append(1, static_cast<Char>(',')); }
+		void obj_data(const json::string_ref<Char>& d, int) { data.append(d.str()).append(1, static_cast<Char>(',')); }
+		int depth, max_depth;
+		std::basic_string<Char> keys, data;
+	};
+	// Appends the keys of a block of json::parallel_parser, or "!" for a bad block, to a string.
+	static void block_cb(obj_handler_t&, typename json::parser<char, obj_handler_t>::result_t, const char *, size_t, void *);
+	// Like block_cb, but throws once a few blocks were logged.
+	static void throwing_block_cb(obj_handler_t&, typename json::parser<char, obj_handler_t>::result_t, const char *, size_t, void *);
+
+	// What json::event_batcher handed over: the number of batches and their records, one line each.
+	struct batches_t {
+		batches_t() : count(0), kept(4) {}
+		size_t count;
+		std::string events;
+		// the batch the callback swaps with the full one
+		json::event_batch<char> kept;
+	};
+
+	// A resource that counts what it serves from the heap.
+	struct counting_resource_t : public json::memory_resource {
+		counting_resource_t() : allocations(0), live(0) {}
+		size_t allocations, live;
+	protected:
+		void *do_allocate(size_t n, size_t a) { ++allocations; live += n; return json::new_delete_resource()->allocate(n, a); }
+		void do_deallocate(void *p, size_t n, size_t a) { live -= n; json::new_delete_resource()->deallocate(p, n, a); }
+	};
+
+	// A struct bound by json::binder.
+	struct bound_t {
+		int64_t id;
+		int count;
+		double ratio;
+		bool on;
+		std::string label;
+	};
 public:
 	void setUp();
 	void tearDown();
@@ -449,4 +606,1719 @@ TestJSONParser<Char>::error_trailing_incomplete_token() {
 	CPPUNIT_ASSERT(json::parser<Char>::ERROR == parser.parse());
 }
 
+template<typename Char>
+void
+TestJSONParser<Char>::ok_feed_one_char_chunks() {
+	const Char *json = "{ \"h\\\"\\\\e\\/a\\\"a\" : 1.3e+1, \"obj\" : {}, \"\" : [null, true, false], \"g\" : [{\"h\" : 2, \"i\" : null}, 0, .8]}";
+
+	json::parser<Char> parser;
+	std::stack<json::internal_node *> ctx;
+	parser.hook_obj_start(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&obj_start_cb));
+	parser.hook_key(reinterpret_cast<typename json::parser<Char>::hook_key_t>(&key_cb));
+	parser.hook_obj_data(reinterpret_cast<typename json::parser<Char>::hook_primitive_t>(&obj_data_cb));
+	parser.hook_obj_end(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&obj_end_cb));
+	parser.hook_array_start(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&array_start_cb));
+	parser.hook_array_data(reinterpret_cast<typename json::parser<Char>::hook_primitive_t>(&array_data_cb));
+	parser.hook_array_end(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&array_end_cb));
+	parser.set_context(&ctx);
+	json::root_node *r = new json::root_node();
+	ctx.push(r);
+
+	size_t n = strlen(json);
+	for (size_t i = 0; i < n; ++i)
+		CPPUNIT_ASSERT(json::parser<Char>::PENDING == parser.feed(json + i, 1));
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == parser.feed(json, 0));
+	CPPUNIT_ASSERT(json::parser<Char>::OK == parser.feed(json, 0));
+
+	CPPUNIT_ASSERT(1 == ctx.size());
+	std::basic_ostringstream<Char> os;
+	os << *r;
+	CPPUNIT_ASSERT(os.str() == "{\"h\\\"\\\\e/a\\\"a\" : 13, \"obj\" : {}, \"\" : [null, true, false], \"g\" : [{\"h\" : 2, \"i\" : null}, 0, 0.8]}");
+	delete r;
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::error_feed_syntax_error() {
+	const Char *chunks[] = {
+		"{ \"a\" : [1, 2",
+		"] , } "
+	};
+
+	json::parser<Char> parser;
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == parser.feed(chunks[0], strlen(chunks[0])));
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == parser.feed(chunks[1], strlen(chunks[1])));
+}
+
+// Parses an array of about n characters whose elements all force the scanner to read past the end of the token.
+template<typename Char>
+void
+TestJSONParser<Char>::ok_single_chunk_linear_work() {
+	const Char *element = "12,0.5,{\"a\":[1e+1]},";
+	const size_t len = strlen(element), count = 4096;
+	std::basic_string<Char> json(1, static_cast<Char>('['));
+	for (size_t i = 0; i < count; ++i)
+		json.append(element, len);
+	json.append("0]");
+
+	// the lookahead stays bounded within a chunk, and no token of the chunk is copied
+	json::parser<Char> parser;
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == parser.feed(json.data(), json.size()));
+	CPPUNIT_ASSERT(parser.buffered() <= 4);
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == parser.feed(json.data(), 0));
+	CPPUNIT_ASSERT(json::parser<Char>::OK == parser.feed(json.data(), 0));
+	json::stats s = parser.stats();
+	if (json::stats::enabled) {
+		CPPUNIT_ASSERT(s.copied_bytes <= 4 && s.unget_bytes <= 4);
+		CPPUNIT_ASSERT(3 * count + 1 == s.tokens[json::scanner<Char>::INTEGER] + s.tokens[json::scanner<Char>::DOUBLE]);
+	}
+
+	// fed one character at a time, only the current token is held, and every character is copied at most once
+	json::parser<Char> fed;
+	typename json::parser<Char>::result_t res = json::parser<Char>::PENDING;
+	for (size_t i = 0; i < json.size() && json::parser<Char>::PENDING == res; ++i) {
+		res = fed.feed(json.data() + i, 1);
+		CPPUNIT_ASSERT(fed.buffered() <= 16);
+	}
+	while (json::parser<Char>::PENDING == res)
+		res = fed.feed(json.data(), 0);
+	CPPUNIT_ASSERT(json::parser<Char>::OK == res);
+	if (json::stats::enabled)
+		CPPUNIT_ASSERT(fed.stats().copied_bytes <= json.size() && fed.stats().unget_bytes <= 4 * json.size());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_simd_kernels() {
+	const json::simd::isa_t isas[] = {json::simd::SCALAR, json::simd::SSE2, json::simd::AVX2, json::simd::NEON};
+	const char specials[] = {'"', '\\', '\0', '\n', '\x1f'};
+	const char blanks[] = " \t\n\r\f";
+	char buf[100];
+
+	for (unsigned int i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+		json::simd::select(isas[i]);
+		for (size_t n = 0; n < sizeof(buf); ++n) {
+			for (size_t k = 0; k < n; ++k)
+				buf[k] = static_cast<char>(k % 2 ? 'a' : '\xe9');
+			CPPUNIT_ASSERT(buf + n == json::simd::find_string_special(buf, buf + n));
+			for (size_t j = 0; j < n; ++j) {
+				buf[j] = specials[j % sizeof(specials)];
+				CPPUNIT_ASSERT(buf + j == json::simd::find_string_special(buf, buf + n));
+				buf[j] = 'a';
+			}
+			for (size_t k = 0; k < n; ++k)
+				buf[k] = blanks[k % 5];
+			CPPUNIT_ASSERT(buf + n == json::simd::skip_blanks(buf, buf + n));
+			for (size_t j = 0; j < n; ++j) {
+				buf[j] = static_cast<char>(j % 2 ? '"' : '\xa0');
+				CPPUNIT_ASSERT(buf + j == json::simd::skip_blanks(buf, buf + n));
+				buf[j] = ' ';
+			}
+		}
+	}
+	json::simd::select(json::simd::AVX2);
+}
+
+// Parses json fed in chunks of the given size and returns the printed DOM tree.
+template<typename Char>
+std::string
+TestJSONParser<Char>::parse_to_string(const std::basic_string<Char>& json, size_t chunk_size) {
+	json::parser<Char> parser;
+	std::stack<json::internal_node *> ctx;
+	parser.hook_obj_start(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&obj_start_cb));
+	parser.hook_key(reinterpret_cast<typename json::parser<Char>::hook_key_t>(&key_cb));
+	parser.hook_obj_data(reinterpret_cast<typename json::parser<Char>::hook_primitive_t>(&obj_data_cb));
+	parser.hook_obj_end(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&obj_end_cb));
+	parser.hook_array_start(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&array_start_cb));
+	parser.hook_array_data(reinterpret_cast<typename json::parser<Char>::hook_primitive_t>(&array_data_cb));
+	parser.hook_array_end(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&array_end_cb));
+	parser.set_context(&ctx);
+	json::root_node r;
+	ctx.push(&r);
+
+	typename json::parser<Char>::result_t res = json::parser<Char>::PENDING;
+	for (size_t i = 0; i < json.size() && json::parser<Char>::PENDING == res; i += chunk_size)
+		res = parser.feed(json.data() + i, std::min(chunk_size, json.size() - i));
+	while (json::parser<Char>::PENDING == res)
+		res = parser.feed(json.data(), 0);
+	CPPUNIT_ASSERT(json::parser<Char>::OK == res);
+	CPPUNIT_ASSERT(1 == ctx.size());
+	std::ostringstream os;
+	os << r;
+	return os.str();
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_simd_long_strings_and_blanks() {
+	std::basic_string<Char> json("{");
+	std::string expected("{");
+	for (int i = 0; i < 20; ++i) {
+		std::basic_string<Char> blanks(i * 7, static_cast<Char>(i % 2 ? ' ' : '\n'));
+		std::basic_string<Char> body(i * 13, static_cast<Char>('a' + i));
+		json.append(blanks).append("\"k").append(1, static_cast<Char>('a' + i)).append("\"").append(blanks).append(":");
+		json.append(blanks).append("\"").append(body).append("\\\"").append(body).append("\\n\\u00e9\"").append(blanks).append(",");
+		expected.append("\"k").append(1, static_cast<char>('a' + i)).append("\" : \"");
+		expected.append(body).append("\\\"").append(body).append("\\n\xc3\xa9\", ");
+	}
+	json.append("\"end\" : [ ]   }");
+	expected.append("\"end\" : []}");
+
+	const json::simd::isa_t isas[] = {json::simd::SCALAR, json::simd::SSE2, json::simd::AVX2, json::simd::NEON};
+	for (unsigned int i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+		json::simd::select(isas[i]);
+		CPPUNIT_ASSERT(expected == parse_to_string(json, json.size()));
+		CPPUNIT_ASSERT(expected == parse_to_string(json, 7));
+		CPPUNIT_ASSERT(expected == parse_to_string(json, 1));
+	}
+	json::simd::select(json::simd::AVX2);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_structural_index() {
+	const char *json = "{ \"a\\\"b\" : [1, 23.5e1,true ,\"\\\\\"],\"\\\\\\\"{\":null}";
+	const size_t expected[] = {0, 2, 7, 9, 11, 12, 13, 15, 21, 22, 27, 28, 31, 32, 33, 34, 40, 41, 42, 46};
+	json::structural_index<char> index;
+	CPPUNIT_ASSERT(index.build(json, ::strlen(json)));
+	CPPUNIT_ASSERT(sizeof(expected) / sizeof(expected[0]) == index.size());
+	for (size_t i = 0; i < index.size(); ++i)
+		CPPUNIT_ASSERT(expected[i] == index[i]);
+	CPPUNIT_ASSERT(!index.build(json, 30));
+
+	// the vectorised index is the same as the scalar one, also for backslash and quote runs that cross blocks.
+	const char alphabet[] = {'"', '\\', '\\', 'a', ' ', '{', ':', '1', 'n'};
+	json::structural_index<wchar_t> scalar;
+	srand(1);
+	for (int k = 0; k < 200; ++k) {
+		std::string s;
+		std::wstring w;
+		for (int i = rand() % 300; i > 0; --i) {
+			char c = alphabet[rand() % sizeof(alphabet)];
+			s.push_back(c);
+			w.push_back(static_cast<wchar_t>(c));
+		}
+		for (unsigned int i = 0; i < 3; ++i) {
+			json::simd::select(i == 0 ? json::simd::SCALAR : i == 1 ? json::simd::SSE2 : json::simd::AVX2);
+			CPPUNIT_ASSERT(scalar.build(w.data(), w.size()) == index.build(s.data(), s.size()));
+			CPPUNIT_ASSERT(scalar.size() == index.size());
+			for (size_t j = 0; j < index.size(); ++j)
+				CPPUNIT_ASSERT(scalar[j] == index[j]);
+		}
+	}
+	json::simd::select(json::simd::AVX2);
+}
+
+template<typename Char>
+std::string
+TestJSONParser<Char>::parse_whole_to_string(const std::basic_string<Char>& json) {
+	json::parser<Char> parser;
+	std::stack<json::internal_node *> ctx;
+	parser.hook_obj_start(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&obj_start_cb));
+	parser.hook_key(reinterpret_cast<typename json::parser<Char>::hook_key_t>(&key_cb));
+	parser.hook_obj_data(reinterpret_cast<typename json::parser<Char>::hook_primitive_t>(&obj_data_cb));
+	parser.hook_obj_end(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&obj_end_cb));
+	parser.hook_array_start(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&array_start_cb));
+	parser.hook_array_data(reinterpret_cast<typename json::parser<Char>::hook_primitive_t>(&array_data_cb));
+	parser.hook_array_end(reinterpret_cast<typename json::parser<Char>::hook_start_end_t>(&array_end_cb));
+	parser.set_context(&ctx);
+	json::root_node r;
+	ctx.push(&r);
+
+	CPPUNIT_ASSERT(json::parser<Char>::OK == parser.parse(json.data(), json.size()));
+	CPPUNIT_ASSERT(1 == ctx.size());
+	std::ostringstream os;
+	os << r;
+	return os.str();
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_parse_whole_buffer() {
+	const Char *docs[] = {
+		"{ \"h\\u00eq\\\"\\t\\n\\r\\f\\u0043\\uc3a9\\\\\\u00e9e\\b\\/a\\\"\\xa\\u12\" : +1.3e+1 }",
+		"{ \"h\\\"\\\\e\\/a\\\"a\" : 1.3e+1, \"obj\" : {}, \"xi\" : {\"phi\" : \"omega\"}, \"\" : [null, true, false], \"null\" : [true], \"dolly\" : [], \"a\" : 0, \"b\" : 0., \"c\" : 0.0, \"d\" : 1e-1, \"e\" : [\"done\"], \"f\" : \"ok\", \"g\" : [{\"h\" : 2, \"i\" : null, \"j\" : false, \"k\" : true}, null, {}, .8]} ",
+		"\n[1,2,{\"}\":\"[\"},\"a\\\\\",-0.5E-3]\n"
+	};
+	for (unsigned int i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+		std::basic_string<Char> json(docs[i]);
+		CPPUNIT_ASSERT(parse_to_string(json, json.size()) == parse_whole_to_string(json));
+	}
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::error_parse_whole_buffer() {
+	const Char *docs[] = {
+		"",
+		"   ",
+		"{ \"a\" : tri }",
+		"{ \"a\" : tr ue }",
+		"{ \"a\" : 1 2 }",
+		"{ \"a\" : 1e }",
+		"{ \"a\" \"b\" : 1 }",
+		"{ \"a\" : 1 } false",
+		"{ \"a\" : \"b }",
+		"{ \"a\" : [1, 2 }"
+	};
+	for (unsigned int i = 0; i < sizeof(docs) / sizeof(docs[0]); ++i) {
+		json::parser<Char> parser;
+		CPPUNIT_ASSERT(json::parser<Char>::ERROR == parser.parse(docs[i], strlen(docs[i])));
+	}
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::key_ref_cb(const json::string_ref<Char>& ref, void *ctx) {
+	data_ref_cb(ref, json::scanner<Char>::STRING, ctx);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::data_ref_cb(const json::string_ref<Char>& ref, int, void *ctx) {
+	ref_log_t *log = static_cast<ref_log_t *>(ctx);
+	log->text.push_back(ref.str());
+	log->escaped.push_back(ref.escaped());
+	log->in_place.push_back(ref.data() >= log->begin && ref.data() + ref.size() <= log->end);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_string_ref() {
+	const std::basic_string<Char> json("{\"plain\" : \"abc\", \"esc\\n\" : [\"x\\u00e9y\", 12, \"q\\\\\"], \"\" : true}");
+	const char *text[] = {"plain", "abc", "esc\n", "x\xc3\xa9y", "12", "q\\", "", "true"};
+	const bool escaped[] = {false, false, true, true, false, true, false, false};
+	const size_t count = sizeof(text) / sizeof(text[0]);
+
+	// the whole buffer at once through the index, in one chunk, in one-character chunks
+	const size_t chunk_sizes[] = {0, json.size(), 1};
+	for (unsigned int k = 0; k < sizeof(chunk_sizes) / sizeof(chunk_sizes[0]); ++k) {
+		size_t chunk_size = chunk_sizes[k];
+		ref_log_t log;
+		log.begin = json.data();
+		log.end = json.data() + json.size();
+		json::parser<Char> parser;
+		parser.hook_key_ref(&key_ref_cb);
+		parser.hook_obj_data_ref(&data_ref_cb);
+		parser.hook_array_data_ref(&data_ref_cb);
+		parser.set_context(&log);
+		if (0 == chunk_size)
+			CPPUNIT_ASSERT(json::parser<Char>::OK == parser.parse(json.data(), json.size()));
+		else {
+			typename json::parser<Char>::result_t res = json::parser<Char>::PENDING;
+			for (size_t i = 0; i < json.size() && json::parser<Char>::PENDING == res; i += chunk_size)
+				res = parser.feed(json.data() + i, std::min(chunk_size, json.size() - i));
+			while (json::parser<Char>::PENDING == res)
+				res = parser.feed(json.data(), 0);
+			CPPUNIT_ASSERT(json::parser<Char>::OK == res);
+		}
+		CPPUNIT_ASSERT(count == log.text.size());
+		for (size_t i = 0; i < count; ++i) {
+			CPPUNIT_ASSERT(std::basic_string<Char>(text[i]) == log.text[i]);
+			CPPUNIT_ASSERT(escaped[i] == log.escaped[i]);
+		}
+		// tokens that lie in one chunk are not copied. Tokens spanning one-character chunks are.
+		if (1 != chunk_size)
+			for (size_t i = 0; i < count; ++i)
+				CPPUNIT_ASSERT(log.in_place[i]);
+		else
+			CPPUNIT_ASSERT(!log.in_place[0]);
+	}
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_unescape() {
+	const char *raw[] = {"", "abc", "\\\\", "a\\/b\\\"", "\\u004A\\u004a", "\\uC3A9", "\\u00eq", "\\u12", "\\x\\t\\b"};
+	const char *expected[] = {"", "abc", "\\", "a/b\"", "JJ", "\xec\x8e\xa9", "u00eq", "u12", "x\t\b"};
+	std::basic_string<Char> r("junk");
+	for (unsigned int i = 0; i < sizeof(raw) / sizeof(raw[0]); ++i) {
+		json::scanner<Char>::unescape(raw[i], strlen(raw[i]), r);
+		CPPUNIT_ASSERT(std::basic_string<Char>(expected[i]) == r);
+		CPPUNIT_ASSERT(std::basic_string<Char>(expected[i]) == json::string_ref<Char>(raw[i], strlen(raw[i]), true).str());
+	}
+	CPPUNIT_ASSERT(std::basic_string<Char>("a\\nb") == json::string_ref<Char>("a\\nb", 4).str());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::integer_cb(int64_t i, void *ctx) {
+	static_cast<number_log_t *>(ctx)->integers.push_back(i);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::double_cb(double d, void *ctx) {
+	static_cast<number_log_t *>(ctx)->doubles.push_back(d);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_number_tokens() {
+	const Char *tokens[] = {"0", "-0", "123", "+7", "0.", ".8", "1e5", "-1.3e+1", "1e-09", "2E05", "true", "null", "\"1\""};
+	const int kinds[] = {
+		json::scanner<Char>::INTEGER, json::scanner<Char>::INTEGER, json::scanner<Char>::INTEGER, json::scanner<Char>::INTEGER,
+		json::scanner<Char>::DOUBLE, json::scanner<Char>::DOUBLE, json::scanner<Char>::DOUBLE, json::scanner<Char>::DOUBLE,
+		json::scanner<Char>::DOUBLE, json::scanner<Char>::DOUBLE,
+		json::scanner<Char>::TRUE_CONST, json::scanner<Char>::NULL_CONST, json::scanner<Char>::STRING
+	};
+	json::scanner<Char> scanner;
+	for (unsigned int i = 0; i < sizeof(tokens) / sizeof(tokens[0]); ++i) {
+		const Char *end = tokens[i] + strlen(tokens[i]);
+		CPPUNIT_ASSERT(kinds[i] == scanner.scan(tokens[i], end, end));
+	}
+
+	const std::basic_string<Char> json("[1, -2, 3.5, 9223372036854775807, -9223372036854775808, 9223372036854775808, 1e400, {\"a\" : 7, \"b\" : 0.25, \"c\" : \"8\"}, true]");
+	for (unsigned int k = 0; k < 2; ++k) {
+		number_log_t log;
+		json::parser<Char> parser;
+		parser.hook_array_integer(&integer_cb);
+		parser.hook_array_double(&double_cb);
+		parser.hook_obj_integer(&integer_cb);
+		parser.hook_obj_double(&double_cb);
+		parser.set_context(&log);
+		if (0 == k)
+			CPPUNIT_ASSERT(json::parser<Char>::OK == parser.parse(json.data(), json.size()));
+		else {
+			typename json::parser<Char>::result_t res = parser.feed(json.data(), json.size());
+			while (json::parser<Char>::PENDING == res)
+				res = parser.feed(json.data(), 0);
+			CPPUNIT_ASSERT(json::parser<Char>::OK == res);
+		}
+		CPPUNIT_ASSERT(5 == log.integers.size());
+		CPPUNIT_ASSERT(1 == log.integers[0]);
+		CPPUNIT_ASSERT(-2 == log.integers[1]);
+		CPPUNIT_ASSERT(INT64_MAX == log.integers[2]);
+		CPPUNIT_ASSERT(INT64_MIN == log.integers[3]);
+		CPPUNIT_ASSERT(7 == log.integers[4]);
+		CPPUNIT_ASSERT(4 == log.doubles.size());
+		CPPUNIT_ASSERT(3.5 == log.doubles[0]);
+		CPPUNIT_ASSERT(9223372036854775808.0 == log.doubles[1]);
+		CPPUNIT_ASSERT(log.doubles[2] > 1e308);
+		CPPUNIT_ASSERT(0.25 == log.doubles[3]);
+	}
+
+	// without an integer callback the integers go to the double callback
+	number_log_t log;
+	json::parser<Char> parser;
+	parser.hook_array_double(&double_cb);
+	parser.set_context(&log);
+	const Char *doc = "[1, 2.5, -30]";
+	CPPUNIT_ASSERT(json::parser<Char>::OK == parser.parse(doc, strlen(doc)));
+	CPPUNIT_ASSERT(3 == log.doubles.size() && 1.0 == log.doubles[0] && 2.5 == log.doubles[1] && -30.0 == log.doubles[2]);
+
+	// the decimal point is the one of JSON in a locale whose point is a comma, if one is installed
+	const std::string saved(setlocale(LC_NUMERIC, 0));
+	const char *commas[] = {"de_DE.UTF-8", "fr_FR.UTF-8", "de_DE", "fr_FR"};
+	for (size_t i = 0; i < sizeof(commas) / sizeof(commas[0]); ++i) {
+		if (0 == setlocale(LC_NUMERIC, commas[i]))
+			continue;
+		double d = 0;
+		CPPUNIT_ASSERT(json::parse_double("1.5", 3, d) && 1.5 == d);
+		CPPUNIT_ASSERT(json::parse_double("2.5e-400", 8, d) && 0 == d);
+	}
+	setlocale(LC_NUMERIC, saved.c_str());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::literal_cb(int term, void *ctx) {
+	static_cast<std::vector<int> *>(ctx)->push_back(term);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_literal_tokens() {
+	const Char *tokens[] = {"false", "FALSE", "nUlL", "True", "\"null\""};
+	const int kinds[] = {json::scanner<Char>::FALSE_CONST, json::scanner<Char>::FALSE_CONST, json::scanner<Char>::NULL_CONST,
+		json::scanner<Char>::TRUE_CONST, json::scanner<Char>::STRING};
+	json::scanner<Char> scanner;
+	for (unsigned int i = 0; i < sizeof(tokens) / sizeof(tokens[0]); ++i) {
+		const Char *end = tokens[i] + strlen(tokens[i]);
+		CPPUNIT_ASSERT(kinds[i] == scanner.scan(tokens[i], end, end));
+	}
+
+	const Char *doc = "{\"a\" : true, \"b\" : [false, null, 1, \"true\", TRUE], \"c\" : null}";
+	const int expected[] = {json::scanner<Char>::TRUE_CONST, json::scanner<Char>::FALSE_CONST, json::scanner<Char>::NULL_CONST,
+		json::scanner<Char>::TRUE_CONST, json::scanner<Char>::NULL_CONST};
+	std::vector<int> log;
+	json::parser<Char> parser;
+	parser.hook_obj_literal(&literal_cb);
+	parser.hook_array_literal(&literal_cb);
+	parser.set_context(&log);
+	CPPUNIT_ASSERT(json::parser<Char>::OK == parser.parse(doc, strlen(doc)));
+	CPPUNIT_ASSERT(std::vector<int>(expected, expected + sizeof(expected) / sizeof(expected[0])) == log);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_static_handler() {
+	const std::basic_string<Char> json("{\"a\" : 1, \"b\" : [2, {\"c\" : \"x\\n\"}], \"d\" : {\"e\" : {}, \"f\" : null}}");
+	typedef json::parser<Char, obj_handler_t> parser_t;
+	for (unsigned int k = 0; k < 2; ++k) {
+		obj_handler_t h;
+		h.keys.assign(1, static_cast<Char>('>'));
+		parser_t parser(h);
+		if (0 == k)
+			CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+		else {
+			typename parser_t::result_t res = parser_t::PENDING;
+			for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += 3)
+				res = parser.feed(json.data() + i, std::min(static_cast<size_t>(3), json.size() - i));
+			while (parser_t::PENDING == res)
+				res = parser.feed(json.data(), 0);
+			CPPUNIT_ASSERT(parser_t::OK == res);
+		}
+		CPPUNIT_ASSERT(0 == parser.handler().depth);
+		CPPUNIT_ASSERT(3 == parser.handler().max_depth);
+		CPPUNIT_ASSERT(std::basic_string<Char>(">a,b,c,d,e,f,") == parser.handler().keys);
+		CPPUNIT_ASSERT(std::basic_string<Char>("1,x\n,null,") == parser.handler().data);
+	}
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_deep_nesting() {
+	std::basic_string<Char> json;
+	// 340 levels
+	for (int i = 0; i < 170; ++i)
+		json.append("{\"a\" : [1, ");
+	json.append("2");
+	for (int i = 0; i < 170; ++i)
+		json.append("]}");
+
+	json::parser<Char> whole;
+	CPPUNIT_ASSERT(json::parser<Char>::OK == whole.parse(json.data(), json.size()));
+	json::parser<Char> fed;
+	typename json::parser<Char>::result_t res = fed.feed(json.data(), json.size());
+	while (json::parser<Char>::PENDING == res)
+		res = fed.feed(json.data(), 0);
+	CPPUNIT_ASSERT(json::parser<Char>::OK == res);
+
+	// long lists do not take stack space
+	json.assign("{");
+	for (int i = 0; i < 10000; ++i)
+		json.append("\"k\" : [[], 1, {}], ");
+	json.append("\"k\" : 0}");
+	json::parser<Char> flat;
+	CPPUNIT_ASSERT(json::parser<Char>::OK == flat.parse(json.data(), json.size()));
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::error_too_deep_nesting() {
+	std::basic_string<Char> json(100000, static_cast<Char>('['));
+	json.append(100000, static_cast<Char>(']'));
+
+	json::parser<Char> whole;
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == whole.parse(json.data(), json.size()));
+	CPPUNIT_ASSERT(json::parser<Char>::DEPTH_LIMIT == whole.error());
+	json::parser<Char> fed;
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == fed.feed(json.data(), json.size()));
+	CPPUNIT_ASSERT(json::parser<Char>::DEPTH_LIMIT == fed.error());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_arena_tree() {
+	const char *docs[] = {
+		"{}",
+		"[]",
+		"{\"a\" : 1, \"b\" : [2.5, {\"c\" : \"x\\ny\"}, [], {}], \"\" : {\"e\" : {}, \"f\" : null}}",
+		"[true, false, null, -3, \"\", \"a\\u0041\", [[[\"deep\"]]]]"
+	};
+	typedef json::parser<char, json::arena_builder> parser_t;
+	json::arena a(64);
+	size_t capacity = 0;
+	for (unsigned int pass = 0; pass < 2; ++pass) {
+		for (size_t d = 0; d < sizeof(docs) / sizeof(docs[0]); ++d) {
+			const std::string json(docs[d]);
+			parser_t whole((json::arena_builder(a)));
+			CPPUNIT_ASSERT(parser_t::OK == whole.parse(json.data(), json.size()));
+			std::ostringstream os;
+			os << *whole.handler().root();
+			CPPUNIT_ASSERT(parse_whole_to_string(json) == os.str());
+
+			// tokens spanning chunks are copied to the arena as well
+			parser_t fed((json::arena_builder(a)));
+			parser_t::result_t res = parser_t::PENDING;
+			for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += 3)
+				res = fed.feed(json.data() + i, std::min(static_cast<size_t>(3), json.size() - i));
+			while (parser_t::PENDING == res)
+				res = fed.feed(json.data(), 0);
+			CPPUNIT_ASSERT(parser_t::OK == res);
+			std::ostringstream fed_os;
+			fed_os << *fed.handler().root();
+			CPPUNIT_ASSERT(os.str() == fed_os.str());
+			CPPUNIT_ASSERT(0 != a.used());
+			a.reset();
+			CPPUNIT_ASSERT(0 == a.used());
+		}
+		// the second pass is served from the blocks kept by reset
+		if (0 == pass)
+			capacity = a.capacity();
+		else
+			CPPUNIT_ASSERT(capacity == a.capacity());
+	}
+
+	json::arena b;
+	parser_t parser((json::arena_builder(b)));
+	std::string json("{\"k\" : [1, \"two\", {\"three\" : 3}]}");
+	CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+	const json::arena_node *r = parser.handler().root();
+	CPPUNIT_ASSERT(json::arena_node::OBJECT_NODE == r->kind() && 1 == r->size());
+	const json::arena_node *k = r->first();
+	CPPUNIT_ASSERT(std::string("k") == std::string(k->key(), k->key_size()));
+	CPPUNIT_ASSERT(json::arena_node::ARRAY_NODE == k->kind() && 3 == k->size() && 0 == k->next());
+	CPPUNIT_ASSERT(1 == k->first()->number());
+	CPPUNIT_ASSERT(std::string("two") == std::string(k->first()->next()->data(), k->first()->next()->size()));
+	CPPUNIT_ASSERT(json::arena_node::OBJECT_NODE == k->first()->next()->next()->kind());
+
+	// the containers of a document that failed halfway are dropped with the parser, before the arena
+	json = "{\"a\" : [1, {\"b\" : [2";
+	parser.reset();
+	CPPUNIT_ASSERT(parser_t::ERROR == parser.parse(json.data(), json.size()));
+	parser.reset();
+	CPPUNIT_ASSERT(0 == parser.handler().root());
+	b.reset();
+	json = "[true]";
+	CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+	r = parser.handler().root();
+	CPPUNIT_ASSERT(json::arena_node::ARRAY_NODE == r->kind() && 1 == r->size());
+	std::ostringstream after;
+	after << *r;
+	CPPUNIT_ASSERT(parse_whole_to_string(json) == after.str());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_tape() {
+	const char *docs[] = {
+		"{}",
+		"[]",
+		"{\"a\" : 1, \"b\" : [2.5, {\"c\" : \"x\\ny\"}, [], {}], \"\" : {\"e\" : {}, \"f\" : null}}",
+		"[true, false, null, -3, \"\", \"a\\u0041\", [[[\"deep\"]]]]"
+	};
+	typedef json::parser<char, json::tape_builder> parser_t;
+	json::tape t;
+	for (size_t d = 0; d < sizeof(docs) / sizeof(docs[0]); ++d) {
+		const std::string json(docs[d]);
+		parser_t whole((json::tape_builder(t)));
+		CPPUNIT_ASSERT(parser_t::OK == whole.parse(json.data(), json.size()));
+		std::ostringstream os;
+		os << t;
+		CPPUNIT_ASSERT(parse_whole_to_string(json) == os.str());
+
+		parser_t fed((json::tape_builder(t)));
+		parser_t::result_t res = parser_t::PENDING;
+		for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += 3)
+			res = fed.feed(json.data() + i, std::min(static_cast<size_t>(3), json.size() - i));
+		while (parser_t::PENDING == res)
+			res = fed.feed(json.data(), 0);
+		CPPUNIT_ASSERT(parser_t::OK == res);
+		std::ostringstream fed_os;
+		fed_os << t;
+		CPPUNIT_ASSERT(os.str() == fed_os.str());
+	}
+
+	std::string json("{\"k\" : [1, \"two\", {\"three\" : 3}, 12345678901234567890], \"l\" : -9223372036854775808}");
+	parser_t parser((json::tape_builder(t)));
+	CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+	json::tape_cursor r = t.root();
+	CPPUNIT_ASSERT(json::tape::OBJECT_START == r.tag() && 2 == r.size());
+	CPPUNIT_ASSERT(t.size() - 1 == r.end().index() && r.end().at_end());
+	json::tape_cursor k = r.first();
+	CPPUNIT_ASSERT(std::string("k") == k.string().str());
+	json::tape_cursor a = k.next();
+	CPPUNIT_ASSERT(json::tape::ARRAY_START == a.tag() && 4 == a.size());
+	json::tape_cursor e = a.first();
+	CPPUNIT_ASSERT(json::tape::INT64 == e.tag() && 1 == e.integer());
+	e = e.next();
+	CPPUNIT_ASSERT(std::string("two") == e.string().str());
+	e = e.next();
+	CPPUNIT_ASSERT(json::tape::OBJECT_START == e.tag() && 1 == e.size());
+	// the object is skipped at once
+	e = e.next();
+	CPPUNIT_ASSERT(json::tape::DOUBLE == e.tag() && 12345678901234567890.0 == e.number());
+	CPPUNIT_ASSERT(e.next().at_end());
+	json::tape_cursor l = a.next();
+	CPPUNIT_ASSERT(std::string("l") == l.string().str());
+	CPPUNIT_ASSERT(json::tape::INT64 == l.next().tag() && INT64_MIN == l.next().integer());
+	CPPUNIT_ASSERT(l.next().next().index() == r.end().index());
+
+	// a document that failed halfway does not leak into the next one
+	json = "{\"a\":[1,2";
+	parser.reset();
+	CPPUNIT_ASSERT(parser_t::ERROR == parser.parse(json.data(), json.size()));
+	parser.reset();
+	json = "[true]";
+	CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+	CPPUNIT_ASSERT(3 == t.size() && 2 == t.root().end().index() && 1 == t.root().size());
+	std::ostringstream after;
+	after << t;
+	CPPUNIT_ASSERT(parse_whole_to_string(json) == after.str());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_bind() {
+	const json::field<bound_t> fields[] = {
+		json::make_field("id", &bound_t::id),
+		json::make_field("count", &bound_t::count),
+		json::make_field("ratio", &bound_t::ratio),
+		json::make_field("on", &bound_t::on),
+		json::make_field("label", &bound_t::label)
+	};
+	// unknown keys, nested values and values of the wrong type are skipped
+	const std::string json("{\"ratio\" : 2, \"x\" : {\"id\" : 5, \"label\" : \"no\"}, \"id\" : -12345678901,"
+		" \"on\" : true, \"l\\u0061bel\" : \"a\\tb\", \"count\" : 99999999999, \"list\" : [{\"on\" : false}], \"\" : 1}");
+	typedef json::parser<char, json::binder<bound_t> > parser_t;
+	for (unsigned int k = 0; k < 2; ++k) {
+		bound_t b;
+		b.id = 0;
+		b.count = 7;
+		b.ratio = 0;
+		b.on = false;
+		parser_t parser((json::binder<bound_t>(b, fields)));
+		if (0 == k)
+			CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+		else {
+			typename parser_t::result_t res = parser_t::PENDING;
+			for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += 2)
+				res = parser.feed(json.data() + i, std::min(static_cast<size_t>(2), json.size() - i));
+			while (parser_t::PENDING == res)
+				res = parser.feed(json.data(), 0);
+			CPPUNIT_ASSERT(parser_t::OK == res);
+		}
+		CPPUNIT_ASSERT(-12345678901LL == b.id);
+		CPPUNIT_ASSERT(7 == b.count);
+		CPPUNIT_ASSERT(2 == b.ratio);
+		CPPUNIT_ASSERT(b.on);
+		CPPUNIT_ASSERT(std::string("a\tb") == b.label);
+	}
+
+	// a document that failed does not shift the next one once the parser is reset
+	bound_t r;
+	r.id = 0;
+	parser_t reused((json::binder<bound_t>(r, fields)));
+	const std::string bad("{\"id\" : 1, ]"), good("{\"id\" : 42}");
+	CPPUNIT_ASSERT(parser_t::ERROR == reused.parse(bad.data(), bad.size()) && 1 == r.id);
+	reused.reset();
+	CPPUNIT_ASSERT(parser_t::OK == reused.parse(good.data(), good.size()) && 42 == r.id);
+
+	const json::field<bound_t> duplicate[] = {
+		json::make_field("id", &bound_t::id),
+		json::make_field("id", &bound_t::count)
+	};
+	bound_t b;
+	bool thrown = false;
+	try {
+		json::binder<bound_t> binder(b, duplicate);
+	} catch (const std::logic_error&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::key_id_cb(int id, void *ctx) {
+	reinterpret_cast<std::vector<int> *>(ctx)->push_back(id);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_key_table() {
+	json::key_table<char> t(3);
+	CPPUNIT_ASSERT(0 == t.intern("a", 1));
+	CPPUNIT_ASSERT(1 == t.intern("ab", 2));
+	CPPUNIT_ASSERT(0 == t.intern("a", 1));
+	CPPUNIT_ASSERT(2 == t.intern("", 0));
+	// the table is full
+	CPPUNIT_ASSERT(json::key_table<char>::NO_KEY == t.intern("b", 1));
+	CPPUNIT_ASSERT(json::key_table<char>::NO_KEY == t.find("b", 1));
+	CPPUNIT_ASSERT(1 == t.find("ab", 2));
+	CPPUNIT_ASSERT(1 == t.intern(json::string_ref<char>("\\u0061b", 7, true)));
+	CPPUNIT_ASSERT(std::string("ab") == t.name(1) && 3 == t.size());
+	t.clear();
+	CPPUNIT_ASSERT(0 == t.size() && json::key_table<char>::NO_KEY == t.find("a", 1));
+
+	// the IDs are shared by the documents
+	json::key_table<char> keys;
+	std::vector<int> log;
+	const std::string docs[] = {
+		"{\"id\" : 1, \"name\" : {\"id\" : 2}}",
+		"{\"name\" : \"x\", \"id\" : [{\"other\" : 3}]}"
+	};
+	for (unsigned int d = 0; d < 2; ++d) {
+		json::parser<char> parser;
+		parser.set_key_table(&keys);
+		parser.hook_key_id(&key_id_cb);
+		parser.set_context(&log);
+		CPPUNIT_ASSERT(json::parser<char>::OK == parser.parse(docs[d].data(), docs[d].size()));
+	}
+	const int expected[] = {0, 1, 0, 1, 0, 2};
+	CPPUNIT_ASSERT(std::vector<int>(expected, expected + sizeof(expected) / sizeof(expected[0])) == log);
+
+	// the arena DOM points to the text of the table
+	typedef json::parser<char, json::arena_builder> parser_t;
+	json::arena a;
+	const char *name = 0;
+	for (unsigned int d = 0; d < 2; ++d) {
+		parser_t parser((json::arena_builder(a, &keys)));
+		CPPUNIT_ASSERT(parser_t::OK == parser.parse(docs[d].data(), docs[d].size()));
+		std::ostringstream os;
+		os << *parser.handler().root();
+		CPPUNIT_ASSERT(parse_whole_to_string(docs[d]) == os.str());
+		const json::arena_node *n = parser.handler().root()->first();
+		if (1 == d)
+			n = n->next();
+		CPPUNIT_ASSERT(json::arena_node::NUMBER_NODE == n->kind() || json::arena_node::ARRAY_NODE == n->kind());
+		CPPUNIT_ASSERT(0 == n->key_id() && keys.name(0).data() == n->key());
+		CPPUNIT_ASSERT(0 == name || name == n->key());
+		name = n->key();
+		a.reset();
+	}
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_find_key() {
+	// the small object is searched linearly, the large one through the index
+	for (int size = 4; size <= 40; size += 36) {
+		json::obj_list_node o;
+		std::vector<const json::obj_node *> pairs;
+		for (int i = size - 1; i >= 0; --i) {
+			std::ostringstream k;
+			k << "key" << i;
+			pairs.push_back(new json::obj_node(k.str()));
+			o.add(pairs.back());
+		}
+		// the same pairs are found before and after the index is built
+		for (int indexed = 0; indexed < 2; ++indexed) {
+			CPPUNIT_ASSERT(pairs[size - 1] == o.find("key0"));
+			CPPUNIT_ASSERT(pairs[0] == o.find(pairs[0]->name()));
+			CPPUNIT_ASSERT(0 == o.find("key"));
+			CPPUNIT_ASSERT(0 == o.find("new"));
+			o.index_keys();
+		}
+		// adding a pair drops the index, the first pair of a key is found
+		json::obj_node *fresh = new json::obj_node("new");
+		o.add(fresh);
+		o.add(new json::obj_node("new"));
+		CPPUNIT_ASSERT(fresh == o.find("new"));
+		o.index_keys();
+		CPPUNIT_ASSERT(fresh == o.find("new"));
+		CPPUNIT_ASSERT(pairs[size / 2] == o.find(pairs[size / 2]->name()));
+	}
+
+	const std::string json("{\"a\" : 1, \"bb\" : {\"a\" : [2, 3]}, \"b\" : \"x\", \"a\" : 4}");
+	json::key_table<char> keys;
+	json::arena a;
+	json::parser<char, json::arena_builder> arena_parser((json::arena_builder(a, &keys)));
+	CPPUNIT_ASSERT(arena_parser.OK == arena_parser.parse(json.data(), json.size()));
+	const json::arena_node *r = arena_parser.handler().root();
+	CPPUNIT_ASSERT(1 == r->find("a", 1)->number());
+	CPPUNIT_ASSERT(json::arena_node::STRING_NODE == r->find("b", 1)->kind());
+	CPPUNIT_ASSERT(0 == r->find("c", 1));
+	CPPUNIT_ASSERT(r->find("bb", 2) == r->find(keys.find("bb", 2)));
+	CPPUNIT_ASSERT(2 == r->find("bb", 2)->find(keys.find("a", 1))->size());
+	CPPUNIT_ASSERT(0 == r->find(keys.find("c", 1)));
+
+	json::tape t;
+	json::parser<char, json::tape_builder> tape_parser((json::tape_builder(t)));
+	CPPUNIT_ASSERT(tape_parser.OK == tape_parser.parse(json.data(), json.size()));
+	json::tape_cursor c = t.root();
+	CPPUNIT_ASSERT(1 == c.find("a", 1).integer());
+	CPPUNIT_ASSERT(std::string("x") == c.find("b", 1).string().str());
+	CPPUNIT_ASSERT(2 == c.find("bb", 2).find("a", 1).size());
+	CPPUNIT_ASSERT(c.find("c", 1).at_end() && c.end().index() == c.find("c", 1).index());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::match_cb(size_t id, const json::string_ref<Char>& v, int term, void *ctx) {
+	std::ostringstream os;
+	os << id << '=' << (json::scanner<Char>::L_BRACE == term ? "{" : json::scanner<Char>::L_BRACKET == term ? "[" : v.str()) << ' ';
+	reinterpret_cast<std::string *>(ctx)->append(os.str());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_path_filter() {
+	// the skipped containers hold tokens that do not scan, they must not be tokenized
+	const std::string json("{\"big\" : {\"x\" : [tru, 1.2.3, \"]}\\\"\"], \"y\" : {}}, \"store\" : {\"book\" : ["
+		"{\"title\" : \"A\", \"isbn\" : [1, {\"}\" : 2}]}, {\"t\\u0069tle\" : \"B\", \"price\" : 3}, [\"not a book\"]],"
+		" \"a/b\" : {\"~\" : true}}, \"last\" : [[0, 1], [2, [tru]]]}");
+	typedef json::parser<char, json::path_filter<char> > parser_t;
+	for (unsigned int k = 0; k < 3; ++k) {
+		std::string log;
+		parser_t parser;
+		CPPUNIT_ASSERT(0 == parser.handler().add("$.store.book[*].title"));
+		CPPUNIT_ASSERT(1 == parser.handler().add("/store/book/1"));
+		CPPUNIT_ASSERT(2 == parser.handler().add("/store/a~1b/~0"));
+		CPPUNIT_ASSERT(3 == parser.handler().add("$['last'][0][1]"));
+		CPPUNIT_ASSERT(4 == parser.handler().add("$.store.book[2][0]"));
+		parser.handler().hook_match(&match_cb);
+		parser.handler().set_context(&log);
+		if (0 == k)
+			CPPUNIT_ASSERT(parser_t::OK == parser.parse(json.data(), json.size()));
+		else {
+			size_t chunk = 1 == k ? 1 : 5;
+			typename parser_t::result_t res = parser_t::PENDING;
+			for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += chunk)
+				res = parser.feed(json.data() + i, std::min(chunk, json.size() - i));
+			while (parser_t::PENDING == res)
+				res = parser.feed(json.data(), 0);
+			CPPUNIT_ASSERT(parser_t::OK == res);
+		}
+		CPPUNIT_ASSERT(std::string("0=A 1={ 0=B 4=not a book 2=true 3=1 ") == log);
+	}
+
+	// the skipped content is not validated but the brackets have to match
+	const std::string bad("{\"a\" : [1, 2}");
+	parser_t whole;
+	whole.handler().add("$.b");
+	CPPUNIT_ASSERT(parser_t::ERROR == whole.parse(bad.data(), bad.size()));
+	parser_t fed;
+	fed.handler().add("$.b");
+	typename parser_t::result_t res = fed.feed(bad.data(), bad.size());
+	while (parser_t::PENDING == res)
+		res = fed.feed(bad.data(), 0);
+	CPPUNIT_ASSERT(parser_t::ERROR == res);
+	const std::string truncated("{\"a\" : [1, 2");
+	parser_t unterminated;
+	unterminated.handler().add("$.b");
+	CPPUNIT_ASSERT(parser_t::PENDING == unterminated.feed(truncated.data(), truncated.size()));
+	CPPUNIT_ASSERT(parser_t::ERROR == unterminated.feed(truncated.data(), 0));
+
+	// an abandoned document leaves nothing behind once the parser is reset
+	std::string log;
+	parser_t reused;
+	reused.handler().add("/a");
+	reused.handler().hook_match(&match_cb);
+	reused.handler().set_context(&log);
+	CPPUNIT_ASSERT(parser_t::PENDING == reused.feed("{\"x\":{\"y\":[1,", 13));
+	reused.reset();
+	const std::string next("{\"a\":42}");
+	CPPUNIT_ASSERT(parser_t::OK == reused.parse(next.data(), next.size()));
+	CPPUNIT_ASSERT(std::string("0=42 ") == log);
+
+	bool thrown = false;
+	try {
+		whole.handler().add("$.a[x]");
+	} catch (const std::invalid_argument&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::document_end_cb(void *ctx) {
+	++*reinterpret_cast<int *>(ctx);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_multi_document() {
+	const std::basic_string<Char> json("{\"a\" : 1}\n[2, {\"b\" : [3]}]\n{}{\"c\" : {\"d\" : null}}[]\n\n{\"e\" : \"x\"}\n");
+	for (unsigned int k = 0; k < 3; ++k) {
+		int documents = 0;
+		json::parser<Char> parser;
+		parser.set_multi_document(true);
+		parser.hook_document_end(&document_end_cb);
+		parser.set_context(&documents);
+		typename json::parser<Char>::result_t res;
+		if (0 == k)
+			res = parser.parse(json.data(), json.size());
+		else {
+			size_t chunk = 1 == k ? 1 : 7;
+			res = json::parser<Char>::PENDING;
+			for (size_t i = 0; i < json.size() && json::parser<Char>::PENDING == res; i += chunk)
+				res = parser.feed(json.data() + i, std::min(chunk, json.size() - i));
+			while (json::parser<Char>::PENDING == res)
+				res = parser.feed(json.data(), 0);
+		}
+		CPPUNIT_ASSERT(json::parser<Char>::OK == res);
+		CPPUNIT_ASSERT(6 == documents);
+	}
+
+	// the handler sees the documents one after the other
+	typedef json::parser<Char, obj_handler_t> parser_t;
+	parser_t handled;
+	handled.set_multi_document(true);
+	CPPUNIT_ASSERT(parser_t::PENDING == handled.feed(json.data(), json.size()));
+	CPPUNIT_ASSERT(parser_t::OK == handled.feed(json.data(), 0));
+	CPPUNIT_ASSERT(0 == handled.handler().depth && 2 == handled.handler().max_depth);
+	CPPUNIT_ASSERT(std::basic_string<Char>("a,b,c,d,e,") == handled.handler().keys);
+
+	// no document is fine, an incomplete or a bad one is not
+	json::parser<Char> empty;
+	empty.set_multi_document(true);
+	CPPUNIT_ASSERT(json::parser<Char>::OK == empty.parse(json.data(), 0));
+	const std::basic_string<Char> incomplete("{}\n{\"a\" : ");
+	json::parser<Char> truncated;
+	truncated.set_multi_document(true);
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == truncated.parse(incomplete.data(), incomplete.size()));
+	const std::basic_string<Char> bad("{}\n2\n");
+	json::parser<Char> junk;
+	junk.set_multi_document(true);
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == junk.parse(bad.data(), bad.size()));
+	// the single-document mode still rejects a second document
+	json::parser<Char> single;
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == single.parse(json.data(), json.size()));
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::block_cb(obj_handler_t& h, typename json::parser<char, obj_handler_t>::result_t res,
+		const char *, size_t, void *ctx) {
+	std::string& log = *reinterpret_cast<std::string *>(ctx);
+	log.append(json::parser<char, obj_handler_t>::OK == res ? h.keys : std::string("!,"));
+	h.keys.clear();
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::throwing_block_cb(obj_handler_t& h, typename json::parser<char, obj_handler_t>::result_t res,
+		const char *p, size_t n, void *ctx) {
+	block_cb(h, res, p, n, ctx);
+	if (reinterpret_cast<std::string *>(ctx)->size() > 100)
+		throw std::runtime_error("consumer");
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_parallel_ndjson() {
+	std::string json, expected;
+	for (int i = 0; i < 500; ++i) {
+		std::ostringstream line;
+		line << "{\"k" << i << "\" : [" << i << ", {\"x\" : true}], \"y\" : " << i << "}\n";
+		json.append(line.str());
+		std::ostringstream keys;
+		keys << "k" << i << ",x,y,";
+		expected.append(keys.str());
+	}
+
+	// blocks of a few lines, more threads than slots so the threads wait for the slots
+	typedef json::parallel_parser<obj_handler_t> parallel_t;
+	parallel_t pp(4, 64, 3);
+	CPPUNIT_ASSERT(4 == pp.threads());
+	std::string log;
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == pp.parse(json.data(), json.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(expected == log);
+	// the parsers are reused
+	log.clear();
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == pp.parse(json.data(), json.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(expected == log);
+	// a callback that throws stops the threads before the exception leaves, the parsers are still reusable
+	bool thrown = false;
+	try {
+		pp.parse(json.data(), json.size(), &throwing_block_cb, &log);
+	} catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+	log.clear();
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == pp.parse(json.data(), json.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(expected == log);
+	// one block
+	parallel_t single(2, json.size());
+	log.clear();
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == single.parse(json.data(), json.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(expected == log);
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == single.parse(json.data(), 0, &block_cb, &log));
+
+	// a bad block fails the parse, the others are still delivered in order
+	const std::string bad("{\"a\" : 1}\n{\"b\" : }\n{\"c\" : 2}\n");
+	parallel_t lines(2, 1);
+	log.clear();
+	CPPUNIT_ASSERT(parallel_t::parser_t::ERROR == lines.parse(bad.data(), bad.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(std::string("a,!,c,") == log);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_parallel_array() {
+	std::string json("[\n"), expected;
+	for (int i = 0; i < 500; ++i) {
+		std::ostringstream element, keys;
+		if (0 == i % 3) {
+			element << "{\"k" << i << "\" : [" << i << ", {\"x\" : \"],\"}]}";
+			keys << "k" << i << ",x,";
+		} else
+			element << (i % 3 == 1 ? "\"{,\"" : "[[-1.5], [], true]");
+		json.append(element.str()).append(499 == i ? "\n]\n" : ",\n");
+		expected.append(keys.str());
+	}
+
+	typedef json::parallel_parser<obj_handler_t> parallel_t;
+	parallel_t pp(4, 100, 3);
+	std::string log;
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == pp.parse_array(json.data(), json.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(expected == log);
+	// one element per range, the ranges exclude the commas
+	const std::string small("[{\"a\" : 1}, 2 ,{\"b\" : [{\"c\" : 3}]}]");
+	parallel_t each(2, 1);
+	log.clear();
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == each.parse_array(small.data(), small.size(), &block_cb, &log));
+	CPPUNIT_ASSERT(std::string("a,b,c,") == log);
+	// no range
+	log.clear();
+	CPPUNIT_ASSERT(parallel_t::parser_t::OK == each.parse_array(" [ ] ", 5, &block_cb, &log));
+	CPPUNIT_ASSERT(log.empty());
+
+	// not one array, or a bad element
+	const char *bad[] = {"", "{}", "[1,]", "[1,,2]", "[,1]", "[1] [2]", "[1]]", "[[1]", "[1] 2", "[{\"a\" 1}]", "[\"a]"};
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+		CPPUNIT_ASSERT(parallel_t::parser_t::ERROR == each.parse_array(bad[i], strlen(bad[i]), &block_cb, &log));
+
+	// a single parser does the same for one range
+	json::structural_index<char> index;
+	CPPUNIT_ASSERT(index.build(small.data(), small.size()));
+	json::parser<char, obj_handler_t> elements;
+	CPPUNIT_ASSERT(elements.OK == elements.parse_elements(small.data(), small.size(), index, 1, index.size() - 1));
+	CPPUNIT_ASSERT(std::string("a,b,c,") == elements.handler().keys);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_parse_file() {
+	char path[] = "/tmp/test_json_parser.XXXXXX";
+	int fd = mkstemp(path);
+	CPPUNIT_ASSERT(fd >= 0);
+	close(fd);
+	const std::string json("{\"a\" : [1, {\"b\" : \"x\"}], \"c\" : null}\n");
+	std::ofstream(path).write(json.data(), json.size());
+
+	json::mapped_file file;
+	file.open(path);
+	CPPUNIT_ASSERT(json.size() == file.size() && 0 == json.compare(0, json.size(), file.data(), file.size()));
+	file.close();
+	CPPUNIT_ASSERT(0 == file.data() && 0 == file.size());
+
+	json::parser<char, obj_handler_t> parser;
+	CPPUNIT_ASSERT(parser.OK == parser.parse_file(path));
+	CPPUNIT_ASSERT(std::string("a,b,c,") == parser.handler().keys);
+	CPPUNIT_ASSERT(std::string("x,null,") == parser.handler().data);
+	// every call parses a new document
+	CPPUNIT_ASSERT(parser.OK == parser.parse_file(path) && parser.NONE == parser.error());
+	CPPUNIT_ASSERT(std::string("a,b,c,a,b,c,") == parser.handler().keys);
+
+	// a file of wide characters is a whole number of them
+	const std::string odd(2 * sizeof(wchar_t) - 1, ' ');
+	std::ofstream(path, std::ios::trunc).write(odd.data(), odd.size());
+	json::parser<wchar_t> wide;
+	CPPUNIT_ASSERT(wide.ERROR == wide.parse_file(path) && wide.ENCODING == wide.error());
+
+	// an empty file holds no document
+	std::ofstream(path, std::ios::trunc).close();
+	json::parser<char> empty;
+	CPPUNIT_ASSERT(empty.ERROR == empty.parse_file(path));
+	unlink(path);
+
+	bool thrown = false;
+	try {
+		json::parser<char> missing;
+		missing.parse_file(path);
+	} catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_feed_consumed_finish() {
+	typedef json::parser<Char, obj_handler_t> parser_t;
+	const std::basic_string<Char> head("{\"a\" : 12"), tail("3}");
+	parser_t parser;
+	size_t consumed = 0;
+	CPPUNIT_ASSERT(parser_t::PENDING == parser.feed(head.data(), head.size(), consumed));
+	CPPUNIT_ASSERT(head.size() == consumed);
+	// the start of the number is kept for the next chunk
+	CPPUNIT_ASSERT(2 == parser.buffered());
+	CPPUNIT_ASSERT(parser_t::PENDING == parser.feed(tail.data(), tail.size(), consumed));
+	CPPUNIT_ASSERT(tail.size() == consumed);
+	CPPUNIT_ASSERT(parser_t::OK == parser.finish());
+	CPPUNIT_ASSERT(std::basic_string<Char>("123,") == parser.handler().data);
+
+	// one call ends the input, however many empty chunks it takes
+	const std::basic_string<Char> empty_obj("{}");
+	json::parser<Char> whole;
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == whole.feed(empty_obj.data(), empty_obj.size()));
+	CPPUNIT_ASSERT(json::parser<Char>::OK == whole.finish());
+	json::parser<Char> truncated;
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == truncated.feed(head.data(), head.size()));
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == truncated.finish());
+
+	// an error tells where it was detected
+	const std::basic_string<Char> bad("{\"a\" ]xyz");
+	json::parser<Char> error;
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == error.feed(bad.data(), bad.size(), consumed));
+	CPPUNIT_ASSERT(6 == consumed);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_writer() {
+	std::string out("x");
+	json::writer w(out);
+	w.obj_start();
+	w.key("a\"b", 3);
+	w.array_start();
+	w.string("q\"\\\n\x01\xc3\xa9", 7);
+	w.integer(-9223372036854775807LL - 1);
+	w.number(0.1);
+	w.number(13);
+	w.number(1.0 / 3);
+	w.boolean(false);
+	w.null();
+	w.obj_start();
+	w.obj_end();
+	w.array_end();
+	w.key("", 0);
+	w.raw("1.50", 4);
+	w.obj_end();
+	// the string is appended to
+	CPPUNIT_ASSERT(std::string("x{\"a\\\"b\":[\"q\\\"\\\\\\n\\u0001\xc3\xa9\",-9223372036854775808,0.1,13,"
+		"0.3333333333333333,false,null,{}],\"\":1.50}") == out);
+
+	// doubles read back to the same value
+	const double doubles[] = {5e-324, 1.7976931348623157e308, 1e21, -0.0, 123456.789, 2.5e-7, 9007199254740993.0};
+	for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); ++i) {
+		std::string t;
+		json::writer::format(t, doubles[i]);
+		double d = 0;
+		CPPUNIT_ASSERT(json::parse_double(t.data(), t.size(), d) && d == doubles[i]);
+	}
+	// with the fewest digits
+	const char *shortest[] = {"5e-324", "1.7976931348623157e+308", "1e+21", "-0", "123456.789", "2.5e-07", "9007199254740992"};
+	for (size_t i = 0; i < sizeof(doubles) / sizeof(doubles[0]); ++i) {
+		std::string t;
+		json::writer::format(t, doubles[i]);
+		CPPUNIT_ASSERT(std::string(shortest[i]) == t);
+	}
+	std::string special;
+	json::writer::format(special, std::numeric_limits<double>::quiet_NaN());
+	json::writer::format(special, std::numeric_limits<double>::infinity());
+	CPPUNIT_ASSERT(std::string("nullnull") == special);
+
+	// the parser drives the writer with no DOM, the output is valid JSON whatever the escapes of the input
+	const std::string json("{ \"a\\u0041\" : [1.50, \"x\\\"y\", true, null, {}, -0], \"\\/\" : {\"c\" : [[]]}}");
+	const std::string compact("{\"aA\":[1.50,\"x\\\"y\",true,null,{},-0],\"/\":{\"c\":[[]]}}");
+	for (size_t chunk = 1; chunk <= json.size(); chunk += json.size() - 1) {
+		json::writer pass;
+		typedef json::parser<char, json::write_handler> parser_t;
+		parser_t parser((json::write_handler(pass)));
+		parser_t::result_t res = parser_t::PENDING;
+		for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += chunk)
+			res = parser.feed(json.data() + i, std::min(chunk, json.size() - i));
+		if (parser_t::PENDING == res)
+			res = parser.finish();
+		CPPUNIT_ASSERT(parser_t::OK == res);
+		CPPUNIT_ASSERT(compact == pass.str());
+	}
+	// the numbers that the scanner accepts beyond the grammar are written again, the other ones are copied
+	const std::string lenient("[+1.3e+1, .8, 1., -.5e1, +7, 1E+2, 0.10, 12345678901234567890]");
+	json::writer normal;
+	json::parser<char, json::write_handler> normalizer((json::write_handler(normal)));
+	CPPUNIT_ASSERT(normalizer.OK == normalizer.parse(lenient.data(), lenient.size()));
+	CPPUNIT_ASSERT(std::string("[13,0.8,1,-5,7,1E+2,0.10,12345678901234567890]") == normal.str());
+
+	// printed DOM trees parse again
+	const std::string quoted("[\"a\\\"b\\u0001\", 0.30000000000000004]");
+	const std::string printed(parse_whole_to_string(quoted));
+	CPPUNIT_ASSERT(std::string("[\"a\\\"b\\u0001\", 0.30000000000000004]") == printed);
+	CPPUNIT_ASSERT(printed == parse_whole_to_string(printed));
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_stats() {
+	const std::basic_string<Char> json("{\"a\" : [1, 2.5, \"xyz\"], \"b\" : {\"c\" : 1e+}}");
+	json::parser<Char> parser;
+	// "1e+" is given back: the 'e' and the '+' were read before the last chunk
+	const size_t cut = json.find(static_cast<Char>('+')) + 1;
+	CPPUNIT_ASSERT(json::parser<Char>::PENDING == parser.feed(json.data(), cut));
+	CPPUNIT_ASSERT(json::parser<Char>::ERROR == parser.feed(json.data() + cut, json.size() - cut));
+	json::stats s = parser.stats();
+	if (!json::stats::enabled) {
+		CPPUNIT_ASSERT(0 == s.bytes && 0 == s.chunks && 0 == s.max_depth && 0 == s.tokens[json::scanner<Char>::STRING]);
+		return;
+	}
+	CPPUNIT_ASSERT(json.size() == s.bytes && 2 == s.chunks && 1 == s.resumptions);
+	// the 1 of "1e+" is the second integer
+	CPPUNIT_ASSERT(4 == s.tokens[json::scanner<Char>::STRING] && 2 == s.tokens[json::scanner<Char>::INTEGER]);
+	CPPUNIT_ASSERT(1 == s.tokens[json::scanner<Char>::DOUBLE] && 2 == s.tokens[json::scanner<Char>::L_BRACE]);
+	CPPUNIT_ASSERT(2 == s.unget_bytes && s.copied_bytes >= 3 && s.max_depth > 2);
+
+	// the whole-buffer mode counts as well, the counters add up until they are cleared
+	parser.clear_stats();
+	const std::basic_string<Char> valid("[[[1]], {}]");
+	json::parser<Char> whole;
+	CPPUNIT_ASSERT(json::parser<Char>::OK == whole.parse(valid.data(), valid.size()));
+	CPPUNIT_ASSERT(valid.size() == whole.stats().bytes && 0 == whole.stats().chunks && 3 <= whole.stats().max_depth);
+	CPPUNIT_ASSERT(0 == parser.stats().bytes && 0 == parser.stats().tokens[json::scanner<Char>::STRING]);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_memory_resource() {
+	std::basic_string<Char> json("{\"key\" : \"");
+	json.append(100, static_cast<Char>('v')).append("\", \"n\" : 12345}");
+	counting_resource_t r;
+	{
+		// the tokens that span chunks are buffered through the resource
+		json::parser<Char> parser(&r);
+		typename json::parser<Char>::result_t res = json::parser<Char>::PENDING;
+		for (size_t i = 0; i < json.size() && json::parser<Char>::PENDING == res; i += 7)
+			res = parser.feed(json.data() + i, std::min(static_cast<size_t>(7), json.size() - i));
+		CPPUNIT_ASSERT(json::parser<Char>::OK == parser.finish());
+		CPPUNIT_ASSERT(0 < r.allocations && 0 < r.live);
+
+		// and so is the structural index
+		size_t before = r.allocations;
+		json::parser<Char> whole(&r);
+		CPPUNIT_ASSERT(json::parser<Char>::OK == whole.parse(json.data(), json.size()));
+		CPPUNIT_ASSERT(before < r.allocations);
+	}
+	CPPUNIT_ASSERT(0 == r.live);
+
+	// a tape and its parser served by one pool, whose blocks come from r
+	const std::string doc("{\"a\" : [1, \"two\", {\"three\" : 3.5}], \"b\" : \"a string that is longer than any small buffer\"}");
+	typedef json::parser<char, json::tape_builder> parser_t;
+	r.allocations = 0;
+	{
+		json::arena_resource pool(256, &r);
+		json::tape t(&pool);
+		parser_t parser(json::tape_builder(t), &pool);
+		CPPUNIT_ASSERT(parser_t::OK == parser.parse(doc.data(), doc.size()));
+		CPPUNIT_ASSERT(0 < pool.get().used() && 0 < r.allocations && r.allocations <= 8);
+		std::ostringstream os;
+		os << t;
+		CPPUNIT_ASSERT(parse_whole_to_string(std::basic_string<Char>(doc.begin(), doc.end())) == os.str());
+	}
+	CPPUNIT_ASSERT(0 == r.live);
+
+	// allocators compare by resource
+	json::allocator<char> a(&r), b;
+	CPPUNIT_ASSERT(a == json::allocator<int>(&r) && a != b && json::new_delete_resource() == b.resource());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::error_limits() {
+	typedef json::parser<Char> parser_t;
+	json::limits l;
+	l.max_depth = 3;
+	l.max_token = 8;
+	l.max_document = 64;
+
+	const char *ok[] = {"[[[1]]]", "{\"a\" : [{}]}", "[\"abcdef\", 1234567.]", "[\"\\\"abcd\"]"};
+	for (size_t d = 0; d < sizeof(ok) / sizeof(ok[0]); ++d) {
+		const std::basic_string<Char> json(ok[d]);
+		parser_t whole;
+		whole.set_limits(l);
+		CPPUNIT_ASSERT(parser_t::OK == whole.parse(json.data(), json.size()) && parser_t::NONE == whole.error());
+		CPPUNIT_ASSERT(parse_to_string(json, 1) == parse_whole_to_string(json));
+	}
+
+	const struct {
+		const char *json;
+		typename parser_t::error_t error;
+	} bad[] = {
+		{"[[[[1]]]]", parser_t::DEPTH_LIMIT},
+		{"{\"a\" : [{\"b\" : {}}]}", parser_t::DEPTH_LIMIT},
+		{"[\"abcdefg\"]", parser_t::TOKEN_LIMIT},
+		{"[123456789]", parser_t::TOKEN_LIMIT},
+		{"{\"key\" : 1, \"a longer key\" : 2}", parser_t::TOKEN_LIMIT},
+		{"[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19]", parser_t::DOCUMENT_LIMIT},
+		{"[1, 2,]", parser_t::SYNTAX}
+	};
+	for (size_t d = 0; d < sizeof(bad) / sizeof(bad[0]); ++d) {
+		const std::basic_string<Char> json(bad[d].json);
+		parser_t whole;
+		whole.set_limits(l);
+		CPPUNIT_ASSERT(parser_t::ERROR == whole.parse(json.data(), json.size()) && bad[d].error == whole.error());
+		parser_t fed;
+		fed.set_limits(l);
+		typename parser_t::result_t r = parser_t::PENDING;
+		for (size_t i = 0; i < json.size() && parser_t::PENDING == r; i += 3)
+			r = fed.feed(json.data() + i, std::min(static_cast<size_t>(3), json.size() - i));
+		if (parser_t::PENDING == r)
+			r = fed.finish();
+		CPPUNIT_ASSERT(parser_t::ERROR == r && bad[d].error == fed.error());
+		fed.reset();
+		CPPUNIT_ASSERT(parser_t::NONE == fed.error());
+	}
+
+	// an endless string is rejected once it is longer than the limit, before it is buffered further
+	parser_t endless;
+	endless.set_limits(l);
+	CPPUNIT_ASSERT(parser_t::PENDING == endless.feed(std::basic_string<Char>("[\"").data(), 2));
+	typename parser_t::result_t r = parser_t::PENDING;
+	size_t chunks = 0;
+	const Char a = static_cast<Char>('a');
+	for (; parser_t::PENDING == r && chunks < 100; ++chunks) {
+		CPPUNIT_ASSERT(endless.buffered() <= l.max_token);
+		r = endless.feed(&a, 1);
+	}
+	CPPUNIT_ASSERT(parser_t::ERROR == r && parser_t::TOKEN_LIMIT == endless.error() && chunks == l.max_token);
+
+	// the documents of a stream are limited one by one
+	std::basic_string<Char> stream;
+	for (int i = 0; i < 20; ++i)
+		stream.append("[\"abc\", 12, {\"k\" : []}]\n");
+	parser_t multi;
+	multi.set_limits(l);
+	multi.set_multi_document(true);
+	CPPUNIT_ASSERT(parser_t::PENDING == multi.feed(stream.data(), stream.size()) && parser_t::OK == multi.finish());
+	stream.append("[1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19]\n");
+	multi.reset();
+	CPPUNIT_ASSERT(parser_t::ERROR == multi.feed(stream.data(), stream.size()) && parser_t::DOCUMENT_LIMIT == multi.error());
+
+	// once the limits are set, feeding allocates nothing
+	counting_resource_t res;
+	parser_t bounded(&res);
+	bounded.set_limits(l);
+	size_t allocations = res.allocations;
+	for (int pass = 0; pass < 3; ++pass) {
+		const std::basic_string<Char> json("{\"abcdef\" : [\"\\u00e9\", 1.5e+10, 12345678, true]}");
+		bounded.reset();
+		r = parser_t::PENDING;
+		for (size_t i = 0; i < json.size() && parser_t::PENDING == r; i += 1 + pass)
+			r = bounded.feed(json.data() + i, std::min(static_cast<size_t>(1 + pass), json.size() - i));
+		CPPUNIT_ASSERT(parser_t::OK == r || (parser_t::PENDING == r && parser_t::OK == bounded.finish()));
+	}
+	CPPUNIT_ASSERT(allocations == res.allocations);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_unicode() {
+	// surrogate pairs are combined, unpaired surrogates become U+FFFD
+	const char *raw[] = {"\\ud83d\\ude00", "a\\uD83D\\uDE00b", "\\ud83d", "\\ude00x", "\\ud83d\\u0041", "\\u20ac\\u00e9"};
+	const char *expected[] = {"\xf0\x9f\x98\x80", "a\xf0\x9f\x98\x80" "b", "\xef\xbf\xbd", "\xef\xbf\xbdx", "\xef\xbf\xbd" "A",
+		"\xe2\x82\xac\xc3\xa9"};
+	std::basic_string<Char> r;
+	for (unsigned int i = 0; i < sizeof(raw) / sizeof(raw[0]); ++i) {
+		json::scanner<Char>::unescape(raw[i], strlen(raw[i]), r);
+		CPPUNIT_ASSERT(std::basic_string<Char>(expected[i]) == r);
+	}
+
+	// wide characters get code points or UTF-16
+	const std::wstring wraw(L"\\u00e9\\ud83d\\ude00");
+	std::wstring w;
+	json::scanner<wchar_t>::unescape(wraw.data(), wraw.size(), w);
+	if (4 == sizeof(wchar_t))
+		CPPUNIT_ASSERT(2 == w.size() && 0xe9 == w[0] && 0x1f600 == static_cast<unsigned long>(w[1]));
+	else
+		CPPUNIT_ASSERT(3 == w.size() && 0xe9 == w[0] && 0xd83d == w[1] && 0xde00 == w[2]);
+#if __cplusplus >= 201103L
+	const std::u16string u16raw(u"\\u00e9\\ud83d\\ude00");
+	std::u16string u16;
+	json::scanner<char16_t>::unescape(u16raw.data(), u16raw.size(), u16);
+	CPPUNIT_ASSERT(u"\u00e9\U0001F600" == u16);
+	CPPUNIT_ASSERT(u16.data() + u16.size() == json::simd::find_invalid_encoding(u16.data(), u16.data() + u16.size()));
+	u16.erase(2);
+	CPPUNIT_ASSERT(u16.data() + 1 == json::simd::find_invalid_encoding(u16.data(), u16.data() + u16.size()));
+#endif
+
+	// the UTF-8 validation, after runs of ASCII of every length so that every kernel meets the sequences anywhere
+	const char *valid[] = {"\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xef\xbf\xbd", "\xf4\x8f\xbf\xbf", "\xed\x9f\xbf"};
+	const char *invalid[] = {"\x80", "\xff", "\xc0\xaf", "\xc3", "\xe0\x9f\x80", "\xed\xa0\x80", "\xf4\x90\x80\x80",
+		"\xf0\x9f\x98", "\xf5\x80\x80\x80", "\xe4\x41\xad"};
+	const json::simd::isa_t isas[] = {json::simd::SCALAR, json::simd::SSE2, json::simd::AVX2, json::simd::NEON};
+	for (unsigned int i = 0; i < sizeof(isas) / sizeof(isas[0]); ++i) {
+		json::simd::select(isas[i]);
+		for (size_t n = 0; n < 70; n += 3) {
+			for (size_t v = 0; v < sizeof(valid) / sizeof(valid[0]); ++v) {
+				std::string buf(std::string(n, 'a') + valid[v] + std::string(n % 40, 'b') + valid[(v + 1) % 6]);
+				CPPUNIT_ASSERT(buf.data() + buf.size() ==
+					json::simd::find_invalid_encoding(buf.data(), buf.data() + buf.size()));
+			}
+			for (size_t v = 0; v < sizeof(invalid) / sizeof(invalid[0]); ++v) {
+				// the truncated ones at the end, the others followed by more text
+				std::string buf(std::string(n, 'a') + valid[v % 6] + invalid[v]);
+				size_t at = buf.size() - strlen(invalid[v]);
+				CPPUNIT_ASSERT(buf.data() + at == json::simd::find_invalid_encoding(buf.data(), buf.data() + buf.size()));
+				buf.append(40, 'c');
+				CPPUNIT_ASSERT(buf.data() + at == json::simd::find_invalid_encoding(buf.data(), buf.data() + buf.size()));
+			}
+		}
+	}
+	json::simd::select(json::simd::AVX2);
+
+	// the parser validates the strings and the keys as it scans them, whole or fed
+	const std::basic_string<Char> good("{\"k\xc3\xa9y\" : [\"\xf0\x9f\x98\x80\", \"\\ud83d\\ude00\", 1]}");
+	const char *bad[] = {"{\"k\xc3y\" : 1}", "[\"ab\xed\xa0\x80\"]", "[\"\\n\xff\"]"};
+	for (unsigned int i = 0; i < 1 + sizeof(bad) / sizeof(bad[0]); ++i) {
+		const std::basic_string<Char> json(0 == i ? good : std::basic_string<Char>(bad[i - 1]));
+		typename json::parser<Char>::result_t expected = 0 == i ? json::parser<Char>::OK : json::parser<Char>::ERROR;
+		json::parser<Char> lax;
+		CPPUNIT_ASSERT(json::parser<Char>::OK == lax.parse(json.data(), json.size()));
+		json::parser<Char> whole;
+		whole.set_validate_encoding(true);
+		CPPUNIT_ASSERT(expected == whole.parse(json.data(), json.size()));
+		json::parser<Char> fed;
+		fed.set_validate_encoding(true);
+		typename json::parser<Char>::result_t res = json::parser<Char>::PENDING;
+		for (size_t j = 0; j < json.size() && json::parser<Char>::PENDING == res; ++j)
+			res = fed.feed(json.data() + j, 1);
+		if (json::parser<Char>::PENDING == res)
+			res = fed.finish();
+		CPPUNIT_ASSERT(expected == res);
+		if (0 != i)
+			CPPUNIT_ASSERT(json::parser<Char>::ENCODING == whole.error() && json::parser<Char>::ENCODING == fed.error());
+	}
+	CPPUNIT_ASSERT("{\"k\xc3\xa9y\" : [\"\xf0\x9f\x98\x80\", \"\xf0\x9f\x98\x80\", 1]}" == parse_whole_to_string(good));
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_on_demand() {
+	typedef json::element<Char> element_t;
+	typedef json::scanner<Char> scanner_t;
+	const std::basic_string<Char> json("{\"user\" : {\"id\" : 12345, \"name\" : \"a\\\"b\", \"tags\" : [\"x\", \"y\"], "
+		"\"score\" : 2.5e1, \"ok\" : true, \"nil\" : null}, \"big\" : [1, [2, [3]], {\"a\" : {\"b\" : 4}}, {}], "
+		"\"k\\u0041\" : -1, \"bad\" : tru, \"huge\" : 12345678901234567890}");
+	counting_resource_t r;
+	json::document<Char> doc(&r);
+	CPPUNIT_ASSERT(doc.load(json.data(), json.size()));
+	size_t allocations = r.allocations;
+
+	// the lookups and the raw reads allocate nothing
+	CPPUNIT_ASSERT(12345 == doc[std::basic_string<Char>("user")][std::basic_string<Char>("id")].get_int64());
+	element_t user = doc.root()[std::basic_string<Char>("user")];
+	CPPUNIT_ASSERT(user.is_object() && 6 == user.size() && scanner_t::L_BRACE == user.type());
+	CPPUNIT_ASSERT(25.0 == user[std::basic_string<Char>("score")].get_double());
+	CPPUNIT_ASSERT(12345.0 == user[std::basic_string<Char>("id")].get_double());
+	CPPUNIT_ASSERT(user[std::basic_string<Char>("ok")].get_bool() && user[std::basic_string<Char>("nil")].is_null());
+	json::string_ref<Char> name = user[std::basic_string<Char>("name")].get_string_ref();
+	CPPUNIT_ASSERT(name.escaped() && json.data() < name.data() && name.data() + name.size() < json.data() + json.size());
+	element_t tags = user[std::basic_string<Char>("tags")];
+	CPPUNIT_ASSERT(tags.is_array() && 2 == tags.size() && !tags.at(2).exists());
+	element_t big = doc[std::basic_string<Char>("big")];
+	CPPUNIT_ASSERT(4 == big.size() && 4 == big.at(2)[std::basic_string<Char>("a")][std::basic_string<Char>("b")].get_int64());
+	CPPUNIT_ASSERT(scanner_t::L_BRACKET == big.at(1).at(1).type() && 3 == big.at(1).at(1).at(0).get_int64());
+	CPPUNIT_ASSERT(0 == big.at(3).size() && !big.at(3).first().exists() && !big.at(4).exists());
+	CPPUNIT_ASSERT(allocations == r.allocations);
+
+	// decoded strings and escaped keys
+	CPPUNIT_ASSERT(std::basic_string<Char>("a\"b") == name.str());
+	CPPUNIT_ASSERT(std::basic_string<Char>("y") == tags.at(1).get_string());
+	CPPUNIT_ASSERT(-1 == doc[std::basic_string<Char>("kA")].get_int64());
+
+	// the members in turn: the keys and the values alternate
+	std::basic_string<Char> keys;
+	for (element_t k = user.first(); k.exists(); k = k.next().next())
+		keys.append(k.get_string()).append(1, static_cast<Char>(scanner_t::STRING == k.next().type() ? '"' : ','));
+	CPPUNIT_ASSERT(std::basic_string<Char>("id,name\"tags,score,ok,nil,") == keys);
+
+	// missing values propagate to the end of the chain, the getters throw on them and on the wrong kinds
+	element_t missing = doc[std::basic_string<Char>("nope")][std::basic_string<Char>("id")];
+	CPPUNIT_ASSERT(!missing.exists() && scanner_t::ERROR == missing.type() && !tags[std::basic_string<Char>("x")].exists());
+	CPPUNIT_ASSERT(scanner_t::ERROR == doc[std::basic_string<Char>("bad")].type());
+	bool thrown[5] = {false, false, false, false, false};
+	try { missing.get_int64(); } catch (const std::runtime_error&) { thrown[0] = true; }
+	try { user[std::basic_string<Char>("name")].get_int64(); } catch (const std::runtime_error&) { thrown[1] = true; }
+	try { user[std::basic_string<Char>("score")].get_int64(); } catch (const std::runtime_error&) { thrown[2] = true; }
+	try { doc[std::basic_string<Char>("bad")].get_bool(); } catch (const std::runtime_error&) { thrown[3] = true; }
+	try { doc[std::basic_string<Char>("huge")].get_int64(); } catch (const std::runtime_error&) { thrown[4] = true; }
+	for (unsigned int i = 0; i < sizeof(thrown) / sizeof(thrown[0]); ++i)
+		CPPUNIT_ASSERT(thrown[i]);
+	CPPUNIT_ASSERT(12345678901234567890.0 == doc[std::basic_string<Char>("huge")].get_double());
+
+	// the root may be any value, a buffer that ends in a string is rejected
+	const std::basic_string<Char> array("[true, \"s\"]"), unterminated("{\"a\" : \"b");
+	CPPUNIT_ASSERT(doc.load(array.data(), array.size()) && 2 == doc.root().size() && doc.root().at(0).get_bool());
+	CPPUNIT_ASSERT(!doc[std::basic_string<Char>("a")].exists());
+	CPPUNIT_ASSERT(!doc.load(unterminated.data(), unterminated.size()));
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_checkpoint() {
+	typedef json::parser<char, json::write_handler> parser_t;
+	// every character is a chunk, after which the document moves to the other parser
+	const std::string json("{\"a\\u00e9\" : [1.5e+3, -0, \"x\\\"y\", true, null, {}, [[]]], \"b\" : {\"c\" : false}}  ");
+	json::writer whole, w;
+	parser_t reference((json::write_handler(whole)));
+	CPPUNIT_ASSERT(parser_t::OK == reference.parse(json.data(), json.size()));
+	parser_t one((json::write_handler(w))), other((json::write_handler(w)));
+	parser_t *from = &one, *to = &other;
+	size_t largest = 0;
+	for (size_t i = 0; i < json.size(); ++i) {
+		CPPUNIT_ASSERT(parser_t::PENDING == from->feed(json.data() + i, 1));
+		std::string checkpoint = from->checkpoint();
+		largest = std::max(largest, checkpoint.size());
+		CPPUNIT_ASSERT(to->restore(checkpoint) && to->buffered() == from->buffered());
+		std::swap(from, to);
+	}
+	CPPUNIT_ASSERT(parser_t::OK == from->finish());
+	// a few bytes per level of nesting and the buffered token
+	CPPUNIT_ASSERT(largest < 64);
+	CPPUNIT_ASSERT(whole.str() == w.str());
+
+	// the mode and the document boundaries move along
+	json::writer m;
+	parser_t first((json::write_handler(m))), second((json::write_handler(m)));
+	first.set_multi_document(true);
+	CPPUNIT_ASSERT(parser_t::PENDING == first.feed("[1] [2, 3", 9));
+	CPPUNIT_ASSERT(second.restore(first.checkpoint()));
+	CPPUNIT_ASSERT(parser_t::PENDING == second.feed("4] []", 5) && parser_t::OK == second.finish());
+	CPPUNIT_ASSERT(std::string("[1],[2,34],[]") == m.str());
+
+	// anything but a whole checkpoint is rejected and leaves the parser reset, as are the checkpoints out of its limits
+	json::writer n;
+	parser_t source((json::write_handler(n))), target((json::write_handler(n)));
+	CPPUNIT_ASSERT(parser_t::PENDING == source.feed("[[\"abc", 6));
+	const std::string checkpoint = source.checkpoint();
+	for (size_t i = 0; i < checkpoint.size(); ++i)
+		CPPUNIT_ASSERT(!target.restore(checkpoint.data(), i));
+	CPPUNIT_ASSERT(!target.restore(checkpoint + '\0'));
+	std::string corrupt(checkpoint);
+	corrupt[0] = 'X';
+	CPPUNIT_ASSERT(!target.restore(corrupt) && 0 == target.buffered());
+	json::limits shallow;
+	shallow.max_depth = 1;
+	target.set_limits(shallow);
+	CPPUNIT_ASSERT(!target.restore(checkpoint));
+	target.set_limits(json::limits());
+	CPPUNIT_ASSERT(target.restore(checkpoint) && 4 == target.buffered());
+	CPPUNIT_ASSERT(parser_t::PENDING == target.feed("\"]]", 3) && parser_t::OK == target.finish());
+	CPPUNIT_ASSERT(std::string("[[\"abc\"]]") == n.str());
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_snapshot() {
+	char path[] = "/tmp/test_json_parser.XXXXXX";
+	int fd = mkstemp(path);
+	CPPUNIT_ASSERT(fd >= 0);
+	close(fd);
+	const std::string json("{\"k\" : [1, \"t\\u0041o\", {\"three\" : 3.5}, true, null], \"l\" : -9223372036854775808, \"m\" : {}}");
+	json::tape t;
+	json::parser<char, json::tape_builder> parser((json::tape_builder(t)));
+	CPPUNIT_ASSERT(parser.OK == parser.parse(json.data(), json.size()));
+	json::tape_snapshot::save(t, json::tape_snapshot::hash(json.data(), json.size()), json.size(), path);
+
+	// the mapped tape reads like the tape, through the same cursor
+	json::tape_snapshot s;
+	CPPUNIT_ASSERT(s.open(path, json.data(), json.size()));
+	CPPUNIT_ASSERT(t.size() == s.size() && json.size() == s.source_size());
+	std::ostringstream from_tape, from_snapshot;
+	from_tape << t;
+	s.print(from_snapshot);
+	CPPUNIT_ASSERT(from_tape.str() == from_snapshot.str());
+	json::tape_cursor r = s.root();
+	CPPUNIT_ASSERT(3 == r.size() && INT64_MIN == r.find("l", 1).integer());
+	json::tape_cursor k = r.find("k", 1);
+	CPPUNIT_ASSERT(5 == k.size() && std::string("tAo") == k.first().next().string().str());
+	CPPUNIT_ASSERT(3.5 == k.first().next().next().find("three", 5).number());
+
+	// another source, even of the same size, makes the snapshot stale, as does another file
+	std::string edited(json);
+	edited[edited.size() - 3] = 'n';
+	CPPUNIT_ASSERT(!s.open(path, edited.data(), edited.size()) && !s.is_open());
+	CPPUNIT_ASSERT(!s.open(path, json.data(), json.size() - 1));
+	CPPUNIT_ASSERT(json::tape_snapshot::hash(json.data(), json.size()) != json::tape_snapshot::hash(edited.data(), edited.size()));
+	std::ofstream(path, std::ios::trunc).write(json.data(), json.size());
+	CPPUNIT_ASSERT(!s.open(path));
+	unlink(path);
+	CPPUNIT_ASSERT(!s.open(path));
+
+	// a file that cannot be written throws, a truncated snapshot is rejected
+	bool thrown = false;
+	try {
+		json::tape_snapshot::save(t, 0, 0, "/nonexistent/directory/snapshot");
+	} catch (const std::runtime_error&) {
+		thrown = true;
+	}
+	CPPUNIT_ASSERT(thrown);
+	json::tape_snapshot::save(t, 0, 0, path);
+	{
+		json::mapped_file f;
+		f.open(path);
+		std::string truncated(f.data(), f.size() - 1);
+		std::ofstream(path, std::ios::trunc).write(truncated.data(), truncated.size());
+	}
+	CPPUNIT_ASSERT(!s.open(path));
+	unlink(path);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::batch_cb(json::event_batch<char>& b, void *ctx) {
+	batches_t *batches = static_cast<batches_t *>(ctx);
+	++batches->count;
+	std::ostringstream os;
+	for (size_t i = 0; i < b.size(); ++i) {
+		const json::event& e = b[i];
+		os << static_cast<char>(json::event::DOCUMENT_END == e.kind ? '$' : e.kind) << e.depth;
+		if (json::event::KEY == e.kind || json::event::STRING == e.kind)
+			os << '=' << b.text(e).str();
+		else if (json::event::INT64 == e.kind)
+			os << '=' << e.integer;
+		else if (json::event::DOUBLE == e.kind)
+			os << '=' << e.number;
+		os << ' ';
+	}
+	batches->events.append(os.str());
+	// the full batch is kept, the handler fills the previous one
+	b.swap(batches->kept);
+}
+
+template<typename Char>
+void
+TestJSONParser<Char>::ok_event_batch() {
+	CPPUNIT_ASSERT(16 == sizeof(json::event));
+	typedef json::parser<char, json::event_batcher<char> > parser_t;
+	const std::string json("{\"a\\\"b\" : [1, -2.5, \"xyz\", true, false, null, {}], \"c\" : 12345678901234567890}");
+	const std::string events("{0 :1=a\"b [1 l2=1 d2=-2.5 \"2=xyz t2 f2 n2 {2 }2 ]1 :1=c d1=1.23457e+19 }0 ");
+	for (size_t chunk = 1; chunk <= json.size(); chunk += json.size() - 1) {
+		batches_t batches;
+		parser_t parser((json::event_batcher<char>(4)));
+		parser.handler().hook_batch(&batch_cb);
+		parser.handler().set_context(&batches);
+		parser_t::result_t res = parser_t::PENDING;
+		for (size_t i = 0; i < json.size() && parser_t::PENDING == res; i += chunk)
+			res = parser.feed(json.data() + i, std::min(chunk, json.size() - i));
+		if (parser_t::PENDING == res)
+			res = parser.finish();
+		CPPUNIT_ASSERT(parser_t::OK == res);
+		// 15 events: three full batches, the last three are pending until the flush
+		CPPUNIT_ASSERT(3 == batches.count && 3 == parser.handler().pending().size());
+		CPPUNIT_ASSERT(4 == parser.handler().pending().capacity());
+		parser.handler().flush();
+		CPPUNIT_ASSERT(4 == batches.count && parser.handler().pending().empty());
+		CPPUNIT_ASSERT(events == batches.events);
+		// the records are valid after the parser moved on, the strings were copied
+		CPPUNIT_ASSERT(3 == batches.kept.size() && std::string("c") == batches.kept.text(batches.kept[0]).str());
+	}
+
+	// the documents of a stream are delimited by records, a batch may span documents
+	batches_t batches;
+	parser_t stream;
+	stream.set_multi_document(true);
+	stream.handler().hook_batch(&batch_cb);
+	stream.handler().set_context(&batches);
+	const std::string ndjson("[1]\n{\"a\" : \"b\"}\n");
+	CPPUNIT_ASSERT(parser_t::PENDING == stream.feed(ndjson.data(), ndjson.size()) && parser_t::OK == stream.finish());
+	CPPUNIT_ASSERT(0 == batches.count && 9 == stream.handler().pending().size());
+	stream.handler().flush();
+	CPPUNIT_ASSERT(std::string("[0 l1=1 ]0 $0 {0 :1=a \"1=b }0 $0 ") == batches.events);
+
+	// the events of a document that failed halfway are dropped with the parser, the depth starts over
+	const std::string bad("[[1, ");
+	CPPUNIT_ASSERT(parser_t::ERROR == stream.feed(bad.data(), bad.size()) || parser_t::ERROR == stream.finish());
+	CPPUNIT_ASSERT(!stream.handler().pending().empty());
+	stream.reset();
+	CPPUNIT_ASSERT(stream.handler().pending().empty());
+	CPPUNIT_ASSERT(parser_t::PENDING == stream.feed("{}", 2) && parser_t::OK == stream.finish());
+	CPPUNIT_ASSERT(3 == stream.handler().pending().size() && 0 == stream.handler().pending()[1].depth);
+}
+
 #endif
@@ -58,22 +58,32 @@ main(int argc, char *argv[]) {
 	ctx.push(root);
 	
 	json::parser<char>::result_t r;
-	// parse the chunks.
-	for (unsigned int i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
-		// Set the internal buffer of the string stream to the chunk to be parsed.
-		s.rdbuf()->pubsetbuf(const_cast<char *>(chunks[i]), strlen(chunks[i]));
-		// Clear the flags of the input stream. This is necessary as each
-		// invokation to the parser extracts characters from the stream (chunk)
-		// until all are consumed or a scan/parse error is detected.
-		// Thus, they always leave the EOF flag set unless an error is detected.
-		s.clear();
-		// Parse.
-		r = parser.parse();
-		// Parse cannot return OK in this phase because it does not know if
-		// more chunks will arrive or not. The only values that can be returned
-		// are ERROR and PENDING. Abort the parsing of the remaining chunks if ERROR.
-		if (json::parser<char>::PENDING != r)
-			break;
+	if (argc > 1) {
+		// A file is given. It is mapped into memory and parsed in place, without being read into a buffer.
+		try {
+			r = parser.parse_file(argv[1]);
+		} catch (const std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	} else {
+		// parse the chunks.
+		for (unsigned int i = 0; i < sizeof(chunks) / sizeof(chunks[0]); ++i) {
+			// Set the internal buffer of the string stream to the chunk to be parsed.
+			s.rdbuf()->pubsetbuf(const_cast<char *>(chunks[i]), strlen(chunks[i]));
+			// Clear the flags of the input stream. This is necessary as each
+			// invokation to the parser extracts characters from the stream (chunk)
+			// until all are consumed or a scan/parse error is detected.
+			// Thus, they always leave the EOF flag set unless an error is detected.
+			s.clear();
+			// Parse.
+			r = parser.parse();
+			// Parse cannot return OK in this phase because it does not know if
+			// more chunks will arrive or not. The only values that can be returned
+			// are ERROR and PENDING. Abort the parsing of the remaining chunks if ERROR.
+			if (json::parser<char>::PENDING != r)
+				break;
+		}
 	}
 	// Here we parsed all chunks. If no ERROR, then let the parser know that no more
 	// chunks arrive. This is done by passing an empty chunk.
@@ -83,25 +93,12 @@ main(int argc, char *argv[]) {
 	// The parser scans '{', then '}'. When it reads '}' is realises that '{}' is not
 	// a valid token (scanning is greedy, so it tries to amass as many characters as possible
 	// before returning a token). Hence, it returns the longest token encountered so far, i.e. '{'.
-	// Upon the next invokation of the scanner, an attempt is made to fetch a new character
-	// from the stream. However, end-of-stream (EOS) is reached. The scanner may not know if '}' is
-	// a complete token or if new characters that can be amassed in the currently scanned token
-	// will arrive in the new chunk. (Ok, we know that no token can start with '}' and contain other
-	// characters, but the scanner does not have this look-ahead capacity. Imagin the casee of
-	// numbers: we get 1. Should we decide that we have a token, namely the number one, or should
-	// we wait for other characters, maybe another digit arrives that can be appended to 1.) So
-	// the scanner does not return the '}' token, but returns PENDING. At this point we send an
-	// empty chunk in order to signal that no more chunks arrive. The parser invokes the scanner.
-	// The scanner encounters the EOS, so it knows that nothing will follow the '}'. Hence it will
-	// return the token '}' to the parser. The parser is slightly puzzled: it has sent an empty
-	// chunk from which a non-EOS token emerges. So we need to invoke the parser once more with
-	// an empty chunk. This time, the scanner responds with EOS to the empty chunk and the parser
-	// is relieved.
-	while (json::parser<char>::PENDING == r) {
-		s.rdbuf()->pubsetbuf(const_cast<char *>(""), 0);
-		s.clear();
-		r = parser.parse();
-	}
+	// The scanner may not know if '}' is a complete token or if new characters will arrive
+	// in the next chunk (think of a number: 1 may be followed by another digit). So the scanner
+	// returns PENDING. An empty chunk tells it that nothing follows, so it returns '}', and one
+	// more empty chunk yields the end of the input. finish does this in one call.
+	if (json::parser<char>::PENDING == r)
+		r = parser.finish();
 	if (json::parser<char>::ERROR == r) {
 		std::cerr << "Parse error" << std::endl;
 		return 1;